@@ -0,0 +1,537 @@
+#include "activation.h"
+#include <QtGlobal>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ACTIVATION_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(ACTIVATION_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define ACTIVATION_SSE2
+#endif
+
+#if defined(ACTIVATION_X86) && (defined(__GNUC__) || defined(_MSC_VER))
+#define ACTIVATION_AVX2
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
+
+// exp(x) = 2^n * exp(r) with n = round(x / ln2), r = x - n * ln2 (ln2 split in two for precision)
+static const float Log2e = 1.44269504088896341f;
+static const float Ln2Hi = 0.693359375f;
+static const float Ln2Lo = -2.12194440e-4f;
+static const float ExpMax = 88.0f;
+
+// Cephes polynomial for exp(r) on [-ln2/2, ln2/2]
+static const float ExpP0 = 1.9875691500e-4f;
+static const float ExpP1 = 1.3981999507e-3f;
+static const float ExpP2 = 8.3334519073e-3f;
+static const float ExpP3 = 4.1665795894e-2f;
+static const float ExpP4 = 1.6666665459e-1f;
+static const float ExpP5 = 5.0000001201e-1f;
+
+// Chebyshev fit of 2^f on [-0.5, 0.5], relative error below 1e-4
+static const float Exp2C0 = 0.99992456f;
+static const float Exp2C1 = 0.69313673f;
+static const float Exp2C2 = 0.24263948f;
+static const float Exp2C3 = 0.05583828f;
+static const float Exp2Max = 126.0f;
+
+struct KernelTable
+{
+    void (*sigmoid)(float *, int);
+    void (*fastSigmoid)(float *, int);
+    void (*tanh)(float *, int);
+    void (*relu)(float *, int);
+    void (*hardSigmoid)(float *, int);
+};
+
+// Scalar
+
+static inline float scalarFastExp2(float x)
+{
+    x = qBound(-Exp2Max, x, Exp2Max);
+
+    float n = std::nearbyint(x);
+    float f = x - n;
+    float p = ((Exp2C3 * f + Exp2C2) * f + Exp2C1) * f + Exp2C0;
+
+    qint32 bits = (qint32(n) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+
+    return p * scale;
+}
+
+static inline float scalarSigmoid(float x)
+{
+    return 1.0 / (1.0 + std::exp(-x));
+}
+
+static inline float scalarFastSigmoid(float x)
+{
+    return 1.0f / (1.0f + scalarFastExp2(-x * Log2e));
+}
+
+static inline float scalarTanh(float x)
+{
+    return std::tanh(x);
+}
+
+static inline float scalarRelu(float x)
+{
+    return x > 0.0f ? x : 0.0f;
+}
+
+static inline float scalarHardSigmoid(float x)
+{
+    return qBound(0.0f, 0.2f * x + 0.5f, 1.0f);
+}
+
+static void scalarSigmoidArray(float *values, int count)
+{
+    for (int i = 0; i < count; ++i)
+        values[i] = scalarSigmoid(values[i]);
+}
+
+static void scalarFastSigmoidArray(float *values, int count)
+{
+    for (int i = 0; i < count; ++i)
+        values[i] = scalarFastSigmoid(values[i]);
+}
+
+static void scalarTanhArray(float *values, int count)
+{
+    for (int i = 0; i < count; ++i)
+        values[i] = scalarTanh(values[i]);
+}
+
+static void scalarReluArray(float *values, int count)
+{
+    for (int i = 0; i < count; ++i)
+        values[i] = scalarRelu(values[i]);
+}
+
+static void scalarHardSigmoidArray(float *values, int count)
+{
+    for (int i = 0; i < count; ++i)
+        values[i] = scalarHardSigmoid(values[i]);
+}
+
+// SSE2
+
+#ifdef ACTIVATION_SSE2
+static inline __m128 sseExp(__m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-ExpMax)), _mm_set1_ps(ExpMax));
+
+    __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(Log2e)));
+    __m128 fn = _mm_cvtepi32_ps(n);
+
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(Ln2Hi)));
+    r = _mm_sub_ps(r, _mm_mul_ps(fn, _mm_set1_ps(Ln2Lo)));
+
+    __m128 p = _mm_set1_ps(ExpP0);
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(ExpP1));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(ExpP2));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(ExpP3));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(ExpP4));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(ExpP5));
+    p = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r), _mm_add_ps(r, _mm_set1_ps(1.0f)));
+
+    __m128i exponent = _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(p, _mm_castsi128_ps(exponent));
+}
+
+static inline __m128 sseFastExp2(__m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-Exp2Max)), _mm_set1_ps(Exp2Max));
+
+    __m128i n = _mm_cvtps_epi32(x);
+    __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(n));
+
+    __m128 p = _mm_set1_ps(Exp2C3);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(Exp2C2));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(Exp2C1));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(Exp2C0));
+
+    __m128i exponent = _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(p, _mm_castsi128_ps(exponent));
+}
+
+static void sseSigmoidArray(float *values, int count)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(values + i);
+        __m128 e = sseExp(_mm_sub_ps(_mm_setzero_ps(), x));
+        _mm_storeu_ps(values + i, _mm_div_ps(one, _mm_add_ps(one, e)));
+    }
+
+    for (; i < count; ++i)
+        values[i] = scalarSigmoid(values[i]);
+}
+
+static void sseFastSigmoidArray(float *values, int count)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusLog2e = _mm_set1_ps(-Log2e);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(values + i);
+        __m128 e = sseFastExp2(_mm_mul_ps(x, minusLog2e));
+        _mm_storeu_ps(values + i, _mm_div_ps(one, _mm_add_ps(one, e)));
+    }
+
+    for (; i < count; ++i)
+        values[i] = scalarFastSigmoid(values[i]);
+}
+
+static void sseTanhArray(float *values, int count)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 minusTwo = _mm_set1_ps(-2.0f);
+
+    // tanh(x) = 2 / (1 + exp(-2x)) - 1
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(values + i);
+        __m128 e = sseExp(_mm_mul_ps(x, minusTwo));
+        _mm_storeu_ps(values + i, _mm_sub_ps(_mm_div_ps(two, _mm_add_ps(one, e)), one));
+    }
+
+    for (; i < count; ++i)
+        values[i] = scalarTanh(values[i]);
+}
+
+static void sseReluArray(float *values, int count)
+{
+    const __m128 zero = _mm_setzero_ps();
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(values + i, _mm_max_ps(_mm_loadu_ps(values + i), zero));
+
+    for (; i < count; ++i)
+        values[i] = scalarRelu(values[i]);
+}
+
+static void sseHardSigmoidArray(float *values, int count)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 slope = _mm_set1_ps(0.2f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 y = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(values + i), slope), half);
+        _mm_storeu_ps(values + i, _mm_min_ps(_mm_max_ps(y, zero), one));
+    }
+
+    for (; i < count; ++i)
+        values[i] = scalarHardSigmoid(values[i]);
+}
+#endif
+
+// AVX2 + FMA
+
+#ifdef ACTIVATION_AVX2
+TARGET_AVX2 static inline __m256 avxExp(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-ExpMax)), _mm256_set1_ps(ExpMax));
+
+    __m256i n = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(Log2e)));
+    __m256 fn = _mm256_cvtepi32_ps(n);
+
+    __m256 r = _mm256_fnmadd_ps(fn, _mm256_set1_ps(Ln2Hi), x);
+    r = _mm256_fnmadd_ps(fn, _mm256_set1_ps(Ln2Lo), r);
+
+    __m256 p = _mm256_set1_ps(ExpP0);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(ExpP1));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(ExpP2));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(ExpP3));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(ExpP4));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(ExpP5));
+    p = _mm256_fmadd_ps(_mm256_mul_ps(p, r), r, _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+
+    __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+}
+
+TARGET_AVX2 static inline __m256 avxFastExp2(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-Exp2Max)), _mm256_set1_ps(Exp2Max));
+
+    __m256i n = _mm256_cvtps_epi32(x);
+    __m256 f = _mm256_sub_ps(x, _mm256_cvtepi32_ps(n));
+
+    __m256 p = _mm256_set1_ps(Exp2C3);
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(Exp2C2));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(Exp2C1));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(Exp2C0));
+
+    __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+}
+
+TARGET_AVX2 static void avxSigmoidArray(float *values, int count)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(values + i);
+        __m256 e = avxExp(_mm256_sub_ps(_mm256_setzero_ps(), x));
+        _mm256_storeu_ps(values + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+    }
+
+    for (; i < count; ++i)
+        values[i] = scalarSigmoid(values[i]);
+}
+
+TARGET_AVX2 static void avxFastSigmoidArray(float *values, int count)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 minusLog2e = _mm256_set1_ps(-Log2e);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(values + i);
+        __m256 e = avxFastExp2(_mm256_mul_ps(x, minusLog2e));
+        _mm256_storeu_ps(values + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+    }
+
+    for (; i < count; ++i)
+        values[i] = scalarFastSigmoid(values[i]);
+}
+
+TARGET_AVX2 static void avxTanhArray(float *values, int count)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 minusTwo = _mm256_set1_ps(-2.0f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(values + i);
+        __m256 e = avxExp(_mm256_mul_ps(x, minusTwo));
+        _mm256_storeu_ps(values + i, _mm256_sub_ps(_mm256_div_ps(two, _mm256_add_ps(one, e)), one));
+    }
+
+    for (; i < count; ++i)
+        values[i] = scalarTanh(values[i]);
+}
+
+TARGET_AVX2 static void avxReluArray(float *values, int count)
+{
+    const __m256 zero = _mm256_setzero_ps();
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(values + i, _mm256_max_ps(_mm256_loadu_ps(values + i), zero));
+
+    for (; i < count; ++i)
+        values[i] = scalarRelu(values[i]);
+}
+
+TARGET_AVX2 static void avxHardSigmoidArray(float *values, int count)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 slope = _mm256_set1_ps(0.2f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 y = _mm256_fmadd_ps(_mm256_loadu_ps(values + i), slope, half);
+        _mm256_storeu_ps(values + i, _mm256_min_ps(_mm256_max_ps(y, zero), one));
+    }
+
+    for (; i < count; ++i)
+        values[i] = scalarHardSigmoid(values[i]);
+}
+#endif
+
+static bool cpuSupportsAvx2()
+{
+#if defined(ACTIVATION_AVX2) && defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(ACTIVATION_AVX2) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    __cpuid(info, 1);
+    bool fma = info[2] & (1 << 12);
+    bool osxsave = info[2] & (1 << 27);
+    if (!fma || !osxsave || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return false;
+#endif
+}
+
+static KernelTable kernelTable(ActivationKernels::InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#ifdef ACTIVATION_AVX2
+    case ActivationKernels::AVX2:
+        return { avxSigmoidArray, avxFastSigmoidArray, avxTanhArray, avxReluArray, avxHardSigmoidArray };
+#endif
+#ifdef ACTIVATION_SSE2
+    case ActivationKernels::SSE2:
+        return { sseSigmoidArray, sseFastSigmoidArray, sseTanhArray, sseReluArray, sseHardSigmoidArray };
+#endif
+    default:
+        return { scalarSigmoidArray, scalarFastSigmoidArray, scalarTanhArray, scalarReluArray, scalarHardSigmoidArray };
+    }
+}
+
+static ActivationKernels::InstructionSet &currentInstructionSet()
+{
+    static ActivationKernels::InstructionSet instructionSet = ActivationKernels::bestSupportedInstructionSet();
+    return instructionSet;
+}
+
+static KernelTable &kernels()
+{
+    static KernelTable table = kernelTable(currentInstructionSet());
+    return table;
+}
+
+void ActivationKernels::apply(Activation activation, float *values, int count)
+{
+    switch (activation)
+    {
+    case Activation::Identity:
+        break;
+    case Activation::Sigmoid:
+        kernels().sigmoid(values, count);
+        break;
+    case Activation::FastSigmoid:
+        kernels().fastSigmoid(values, count);
+        break;
+    case Activation::Tanh:
+        kernels().tanh(values, count);
+        break;
+    case Activation::ReLU:
+        kernels().relu(values, count);
+        break;
+    case Activation::HardSigmoid:
+        kernels().hardSigmoid(values, count);
+        break;
+    }
+}
+
+float ActivationKernels::apply(Activation activation, float value)
+{
+    switch (activation)
+    {
+    case Activation::Identity:
+        return value;
+    case Activation::Sigmoid:
+        return scalarSigmoid(value);
+    case Activation::FastSigmoid:
+        return scalarFastSigmoid(value);
+    case Activation::Tanh:
+        return scalarTanh(value);
+    case Activation::ReLU:
+        return scalarRelu(value);
+    case Activation::HardSigmoid:
+        return scalarHardSigmoid(value);
+    }
+
+    return value;
+}
+
+ActivationKernels::InstructionSet ActivationKernels::instructionSet()
+{
+    return currentInstructionSet();
+}
+
+ActivationKernels::InstructionSet ActivationKernels::bestSupportedInstructionSet()
+{
+    if (cpuSupportsAvx2())
+        return AVX2;
+
+#ifdef ACTIVATION_SSE2
+    return SSE2;
+#else
+    return Scalar;
+#endif
+}
+
+bool ActivationKernels::setInstructionSet(InstructionSet instructionSet)
+{
+    if (instructionSet > bestSupportedInstructionSet())
+        return false;
+
+    currentInstructionSet() = instructionSet;
+    kernels() = kernelTable(instructionSet);
+
+    return true;
+}
+
+const char *ActivationKernels::name(Activation activation)
+{
+    switch (activation)
+    {
+    case Activation::Identity:
+        return "identity";
+    case Activation::Sigmoid:
+        return "sigmoid";
+    case Activation::FastSigmoid:
+        return "fastsigmoid";
+    case Activation::Tanh:
+        return "tanh";
+    case Activation::ReLU:
+        return "relu";
+    case Activation::HardSigmoid:
+        return "hardsigmoid";
+    }
+
+    return "unknown";
+}
+
+const char *ActivationKernels::name(InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case Scalar:
+        return "scalar";
+    case SSE2:
+        return "sse2";
+    case AVX2:
+        return "avx2";
+    }
+
+    return "unknown";
+}
@@ -0,0 +1,42 @@
+#ifndef ACTIVATION_H
+#define ACTIVATION_H
+
+enum class Activation
+{
+    Identity,
+    Sigmoid,
+    // Sigmoid built on a cubic 2^x approximation, absolute error below 3e-5
+    FastSigmoid,
+    Tanh,
+    ReLU,
+    // clamp(0.2 * x + 0.5, 0, 1)
+    HardSigmoid
+};
+
+// Activation functions over whole arrays of values. The SSE2 and AVX2 kernels are
+// picked at runtime from what the CPU supports, with a scalar fallback everywhere else.
+class ActivationKernels
+{
+public:
+    enum InstructionSet
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    static void apply(Activation activation, float *values, int count);
+    static float apply(Activation activation, float value);
+
+    static InstructionSet instructionSet();
+    static InstructionSet bestSupportedInstructionSet();
+
+    // Forces a kernel set, eg. for benchmarking. Returns false if the CPU does not support it.
+    // Not thread safe, call it before any evaluation starts.
+    static bool setInstructionSet(InstructionSet instructionSet);
+
+    static const char *name(Activation activation);
+    static const char *name(InstructionSet instructionSet);
+};
+
+#endif // ACTIVATION_H
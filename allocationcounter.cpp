@@ -0,0 +1,86 @@
+#include "allocationcounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<bool> s_enabled(false);
+static std::atomic<quint64> s_operatorNewCalls(0);
+static std::atomic<quint64> s_operatorNewBytes(0);
+
+bool AllocationCounter::isAvailable()
+{
+#ifdef GNN_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocationCounter::setEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool AllocationCounter::isEnabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+quint64 AllocationCounter::operatorNewCalls()
+{
+    return s_operatorNewCalls.load(std::memory_order_relaxed);
+}
+
+quint64 AllocationCounter::operatorNewBytes()
+{
+    return s_operatorNewBytes.load(std::memory_order_relaxed);
+}
+
+#ifdef GNN_COUNT_ALLOCATIONS
+
+static void *countedAllocate(std::size_t size)
+{
+    if (s_enabled.load(std::memory_order_relaxed))
+    {
+        s_operatorNewCalls.fetch_add(1, std::memory_order_relaxed);
+        s_operatorNewBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    // malloc(0) may return null, operator new must not
+    if (void *memory = std::malloc(size ? size : 1))
+        return memory;
+
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+#endif // GNN_COUNT_ALLOCATIONS
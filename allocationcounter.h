@@ -0,0 +1,24 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+// Counts calls to the global operator new while enabled, so instrumented runs can check that
+// their generations stay off the heap. Qt containers allocate with malloc and are not counted.
+// The operators are only replaced in builds configured with CONFIG+=count_allocations, other
+// builds count nothing. Disabled, the replaced operators only add a relaxed load to every call.
+class AllocationCounter
+{
+public:
+    // Whether this build replaces operator new at all
+    static bool isAvailable();
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    // Totals over every thread since the program started, only growing while enabled
+    static quint64 operatorNewCalls();
+    static quint64 operatorNewBytes();
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,200 @@
+#include "backpropagation.h"
+#include "random.h"
+#include <algorithm>
+
+Backpropagation::Backpropagation()
+{
+}
+
+float Backpropagation::derivative(Activation activation, float output)
+{
+    switch (activation)
+    {
+    case Activation::Identity:
+        return 1.0f;
+    case Activation::Sigmoid:
+    case Activation::FastSigmoid:
+        return output * (1.0f - output);
+    case Activation::Tanh:
+        return 1.0f - output * output;
+    case Activation::ReLU:
+        return output > 0.0f ? 1.0f : 0.0f;
+    case Activation::HardSigmoid:
+        return output > 0.0f && output < 1.0f ? 0.2f : 0.0f;
+    }
+
+    return 1.0f;
+}
+
+void Backpropagation::reserve(const NetworkTopology &topology, int samples)
+{
+    m_outputOffsets.resize(topology.layerCount() + 1);
+
+    int offset = 0;
+    for (int layer = 0; layer <= topology.layerCount(); ++layer)
+    {
+        m_outputOffsets[layer] = offset;
+        offset += (layer == 0 ? topology.inputs() : topology.layerSize(layer - 1)) * samples;
+    }
+
+    if (m_outputs.size() < offset)
+        m_outputs.resize(offset);
+
+    int layerBlock = topology.maxLayerSize() * samples;
+    if (m_deltas.size() < layerBlock)
+    {
+        m_deltas.resize(layerBlock);
+        m_previousDeltas.resize(layerBlock);
+    }
+
+    if (m_gradient.size() < topology.genomeSize())
+        m_gradient.resize(topology.genomeSize());
+
+    if (m_rows.size() < samples)
+        m_rows.resize(samples);
+}
+
+float Backpropagation::step(const NetworkTopology &topology, float *genome, const DatasetView &batch, float learningRate)
+{
+    reserve(topology, batch.samples);
+
+    for (int s = 0; s < batch.samples; ++s)
+        m_rows[s] = s;
+
+    return runBatch(topology, genome, batch, m_rows.constData(), batch.samples, learningRate);
+}
+
+float Backpropagation::train(const NetworkTopology &topology, float *genome, const DatasetView &dataset,
+                             int steps, int batchSize, float learningRate, Random &random)
+{
+    int samples = qMin(batchSize, dataset.samples);
+    if (samples <= 0)
+        return 0;
+
+    reserve(topology, samples);
+
+    float error = 0;
+    for (int i = 0; i < steps; ++i)
+    {
+        for (int s = 0; s < samples; ++s)
+            m_rows[s] = random.bounded(dataset.samples);
+
+        error = runBatch(topology, genome, dataset, m_rows.constData(), samples, learningRate);
+    }
+
+    return error;
+}
+
+float Backpropagation::runBatch(const NetworkTopology &topology, float *genome, const DatasetView &dataset,
+                                const int *rows, int samples, float learningRate)
+{
+    float *inputs = m_outputs.data();
+    for (int s = 0; s < samples; ++s)
+    {
+        const float *inputRow = dataset.inputRow(rows[s]);
+        for (int i = 0; i < dataset.inputSize; ++i)
+            inputs[i * samples + s] = inputRow[i];
+    }
+
+    // Forward, a weights x outputs product per layer with the samples innermost
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+    {
+        int fanIn = topology.layerInputs(layer);
+        const float *layerInputs = m_outputs.constData() + m_outputOffsets[layer];
+        float *layerOutputs = m_outputs.data() + m_outputOffsets[layer + 1];
+        const float *weights = genome + topology.layerOffset(layer);
+
+        for (int j = 0; j < topology.layerSize(layer); ++j)
+        {
+            float *row = layerOutputs + j * samples;
+            std::fill(row, row + samples, weights[fanIn]);
+
+            for (int i = 0; i < fanIn; ++i)
+            {
+                const float weight = weights[i];
+                const float *inputRow = layerInputs + i * samples;
+                for (int s = 0; s < samples; ++s)
+                    row[s] += weight * inputRow[s];
+            }
+
+            ActivationKernels::apply(topology.layerActivation(layer), row, samples);
+            weights += fanIn + 1;
+        }
+    }
+
+    // The slope of the squared error at every output sum
+    int lastLayer = topology.layerCount() - 1;
+    Activation outputActivation = topology.layerActivation(lastLayer);
+    const float *outputs = m_outputs.constData() + m_outputOffsets[lastLayer + 1];
+    float error = 0;
+
+    for (int s = 0; s < samples; ++s)
+    {
+        const float *targetRow = dataset.targetRow(rows[s]);
+        for (int o = 0; o < topology.outputs(); ++o)
+        {
+            float output = outputs[o * samples + s];
+            float difference = output - targetRow[o];
+            error += difference * difference;
+            m_deltas[o * samples + s] = 2.0f * difference * derivative(outputActivation, output);
+        }
+    }
+
+    // Backward, each layer's gradient and then the slopes at the sums feeding it
+    std::fill(m_gradient.begin(), m_gradient.begin() + topology.genomeSize(), 0.0f);
+
+    for (int layer = lastLayer; layer >= 0; --layer)
+    {
+        int fanIn = topology.layerInputs(layer);
+        int size = topology.layerSize(layer);
+        const float *layerInputs = m_outputs.constData() + m_outputOffsets[layer];
+        const float *weights = genome + topology.layerOffset(layer);
+        float *gradient = m_gradient.data() + topology.layerOffset(layer);
+
+        if (layer > 0)
+            std::fill(m_previousDeltas.begin(), m_previousDeltas.begin() + fanIn * samples, 0.0f);
+
+        for (int j = 0; j < size; ++j)
+        {
+            const float *delta = m_deltas.constData() + j * samples;
+
+            for (int i = 0; i < fanIn; ++i)
+            {
+                const float *inputRow = layerInputs + i * samples;
+                float sum = 0;
+                for (int s = 0; s < samples; ++s)
+                    sum += delta[s] * inputRow[s];
+                gradient[i] += sum;
+
+                if (layer > 0)
+                {
+                    float *previous = m_previousDeltas.data() + i * samples;
+                    for (int s = 0; s < samples; ++s)
+                        previous[s] += weights[i] * delta[s];
+                }
+            }
+
+            float biasSum = 0;
+            for (int s = 0; s < samples; ++s)
+                biasSum += delta[s];
+            gradient[fanIn] += biasSum;
+
+            weights += fanIn + 1;
+            gradient += fanIn + 1;
+        }
+
+        if (layer > 0)
+        {
+            Activation activation = topology.layerActivation(layer - 1);
+            for (int k = 0; k < fanIn * samples; ++k)
+                m_previousDeltas[k] *= derivative(activation, layerInputs[k]);
+            std::swap(m_deltas, m_previousDeltas);
+        }
+    }
+
+    float rate = learningRate / float(samples);
+    for (int g = 0; g < topology.genomeSize(); ++g)
+        genome[g] -= rate * m_gradient[g];
+
+    return error;
+}
@@ -0,0 +1,45 @@
+#ifndef BACKPROPAGATION_H
+#define BACKPROPAGATION_H
+
+#include <QVector>
+#include "dataset.h"
+#include "networktopology.h"
+
+class Random;
+
+// Mini-batch gradient descent on a whole network's summed squared error, the error the evolution
+// scores. A batch runs forward neuron-major as in the Evaluator, keeping every layer's outputs,
+// then the output errors are propagated back and the gradients of all its samples are averaged
+// into one step. A Backpropagation owns scratch buffers and is meant to be used by one thread at a time.
+class Backpropagation
+{
+public:
+    Backpropagation();
+
+    // One step over every row of batch. Returns the batch's error before the step.
+    float step(const NetworkTopology &topology, float *genome, const DatasetView &batch, float learningRate);
+
+    // steps steps, each over batchSize rows of dataset drawn with replacement. Returns the
+    // error of the last batch before its step.
+    float train(const NetworkTopology &topology, float *genome, const DatasetView &dataset,
+                int steps, int batchSize, float learningRate, Random &random);
+
+    // Slope of an activation at the point where it outputs output
+    static float derivative(Activation activation, float output);
+
+private:
+    void reserve(const NetworkTopology &topology, int samples);
+    float runBatch(const NetworkTopology &topology, float *genome, const DatasetView &dataset,
+                   const int *rows, int samples, float learningRate);
+
+    QVector<int> m_rows;
+    // The inputs and then the outputs of every layer, samples floats per neuron
+    QVector<float> m_outputs;
+    QVector<int> m_outputOffsets;
+    // Error slopes of the current layer's and the previous layer's sums
+    QVector<float> m_deltas;
+    QVector<float> m_previousDeltas;
+    QVector<float> m_gradient;
+};
+
+#endif // BACKPROPAGATION_H
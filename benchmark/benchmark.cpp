@@ -0,0 +1,587 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include "dataset.h"
+#include "evaluator.h"
+#include "fixednetwork.h"
+#include "forwardpass.h"
+#include "generationengine.h"
+#include "neuralnetwork.h"
+#include "population.h"
+#include "quantizednetwork.h"
+#include "selection.h"
+#include "threadpool.h"
+
+// Usage: NeuralNetworkBenchmark [options]
+// Every measurement is one line of results, JSON objects by default
+//   --format jsonl|csv     output format
+//   --output PATH          write the results to PATH instead of stdout
+//   --filter NAMES         benchmarks to run, of forward,evaluate,generation,breed,select
+//   --topologies LIST      eg. 3-2-1,64-32-8 for three inputs, a hidden layer of two and one output
+//   --pool-sizes LIST      population sizes for generation, breed and select
+//   --samples LIST         dataset sizes for evaluate, generation uses the first
+//   --threads LIST         thread counts for evaluate and generation, powers of two up to all cores by default
+//   --min-time MSECS       time each measurement for at least this long, 200 by default
+//   --quick                small defaults for a smoke run
+
+struct BenchmarkOptions
+{
+    QStringList benchmarks = {"forward", "evaluate", "generation", "breed", "select"};
+    QVector<NetworkTopology> topologies;
+    QVector<int> poolSizes;
+    QVector<int> sampleCounts;
+    QVector<int> threadCounts;
+    int minMsecs = 200;
+    bool csv = false;
+    QString outputPath;
+};
+
+struct BenchmarkResult
+{
+    QString benchmark;
+    QString variant;
+    QString topology;
+    int poolSize = 0;
+    int samples = 0;
+    int threads = 1;
+    // Times the measured body ran, and the operations of unit each run does
+    qint64 repetitions = 0;
+    qint64 operations = 0;
+    QString unit;
+    double seconds = 0;
+};
+
+class ResultWriter
+{
+public:
+    ~ResultWriter()
+    {
+        if (m_file && m_file != stdout)
+            fclose(m_file);
+    }
+
+    bool open(const QString &path, bool csv)
+    {
+        m_csv = csv;
+        m_file = path.isEmpty() ? stdout : fopen(path.toLocal8Bit().constData(), "w");
+        if (m_file && m_csv)
+            line("benchmark,variant,topology,pool_size,samples,threads,repetitions,operations,unit,seconds,rate,ns_per_op");
+        return m_file;
+    }
+
+    void write(const BenchmarkResult &result)
+    {
+        double rate = result.seconds > 0 ? double(result.repetitions) * double(result.operations) / result.seconds : 0;
+        double nsPerOperation = rate > 0 ? 1e9 / rate : 0;
+
+        QByteArray text;
+        if (m_csv)
+        {
+            text = result.benchmark.toUtf8() + ',' + result.variant.toUtf8() + ',' + result.topology.toUtf8() + ','
+                 + QByteArray::number(result.poolSize) + ',' + QByteArray::number(result.samples) + ','
+                 + QByteArray::number(result.threads) + ',' + QByteArray::number(result.repetitions) + ','
+                 + QByteArray::number(result.operations) + ',' + result.unit.toUtf8() + ','
+                 + QByteArray::number(result.seconds, 'g', 6) + ',' + QByteArray::number(rate, 'g', 6) + ','
+                 + QByteArray::number(nsPerOperation, 'g', 6);
+        }
+        else
+        {
+            text = "{\"benchmark\":\"" + result.benchmark.toUtf8() + "\",\"variant\":\"" + result.variant.toUtf8()
+                 + "\",\"topology\":\"" + result.topology.toUtf8() + "\",\"pool_size\":" + QByteArray::number(result.poolSize)
+                 + ",\"samples\":" + QByteArray::number(result.samples) + ",\"threads\":" + QByteArray::number(result.threads)
+                 + ",\"repetitions\":" + QByteArray::number(result.repetitions) + ",\"operations\":" + QByteArray::number(result.operations)
+                 + ",\"unit\":\"" + result.unit.toUtf8() + "\",\"seconds\":" + QByteArray::number(result.seconds, 'g', 6)
+                 + ",\"rate\":" + QByteArray::number(rate, 'g', 6) + ",\"ns_per_op\":" + QByteArray::number(nsPerOperation, 'g', 6) + '}';
+        }
+
+        line(text);
+    }
+
+private:
+    void line(const QByteArray &text)
+    {
+        fputs(text.constData(), m_file);
+        fputc('\n', m_file);
+        // Results show up as they are measured, long runs can be watched or cut short
+        fflush(m_file);
+    }
+
+    FILE *m_file = nullptr;
+    bool m_csv = false;
+};
+
+// Results are stored here so the measured work cannot be optimised away
+static volatile float benchmarkSink;
+
+// Runs body once to warm up, then in rounds until one takes minMsecs. Returns the seconds of
+// the last round, repetitions is how many times it ran body.
+template<typename Body>
+static double measure(int minMsecs, qint64 &repetitions, const Body &body)
+{
+    body();
+
+    const qint64 minNsecs = qint64(minMsecs) * 1000000;
+    QElapsedTimer timer;
+    repetitions = 1;
+
+    forever
+    {
+        timer.start();
+        for (qint64 i = 0; i < repetitions; ++i)
+            body();
+        qint64 nsecs = timer.nsecsElapsed();
+
+        if (nsecs >= minNsecs || repetitions >= (qint64(1) << 40))
+            return double(nsecs) / 1e9;
+
+        // Aim a little past minMsecs from what this round took
+        qint64 estimate = nsecs > 0 ? qint64(double(repetitions) * 1.2 * double(minNsecs) / double(nsecs)) : repetitions * 16;
+        repetitions = qBound(repetitions * 2, estimate, repetitions * 16);
+    }
+}
+
+static QString topologyName(const NetworkTopology &topology)
+{
+    QString name = QString::number(topology.inputs());
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+        name += '-' + QString::number(topology.layerSize(layer));
+    return name;
+}
+
+static bool parseTopology(const QString &text, NetworkTopology &topology)
+{
+    QStringList sizes = text.split('-');
+    if (sizes.size() < 2)
+        return false;
+
+    QVector<int> layers;
+    for (const QString &size : sizes)
+    {
+        bool ok = false;
+        int value = size.toInt(&ok);
+        if (!ok || value <= 0)
+            return false;
+        layers << value;
+    }
+
+    int inputs = layers.takeFirst();
+    topology = NetworkTopology(inputs, layers);
+    return true;
+}
+
+static bool parseList(const QString &text, QVector<int> &values)
+{
+    values.clear();
+    for (const QString &item : text.split(','))
+    {
+        bool ok = false;
+        int value = item.toInt(&ok);
+        if (!ok || value <= 0)
+            return false;
+        values << value;
+    }
+    return true;
+}
+
+// Inputs in [-1, 1] and targets in [0, 1], the range of the sigmoid output layer
+static void randomDataset(Dataset &dataset, int samples, int inputSize, int outputSize, quint64 seed)
+{
+    Random random(seed);
+    QVector<float> rows(samples * (inputSize + outputSize));
+
+    for (int s = 0; s < samples; ++s)
+    {
+        float *row = rows.data() + s * (inputSize + outputSize);
+        for (int i = 0; i < inputSize; ++i)
+            row[i] = random.uniform() * 2 - 1;
+        for (int o = 0; o < outputSize; ++o)
+            row[inputSize + o] = random.uniform();
+    }
+
+    dataset.setData(rows.constData(), samples, inputSize, outputSize);
+}
+
+static std::unique_ptr<ThreadPool> makeThreadPool(int threads)
+{
+    // A single thread runs on the caller, as it would without a pool
+    return threads > 1 ? std::unique_ptr<ThreadPool>(new ThreadPool(threads)) : nullptr;
+}
+
+// Latency of one sample through each inference path, on one thread
+static void benchmarkForward(const BenchmarkOptions &options, ResultWriter &writer)
+{
+    const int rows = 256;
+
+    for (const NetworkTopology &topology : options.topologies)
+    {
+        Dataset dataset;
+        randomDataset(dataset, rows, topology.inputs(), topology.outputs(), 1);
+
+        NeuralNetwork network;
+        network.initialiseNetwork(topology);
+        Random random(2);
+        network.randomiseWeights(1000, random);
+
+        QVector<QVector<float>> inputVectors;
+        for (int s = 0; s < rows; ++s)
+            inputVectors << QVector<float>(dataset.row(s), dataset.row(s) + topology.inputs());
+
+        QVector<float> outputs(rows * topology.outputs());
+        ForwardPass forwardPass;
+        QuantizedNetwork int8Network(topology, network.genome(), QuantizationFormat::Int8);
+        QuantizedNetwork halfNetwork(topology, network.genome(), QuantizationFormat::Float16);
+
+        BenchmarkResult result;
+        result.benchmark = "forward";
+        result.topology = topologyName(topology);
+        result.samples = rows;
+        result.operations = rows;
+        result.unit = "samples";
+
+        auto run = [&](const char *variant, const auto &body)
+        {
+            result.variant = variant;
+            result.seconds = measure(options.minMsecs, result.repetitions, body);
+            writer.write(result);
+        };
+
+        run("forwardpass", [&]
+        {
+            for (int s = 0; s < rows; ++s)
+                benchmarkSink = forwardPass.run(topology, network.genome(), dataset.row(s))[0];
+        });
+
+        run("runMultiOutput", [&]
+        {
+            for (int s = 0; s < rows; ++s)
+                benchmarkSink = network.runMultiOutput(inputVectors[s])[0];
+        });
+
+        run("runBatch", [&]
+        {
+            network.runBatch(dataset.view(), outputs.data());
+            benchmarkSink = outputs[0];
+        });
+
+        run("int8", [&]
+        {
+            for (int s = 0; s < rows; ++s)
+                benchmarkSink = int8Network.run(dataset.row(s))[0];
+        });
+
+        run("fp16", [&]
+        {
+            for (int s = 0; s < rows; ++s)
+                benchmarkSink = halfNetwork.run(dataset.row(s))[0];
+        });
+    }
+}
+
+// Scoring throughput in genome-sample evaluations, the inner loop of every generation
+static void benchmarkEvaluate(const BenchmarkOptions &options, ResultWriter &writer)
+{
+    const int genomes = 512;
+    const int chunkSize = 8;
+
+    for (const NetworkTopology &topology : options.topologies)
+    {
+        Population population(genomes, topology);
+        population.randomise(1000, 3);
+        QVector<float> errors(genomes);
+
+        for (int samples : options.sampleCounts)
+        {
+            Dataset dataset;
+            randomDataset(dataset, samples, topology.inputs(), topology.outputs(), 4);
+            DatasetView view = dataset.view();
+
+            for (int threads : options.threadCounts)
+            {
+                std::unique_ptr<ThreadPool> threadPool = makeThreadPool(threads);
+
+                BenchmarkResult result;
+                result.benchmark = "evaluate";
+                result.topology = topologyName(topology);
+                result.poolSize = genomes;
+                result.samples = samples;
+                result.threads = threads;
+                result.operations = qint64(genomes) * samples;
+                result.unit = "genome-samples";
+
+                auto run = [&](const char *variant, const auto &score)
+                {
+                    auto body = [&](int first, int count)
+                    {
+                        score(first, count);
+                    };
+
+                    result.variant = variant;
+                    result.seconds = measure(options.minMsecs, result.repetitions, [&]
+                    {
+                        std::fill(errors.begin(), errors.end(), 0.0f);
+                        if (threadPool)
+                            threadPool->parallelFor(genomes, chunkSize, body);
+                        else
+                            body(0, genomes);
+                        benchmarkSink = errors[0];
+                    });
+                    writer.write(result);
+                };
+
+                run("generic", [&](int first, int count)
+                {
+                    static thread_local Evaluator evaluator;
+                    evaluator.evaluate(population, first, count, view, errors.data() + first);
+                });
+
+                // The specialisation the demo uses for the parity problem
+                using ParityNetwork = FixedNetwork<3, 2, 1>;
+                if (ParityNetwork::matches(topology))
+                {
+                    run("fixed", [&](int first, int count)
+                    {
+                        FixedEvaluator<ParityNetwork>::evaluate(topology, population.genome(first), population.stride(),
+                                                                count, view, errors.data() + first);
+                    });
+                }
+            }
+        }
+    }
+}
+
+// Whole generations, scoring, selection and breeding, with the engine's default settings
+static void benchmarkGeneration(const BenchmarkOptions &options, ResultWriter &writer)
+{
+    int samples = options.sampleCounts.first();
+
+    for (const NetworkTopology &topology : options.topologies)
+    {
+        Dataset dataset;
+        randomDataset(dataset, samples, topology.inputs(), topology.outputs(), 5);
+
+        for (int poolSize : options.poolSizes)
+        {
+            for (int threads : options.threadCounts)
+            {
+                std::unique_ptr<ThreadPool> threadPool = makeThreadPool(threads);
+
+                GenerationSettings settings;
+                settings.poolSize = poolSize;
+                settings.seed = 6;
+
+                GenerationEngine engine(topology, settings);
+                engine.setThreadPool(threadPool.get());
+                engine.setDataset(dataset.view());
+
+                BenchmarkResult result;
+                result.benchmark = "generation";
+                result.variant = "default";
+                result.topology = topologyName(topology);
+                result.poolSize = poolSize;
+                result.samples = samples;
+                result.threads = threads;
+                result.operations = 1;
+                result.unit = "generations";
+                result.seconds = measure(options.minMsecs, result.repetitions, [&]
+                {
+                    engine.runGeneration();
+                    benchmarkSink = engine.minError();
+                });
+                writer.write(result);
+            }
+        }
+    }
+}
+
+// Making the children of a generation from random parents, and copying whole networks
+static void benchmarkBreed(const BenchmarkOptions &options, ResultWriter &writer)
+{
+    for (const NetworkTopology &topology : options.topologies)
+    {
+        for (int poolSize : options.poolSizes)
+        {
+            Population parents(poolSize, topology);
+            Population children(poolSize, topology);
+            parents.randomise(1000, 7);
+            Random random(8);
+
+            BenchmarkResult result;
+            result.benchmark = "breed";
+            result.topology = topologyName(topology);
+            result.poolSize = poolSize;
+            result.operations = poolSize;
+            result.unit = "networks";
+
+            result.variant = "crossover";
+            result.seconds = measure(options.minMsecs, result.repetitions, [&]
+            {
+                for (int i = 0; i < poolSize; ++i)
+                {
+                    NeuralNetwork *mateA = parents.network(int(random.next() % quint64(poolSize)));
+                    NeuralNetwork *mateB = parents.network(int(random.next() % quint64(poolSize)));
+                    NeuralNetwork::crossOverBreed(children.network(i), mateA, mateB, 0.5f, 1.0f, random);
+                }
+                benchmarkSink = children.genome(0)[0];
+            });
+            writer.write(result);
+
+            result.variant = "clone";
+            result.seconds = measure(options.minMsecs, result.repetitions, [&]
+            {
+                for (int i = 0; i < poolSize; ++i)
+                    children.network(i)->clone(parents.network(i));
+                benchmarkSink = children.genome(0)[0];
+            });
+            writer.write(result);
+        }
+    }
+}
+
+// Choosing the breeding pool of one generation with each selection method
+static void benchmarkSelect(const BenchmarkOptions &options, ResultWriter &writer)
+{
+    const QVector<QPair<SelectionMethod, const char *>> methods = {
+        {SelectionMethod::Truncation, "truncation"},
+        {SelectionMethod::Tournament, "tournament"},
+        {SelectionMethod::Rank, "rank"},
+        {SelectionMethod::Roulette, "roulette"}
+    };
+
+    GenerationSettings defaults;
+
+    for (int poolSize : options.poolSizes)
+    {
+        Random random(9);
+        QVector<float> errors(poolSize);
+        for (float &error : errors)
+            error = random.uniform() * 100;
+
+        int parentCount = qMax(1, poolSize / defaults.tournamentSize);
+        QVector<int> parents(parentCount);
+
+        for (const auto &method : methods)
+        {
+            Selection selection;
+            selection.setMethod(method.first);
+            selection.setTournamentSize(defaults.tournamentSize);
+            selection.setRankPressure(defaults.rankPressure);
+
+            BenchmarkResult result;
+            result.benchmark = "select";
+            result.variant = method.second;
+            result.poolSize = poolSize;
+            result.operations = 1;
+            result.unit = "selections";
+            result.seconds = measure(options.minMsecs, result.repetitions, [&]
+            {
+                selection.select(errors.constData(), poolSize, parents.data(), parentCount, random);
+                benchmarkSink = float(parents[0]);
+            });
+            writer.write(result);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    BenchmarkOptions options;
+    bool quick = false;
+    QString topologies;
+    QString poolSizes;
+    QString sampleCounts;
+    QString threadCounts;
+
+    QStringList arguments = QCoreApplication::arguments();
+    for (int i = 1; i < arguments.size(); ++i)
+    {
+        const QString &argument = arguments[i];
+        bool hasValue = i + 1 < arguments.size();
+
+        if (argument == "--format" && hasValue)
+            options.csv = arguments[++i] == "csv";
+        else if (argument == "--output" && hasValue)
+            options.outputPath = arguments[++i];
+        else if (argument == "--filter" && hasValue)
+            options.benchmarks = arguments[++i].split(',');
+        else if (argument == "--topologies" && hasValue)
+            topologies = arguments[++i];
+        else if (argument == "--pool-sizes" && hasValue)
+            poolSizes = arguments[++i];
+        else if (argument == "--samples" && hasValue)
+            sampleCounts = arguments[++i];
+        else if (argument == "--threads" && hasValue)
+            threadCounts = arguments[++i];
+        else if (argument == "--min-time" && hasValue)
+            options.minMsecs = qMax(1, arguments[++i].toInt());
+        else if (argument == "--quick")
+            quick = true;
+        else
+        {
+            fprintf(stderr, "Unknown argument: %s\n", argument.toLocal8Bit().constData());
+            return 1;
+        }
+    }
+
+    if (topologies.isEmpty())
+        topologies = quick ? "3-2-1,16-8-1" : "3-2-1,16-8-1,64-32-8";
+    if (poolSizes.isEmpty())
+        poolSizes = quick ? "1000" : "1000,10000";
+    if (sampleCounts.isEmpty())
+        sampleCounts = quick ? "64" : "64,1024";
+    if (quick)
+        options.minMsecs = qMin(options.minMsecs, 20);
+
+    for (const QString &text : topologies.split(','))
+    {
+        NetworkTopology topology;
+        if (!parseTopology(text, topology))
+        {
+            fprintf(stderr, "Invalid topology: %s\n", text.toLocal8Bit().constData());
+            return 1;
+        }
+        options.topologies << topology;
+    }
+
+    if (!parseList(poolSizes, options.poolSizes) || !parseList(sampleCounts, options.sampleCounts)
+            || (!threadCounts.isEmpty() && !parseList(threadCounts, options.threadCounts)))
+    {
+        fprintf(stderr, "Pool sizes, samples and threads take comma separated positive numbers\n");
+        return 1;
+    }
+
+    // Scaling curves over 1, 2, 4 ... threads, ending at all cores
+    if (options.threadCounts.isEmpty())
+    {
+        int cores = qMax(1, QThread::idealThreadCount());
+        for (int threads = 1; threads < cores; threads *= 2)
+            options.threadCounts << threads;
+        options.threadCounts << cores;
+    }
+
+    ResultWriter writer;
+    if (!writer.open(options.outputPath, options.csv))
+    {
+        fprintf(stderr, "Could not open %s\n", options.outputPath.toLocal8Bit().constData());
+        return 1;
+    }
+
+    if (options.benchmarks.contains("forward"))
+        benchmarkForward(options, writer);
+    if (options.benchmarks.contains("evaluate"))
+        benchmarkEvaluate(options, writer);
+    if (options.benchmarks.contains("generation"))
+        benchmarkGeneration(options, writer);
+    if (options.benchmarks.contains("breed"))
+        benchmarkBreed(options, writer);
+    if (options.benchmarks.contains("select"))
+        benchmarkSelect(options, writer);
+
+    return 0;
+}
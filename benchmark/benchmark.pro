@@ -0,0 +1,12 @@
+QT -= gui
+QT += network
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = NeuralNetworkBenchmark
+
+include(../neuralnetwork.pri)
+
+SOURCES += \
+        benchmark.cpp
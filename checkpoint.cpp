@@ -0,0 +1,377 @@
+#include "checkpoint.h"
+#include "neuralnetwork.h"
+#include <QSaveFile>
+#include <cstring>
+
+static const char CheckpointMagic[8] = {'G', 'N', 'N', 'C', 'K', 'P', 'T', '\0'};
+static const quint64 SectionAlignment = 64;
+
+static quint64 alignSection(quint64 offset)
+{
+    return (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+}
+
+Checkpoint::Checkpoint()
+{
+}
+
+Checkpoint::~Checkpoint()
+{
+    close();
+}
+
+bool Checkpoint::open(const QString &path)
+{
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return fail(m_file.errorString());
+
+    qint64 size = m_file.size();
+    if (size < qint64(sizeof(CheckpointHeader)))
+        return fail("File too small for a checkpoint header");
+
+    // Private so that attached networks may write to their genes without touching the file
+    m_data = m_file.map(0, size, QFileDevice::MapPrivateOption);
+    if (!m_data)
+        return fail(m_file.errorString());
+
+    const auto *header = reinterpret_cast<const CheckpointHeader *>(m_data);
+
+    if (std::memcmp(header->magic, CheckpointMagic, sizeof(CheckpointMagic)) != 0)
+        return fail("Not a checkpoint file");
+    if (header->version != Version)
+        return fail("Unsupported checkpoint version " + QString::number(int(header->version)));
+    if (header->headerSize != sizeof(CheckpointHeader) || header->fileSize != quint64(size))
+        return fail("Truncated or corrupt checkpoint");
+    if (header->layerCount == 0 || header->inputs == 0 || header->stride < header->genomeSize)
+        return fail("Invalid checkpoint topology");
+
+    auto sectionFits = [&](quint64 offset, quint64 bytes)
+    {
+        return offset % SectionAlignment == 0 && offset <= quint64(size) && bytes <= quint64(size) - offset;
+    };
+
+    quint64 layerBytes = sizeof(quint32) * quint64(header->layerCount);
+    if (!sectionFits(header->layersOffset, layerBytes) || !sectionFits(header->activationsOffset, layerBytes)
+            || !sectionFits(header->errorsOffset, sizeof(float) * quint64(header->genomeCount))
+            || !sectionFits(header->genomesOffset, sizeof(float) * quint64(header->genomeCount) * header->stride)
+            || ((header->flags & HasBestGenome) && !sectionFits(header->bestGenomeOffset, sizeof(float) * quint64(header->genomeSize))))
+        return fail("Checkpoint section out of range");
+
+    const auto *layers = reinterpret_cast<const quint32 *>(m_data + header->layersOffset);
+    const auto *activations = reinterpret_cast<const quint32 *>(m_data + header->activationsOffset);
+
+    QVector<int> layerSizes;
+    for (quint32 layer = 0; layer < header->layerCount; ++layer)
+    {
+        if (layers[layer] == 0)
+            return fail("Invalid checkpoint topology");
+        layerSizes << int(layers[layer]);
+    }
+
+    m_topology = NetworkTopology(int(header->inputs), layerSizes);
+    if (quint32(m_topology.genomeSize()) != header->genomeSize)
+        return fail("Checkpoint genome size does not match its topology");
+
+    for (quint32 layer = 0; layer < header->layerCount; ++layer)
+    {
+        if (activations[layer] > quint32(Activation::HardSigmoid))
+            return fail("Unknown activation in checkpoint");
+        m_topology.setLayerActivation(int(layer), Activation(activations[layer]));
+    }
+
+    m_header = header;
+    return true;
+}
+
+void Checkpoint::close()
+{
+    if (m_data)
+        m_file.unmap(m_data);
+
+    m_file.close();
+    m_data = nullptr;
+    m_header = nullptr;
+    m_topology = NetworkTopology();
+}
+
+bool Checkpoint::isOpen() const
+{
+    return m_header;
+}
+
+QString Checkpoint::errorString() const
+{
+    return m_errorString;
+}
+
+bool Checkpoint::fail(const QString &error)
+{
+    m_errorString = m_file.fileName() + ": " + error;
+    close();
+    return false;
+}
+
+const NetworkTopology &Checkpoint::topology() const
+{
+    return m_topology;
+}
+
+int Checkpoint::genomeCount() const
+{
+    return int(m_header->genomeCount);
+}
+
+int Checkpoint::stride() const
+{
+    return int(m_header->stride);
+}
+
+float *Checkpoint::genome(int index)
+{
+    return reinterpret_cast<float *>(m_data + m_header->genomesOffset) + size_t(index) * m_header->stride;
+}
+
+const float *Checkpoint::genome(int index) const
+{
+    return reinterpret_cast<const float *>(m_data + m_header->genomesOffset) + size_t(index) * m_header->stride;
+}
+
+const float *Checkpoint::errors() const
+{
+    return reinterpret_cast<const float *>(m_data + m_header->errorsOffset);
+}
+
+bool Checkpoint::hasBestGenome() const
+{
+    return m_header->flags & HasBestGenome;
+}
+
+float *Checkpoint::bestGenome()
+{
+    return hasBestGenome() ? reinterpret_cast<float *>(m_data + m_header->bestGenomeOffset) : nullptr;
+}
+
+const float *Checkpoint::bestGenome() const
+{
+    return hasBestGenome() ? reinterpret_cast<const float *>(m_data + m_header->bestGenomeOffset) : nullptr;
+}
+
+float Checkpoint::bestError() const
+{
+    return m_header->bestError;
+}
+
+quint64 Checkpoint::generation() const
+{
+    return m_header->generation;
+}
+
+quint64 Checkpoint::seed() const
+{
+    return m_header->seed;
+}
+
+quint64 Checkpoint::randomKey() const
+{
+    return m_header->randomKey;
+}
+
+quint64 Checkpoint::randomCounter() const
+{
+    return m_header->randomCounter;
+}
+
+void Checkpoint::attachNetwork(NeuralNetwork *network, int index)
+{
+    network->attachGenome(genome(index), m_topology);
+    network->resetError();
+    network->setError(errors()[index]);
+}
+
+bool Checkpoint::write(const QString &path, const CheckpointSnapshot &snapshot, QString *errorString)
+{
+    const NetworkTopology &topology = snapshot.topology;
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CheckpointMagic, sizeof(CheckpointMagic));
+    header.version = Version;
+    header.headerSize = sizeof(CheckpointHeader);
+    header.inputs = quint32(topology.inputs());
+    header.layerCount = quint32(topology.layerCount());
+    header.genomeCount = quint32(snapshot.genomeCount);
+    header.genomeSize = quint32(topology.genomeSize());
+    header.stride = quint32(snapshot.stride);
+    header.flags = snapshot.bestGenome.isEmpty() ? 0 : HasBestGenome;
+    header.generation = snapshot.generation;
+    header.seed = snapshot.seed;
+    header.randomKey = snapshot.randomKey;
+    header.randomCounter = snapshot.randomCounter;
+    header.bestError = snapshot.bestError;
+
+    quint64 layerBytes = sizeof(quint32) * quint64(header.layerCount);
+    quint64 bestBytes = (header.flags & HasBestGenome) ? sizeof(float) * quint64(header.genomeSize) : 0;
+    quint64 genomeBytes = sizeof(float) * quint64(header.genomeCount) * header.stride;
+
+    header.layersOffset = alignSection(sizeof(CheckpointHeader));
+    header.activationsOffset = alignSection(header.layersOffset + layerBytes);
+    header.errorsOffset = alignSection(header.activationsOffset + layerBytes);
+    header.bestGenomeOffset = alignSection(header.errorsOffset + sizeof(float) * quint64(header.genomeCount));
+    header.genomesOffset = alignSection(header.bestGenomeOffset + bestBytes);
+    header.fileSize = header.genomesOffset + genomeBytes;
+
+    QVector<quint32> layers;
+    QVector<quint32> activations;
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+    {
+        layers << quint32(topology.layerSize(layer));
+        activations << quint32(topology.layerActivation(layer));
+    }
+
+    // Written section by section with zero padding in between, then renamed over the old file
+    QSaveFile file(path);
+    quint64 position = 0;
+    bool ok = file.open(QIODevice::WriteOnly);
+
+    auto writeSection = [&](quint64 offset, const void *data, quint64 bytes)
+    {
+        static const char padding[SectionAlignment] = {};
+
+        if (ok && offset > position)
+            ok = file.write(padding, qint64(offset - position)) == qint64(offset - position);
+        if (ok && bytes > 0)
+            ok = file.write(static_cast<const char *>(data), qint64(bytes)) == qint64(bytes);
+
+        position = offset + bytes;
+    };
+
+    writeSection(0, &header, sizeof(header));
+    writeSection(header.layersOffset, layers.constData(), layerBytes);
+    writeSection(header.activationsOffset, activations.constData(), layerBytes);
+    writeSection(header.errorsOffset, snapshot.errors.constData(), sizeof(float) * quint64(header.genomeCount));
+    writeSection(header.bestGenomeOffset, snapshot.bestGenome.constData(), bestBytes);
+    writeSection(header.genomesOffset, snapshot.genomes.constData(), genomeBytes);
+
+    if (ok)
+        ok = file.commit();
+
+    if (!ok && errorString)
+        *errorString = path + ": " + file.errorString();
+
+    return ok;
+}
+
+bool Checkpoint::writeNetwork(const QString &path, NeuralNetwork *network, QString *errorString)
+{
+    const NetworkTopology &topology = network->topology();
+
+    CheckpointSnapshot snapshot;
+    snapshot.topology = topology;
+    snapshot.genomeCount = 1;
+    snapshot.stride = topology.paddedGenomeSize();
+    snapshot.genomes = QVector<float>(snapshot.stride, 0.0f);
+    std::memcpy(snapshot.genomes.data(), network->genome(), sizeof(float) * size_t(topology.genomeSize()));
+    snapshot.errors = QVector<float>(1, network->error());
+
+    return write(path, snapshot, errorString);
+}
+
+CheckpointWriter::CheckpointWriter(const QString &path)
+    : m_path(path),
+      m_thread(&CheckpointWriter::run, this)
+{
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+QString CheckpointWriter::path() const
+{
+    return m_path;
+}
+
+CheckpointSnapshot *CheckpointWriter::acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_pending)
+    {
+        m_dropped++;
+        return nullptr;
+    }
+
+    return &m_snapshot;
+}
+
+void CheckpointWriter::submit()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = true;
+    }
+
+    m_condition.notify_all();
+}
+
+void CheckpointWriter::waitForIdle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this] { return !m_pending; });
+}
+
+int CheckpointWriter::writtenCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_written;
+}
+
+int CheckpointWriter::droppedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+QString CheckpointWriter::lastError() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastError;
+}
+
+void CheckpointWriter::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;)
+    {
+        // A pending snapshot is still written when stopping
+        m_condition.wait(lock, [this] { return m_pending || m_stopping; });
+
+        if (!m_pending)
+            return;
+
+        // The snapshot is not touched by the loop while pending, so it is written unlocked
+        lock.unlock();
+        QString error;
+        bool ok = Checkpoint::write(m_path, m_snapshot, &error);
+        lock.lock();
+
+        if (ok)
+            m_written++;
+        else
+            m_lastError = error;
+
+        m_pending = false;
+        m_condition.notify_all();
+    }
+}
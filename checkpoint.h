@@ -0,0 +1,164 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "networktopology.h"
+
+class NeuralNetwork;
+
+// Everything needed to resume a run, in memory. The genomes keep the population's stride.
+struct CheckpointSnapshot
+{
+    NetworkTopology topology;
+    int genomeCount = 0;
+    int stride = 0;
+    QVector<float> genomes;
+    QVector<float> errors;
+
+    // Best network found so far, empty when there is none
+    QVector<float> bestGenome;
+    float bestError = 0;
+
+    quint64 generation = 0;
+    quint64 seed = 0;
+    quint64 randomKey = 0;
+    quint64 randomCounter = 0;
+};
+
+// On disk layout of a checkpoint, native endian. Every section starts on a 64 byte boundary,
+// so a mapped file can be used in place.
+struct CheckpointHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 headerSize;
+
+    quint32 inputs;
+    quint32 layerCount;
+    quint32 genomeCount;
+    quint32 genomeSize;
+    quint32 stride;
+    quint32 flags;
+
+    quint64 generation;
+    quint64 seed;
+    quint64 randomKey;
+    quint64 randomCounter;
+    float bestError;
+    quint32 reserved;
+
+    // quint32 per layer for the sizes and the activations, a float per genome for the errors,
+    // genomeSize floats for the best genome and genomeCount * stride floats for the population
+    quint64 layersOffset;
+    quint64 activationsOffset;
+    quint64 errorsOffset;
+    quint64 bestGenomeOffset;
+    quint64 genomesOffset;
+    quint64 fileSize;
+};
+
+// A checkpoint file mapped into memory. Loading validates the header and then only hands
+// out pointers into the mapping, which is private so networks can be attached to it directly.
+class Checkpoint
+{
+public:
+    static const quint32 Version = 1;
+
+    enum Flags : quint32
+    {
+        HasBestGenome = 1
+    };
+
+    Checkpoint();
+    ~Checkpoint();
+
+    Checkpoint(const Checkpoint &) = delete;
+    Checkpoint &operator=(const Checkpoint &) = delete;
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+
+    const NetworkTopology &topology() const;
+    int genomeCount() const;
+    int stride() const;
+
+    float *genome(int index);
+    const float *genome(int index) const;
+    const float *errors() const;
+
+    bool hasBestGenome() const;
+    float *bestGenome();
+    const float *bestGenome() const;
+    float bestError() const;
+
+    quint64 generation() const;
+    quint64 seed() const;
+    quint64 randomKey() const;
+    quint64 randomCounter() const;
+
+    // Makes network a view over genome index, valid until the checkpoint is closed
+    void attachNetwork(NeuralNetwork *network, int index);
+
+    static bool write(const QString &path, const CheckpointSnapshot &snapshot, QString *errorString = nullptr);
+    static bool writeNetwork(const QString &path, NeuralNetwork *network, QString *errorString = nullptr);
+
+private:
+    bool fail(const QString &error);
+
+    QFile m_file;
+    uchar *m_data = nullptr;
+    const CheckpointHeader *m_header = nullptr;
+    NetworkTopology m_topology;
+    QString m_errorString;
+};
+
+// Writes snapshots on a background thread. The evolution loop only copies its state into the
+// staging snapshot, and when the previous snapshot is still being written the new one is dropped.
+class CheckpointWriter
+{
+public:
+    explicit CheckpointWriter(const QString &path);
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    QString path() const;
+
+    // Staging snapshot to fill, or nullptr while the writer is busy. Hand it back with submit().
+    CheckpointSnapshot *acquire();
+    void submit();
+
+    // Blocks until the pending snapshot, if any, is on disk
+    void waitForIdle();
+
+    int writtenCount() const;
+    int droppedCount() const;
+    QString lastError() const;
+
+private:
+    void run();
+
+    QString m_path;
+    CheckpointSnapshot m_snapshot;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_pending = false;
+    bool m_stopping = false;
+    int m_written = 0;
+    int m_dropped = 0;
+    QString m_lastError;
+
+    std::thread m_thread;
+};
+
+#endif // CHECKPOINT_H
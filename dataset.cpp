@@ -0,0 +1,528 @@
+#include "dataset.h"
+#include <QSaveFile>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static const char DatasetMagic[8] = {'G', 'N', 'N', 'D', 'A', 'T', 'A', '\0'};
+static const quint64 DataAlignment = 64;
+static const int ReadBlockSize = 1 << 20;
+static const int WriteBlockRows = 1 << 14;
+
+DatasetView DatasetView::rows(int first, int count) const
+{
+    DatasetView view = *this;
+    view.inputs = inputRow(first);
+    view.targets = targetRow(first);
+    view.samples = count;
+
+    return view;
+}
+
+// Parses a decimal number the way "C" locale strtof would, without depending on the process locale
+static bool parseNumber(const char *&text, float &value)
+{
+    const char *p = text;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+')
+        p++;
+
+    quint64 mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+
+    for (; *p >= '0' && *p <= '9'; ++p, ++digits)
+    {
+        if (mantissa < 100000000000000000ULL)
+            mantissa = mantissa * 10 + quint64(*p - '0');
+        else
+            exponent++;
+    }
+
+    if (*p == '.')
+    {
+        for (++p; *p >= '0' && *p <= '9'; ++p, ++digits)
+        {
+            if (mantissa < 100000000000000000ULL)
+            {
+                mantissa = mantissa * 10 + quint64(*p - '0');
+                exponent--;
+            }
+        }
+    }
+
+    if (digits == 0)
+        return false;
+
+    if (*p == 'e' || *p == 'E')
+    {
+        const char *e = p + 1;
+        bool negativeExponent = *e == '-';
+        if (*e == '-' || *e == '+')
+            e++;
+
+        if (*e >= '0' && *e <= '9')
+        {
+            int power = 0;
+            for (; *e >= '0' && *e <= '9'; ++e)
+                power = qMin(power * 10 + (*e - '0'), 1000);
+
+            exponent += negativeExponent ? -power : power;
+            p = e;
+        }
+    }
+
+    double result = double(mantissa);
+    if (exponent < 0)
+        result /= std::pow(10.0, -exponent);
+    else if (exponent > 0)
+        result *= std::pow(10.0, exponent);
+
+    value = float(negative ? -result : result);
+    text = p;
+    return true;
+}
+
+// Splits one NUL terminated line into values, returns false if a field is not a number
+static bool parseCsvLine(const char *line, QVector<float> &values)
+{
+    values.resize(0);
+
+    for (const char *p = line; ; ++p)
+    {
+        while (*p == ' ' || *p == '\t')
+            p++;
+
+        float value;
+        if (!parseNumber(p, value))
+            return false;
+
+        while (*p == ' ' || *p == '\t')
+            p++;
+
+        values.append(value);
+
+        if (*p == '\0')
+            return true;
+        if (*p != ',')
+            return false;
+    }
+}
+
+// Reads path a block at a time and calls handleRow(values, columns) for every line of numbers
+template<typename RowHandler>
+static bool parseCsv(const QString &path, QString &error, const RowHandler &handleRow)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        error = path + ": " + file.errorString();
+        return false;
+    }
+
+    // One byte is kept spare to terminate a last line without a newline
+    QByteArray buffer;
+    buffer.resize(ReadBlockSize + 1);
+    int filled = 0;
+    bool atEnd = false;
+
+    QVector<float> values;
+    int columns = -1;
+    qint64 lineNumber = 0;
+
+    while (!atEnd)
+    {
+        // A line longer than the buffer
+        if (filled == buffer.size() - 1)
+            buffer.resize(buffer.size() * 2);
+
+        qint64 read = file.read(buffer.data() + filled, buffer.size() - 1 - filled);
+        if (read < 0)
+        {
+            error = path + ": " + file.errorString();
+            return false;
+        }
+
+        atEnd = read == 0;
+        filled += int(read);
+
+        char *data = buffer.data();
+        int start = 0;
+
+        while (start < filled)
+        {
+            auto *newline = static_cast<char *>(std::memchr(data + start, '\n', size_t(filled - start)));
+            int end = newline ? int(newline - data) : filled;
+
+            if (!newline && !atEnd)
+                break;
+
+            data[end] = '\0';
+            if (end > start && data[end - 1] == '\r')
+                data[end - 1] = '\0';
+
+            lineNumber++;
+            const char *line = data + start;
+            start = end + 1;
+
+            while (*line == ' ' || *line == '\t')
+                line++;
+
+            if (*line == '\0')
+                continue;
+
+            if (!parseCsvLine(line, values))
+            {
+                if (lineNumber == 1)
+                    continue;
+
+                error = path + ":" + QString::number(lineNumber) + ": not a list of numbers";
+                return false;
+            }
+
+            if (columns < 0)
+                columns = values.size();
+
+            if (values.size() != columns)
+            {
+                error = path + ":" + QString::number(lineNumber) + ": expected " + QString::number(columns) + " columns";
+                return false;
+            }
+
+            if (!handleRow(values.constData(), columns))
+                return false;
+        }
+
+        start = qMin(start, filled);
+        std::memmove(data, data + start, size_t(filled - start));
+        filled -= start;
+    }
+
+    return true;
+}
+
+Dataset::Dataset()
+{
+}
+
+Dataset::~Dataset()
+{
+    close();
+}
+
+bool Dataset::loadCsv(const QString &path, int outputSize)
+{
+    close();
+
+    int columns = 0;
+    int samples = 0;
+
+    bool ok = parseCsv(path, m_errorString, [&](const float *values, int rowColumns)
+    {
+        if (rowColumns <= outputSize)
+        {
+            m_errorString = path + ": needs more than " + QString::number(outputSize) + " columns";
+            return false;
+        }
+
+        columns = rowColumns;
+        samples++;
+
+        for (int c = 0; c < rowColumns; ++c)
+            m_rows.append(values[c]);
+
+        return true;
+    });
+
+    if (ok && samples == 0)
+    {
+        ok = false;
+        m_errorString = path + ": no samples";
+    }
+
+    if (!ok)
+    {
+        m_rows = QVector<float>();
+        return false;
+    }
+
+    m_data = m_rows.constData();
+    m_samples = samples;
+    m_inputSize = columns - outputSize;
+    m_outputSize = outputSize;
+
+    return true;
+}
+
+bool Dataset::openBinary(const QString &path)
+{
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return fail(m_file.errorString());
+
+    qint64 size = m_file.size();
+    if (size < qint64(sizeof(DatasetHeader)))
+        return fail("File too small for a dataset header");
+
+    m_mapping = m_file.map(0, size);
+    if (!m_mapping)
+        return fail(m_file.errorString());
+
+    const auto *header = reinterpret_cast<const DatasetHeader *>(m_mapping);
+
+    if (std::memcmp(header->magic, DatasetMagic, sizeof(DatasetMagic)) != 0)
+        return fail("Not a packed dataset");
+    if (header->version != Version)
+        return fail("Unsupported dataset version " + QString::number(int(header->version)));
+    if (header->headerSize != sizeof(DatasetHeader) || header->fileSize != quint64(size))
+        return fail("Truncated or corrupt dataset");
+    if (header->inputSize == 0 || header->outputSize == 0 || header->samples > quint64(std::numeric_limits<int>::max()))
+        return fail("Invalid dataset dimensions");
+
+    quint64 rowBytes = sizeof(float) * (quint64(header->inputSize) + header->outputSize);
+    if (header->dataOffset % DataAlignment != 0 || header->dataOffset + header->samples * rowBytes != header->fileSize)
+        return fail("Truncated or corrupt dataset");
+
+    m_data = reinterpret_cast<const float *>(m_mapping + header->dataOffset);
+    m_samples = int(header->samples);
+    m_inputSize = int(header->inputSize);
+    m_outputSize = int(header->outputSize);
+
+    return true;
+}
+
+bool Dataset::load(const QString &path, int outputSize)
+{
+    QFile file(path);
+    char magic[sizeof(DatasetMagic)] = {};
+
+    if (file.open(QIODevice::ReadOnly) && file.read(magic, sizeof(magic)) == qint64(sizeof(magic))
+            && std::memcmp(magic, DatasetMagic, sizeof(magic)) == 0)
+        return openBinary(path);
+
+    return loadCsv(path, outputSize);
+}
+
+void Dataset::setData(const float *rows, int samples, int inputSize, int outputSize)
+{
+    close();
+
+    m_rows.resize(samples * (inputSize + outputSize));
+    std::copy(rows, rows + m_rows.size(), m_rows.begin());
+
+    m_data = m_rows.constData();
+    m_samples = samples;
+    m_inputSize = inputSize;
+    m_outputSize = outputSize;
+}
+
+void Dataset::close()
+{
+    if (m_mapping)
+        m_file.unmap(m_mapping);
+
+    m_file.close();
+    m_mapping = nullptr;
+    m_rows = QVector<float>();
+
+    m_data = nullptr;
+    m_samples = 0;
+    m_inputSize = 0;
+    m_outputSize = 0;
+}
+
+bool Dataset::fail(const QString &error)
+{
+    m_errorString = m_file.fileName() + ": " + error;
+    close();
+    return false;
+}
+
+QString Dataset::errorString() const
+{
+    return m_errorString;
+}
+
+bool Dataset::isEmpty() const
+{
+    return m_samples == 0;
+}
+
+bool Dataset::isMapped() const
+{
+    return m_mapping;
+}
+
+int Dataset::samples() const
+{
+    return m_samples;
+}
+
+int Dataset::inputSize() const
+{
+    return m_inputSize;
+}
+
+int Dataset::outputSize() const
+{
+    return m_outputSize;
+}
+
+int Dataset::columns() const
+{
+    return m_inputSize + m_outputSize;
+}
+
+const float *Dataset::row(int sample) const
+{
+    return m_data + size_t(sample) * size_t(columns());
+}
+
+DatasetView Dataset::view() const
+{
+    DatasetView view;
+    view.inputs = m_data;
+    view.targets = m_data ? m_data + m_inputSize : nullptr;
+    view.samples = m_samples;
+    view.inputSize = m_inputSize;
+    view.outputSize = m_outputSize;
+    view.inputStride = columns();
+    view.targetStride = columns();
+
+    return view;
+}
+
+// Collects rows and writes them WriteBlockRows at a time behind a header that is patched at the end
+class PackedDatasetWriter
+{
+public:
+    explicit PackedDatasetWriter(const QString &path)
+        : m_file(path)
+    {
+    }
+
+    bool begin(int inputSize, int outputSize)
+    {
+        std::memset(&m_header, 0, sizeof(m_header));
+        std::memcpy(m_header.magic, DatasetMagic, sizeof(DatasetMagic));
+        m_header.version = Dataset::Version;
+        m_header.headerSize = sizeof(DatasetHeader);
+        m_header.inputSize = quint32(inputSize);
+        m_header.outputSize = quint32(outputSize);
+        m_header.dataOffset = (sizeof(DatasetHeader) + DataAlignment - 1) / DataAlignment * DataAlignment;
+
+        m_columns = inputSize + outputSize;
+        m_block.resize(0);
+        m_block.reserve(WriteBlockRows * m_columns);
+
+        static const char padding[DataAlignment] = {};
+
+        return m_file.open(QIODevice::WriteOnly)
+                && m_file.write(reinterpret_cast<const char *>(&m_header), sizeof(m_header)) == qint64(sizeof(m_header))
+                && m_file.write(padding, qint64(m_header.dataOffset - sizeof(m_header))) == qint64(m_header.dataOffset - sizeof(m_header));
+    }
+
+    bool addRow(const float *inputs, const float *targets)
+    {
+        int size = m_block.size();
+        m_block.resize(size + m_columns);
+        std::copy(inputs, inputs + m_header.inputSize, m_block.begin() + size);
+        std::copy(targets, targets + m_header.outputSize, m_block.begin() + size + m_header.inputSize);
+        m_header.samples++;
+
+        return m_block.size() < WriteBlockRows * m_columns || flush();
+    }
+
+    bool finish()
+    {
+        m_header.fileSize = m_header.dataOffset + sizeof(float) * m_header.samples * quint64(m_columns);
+
+        return flush() && m_file.seek(0)
+                && m_file.write(reinterpret_cast<const char *>(&m_header), sizeof(m_header)) == qint64(sizeof(m_header))
+                && m_file.commit();
+    }
+
+    QString errorString() const
+    {
+        return m_file.fileName() + ": " + m_file.errorString();
+    }
+
+private:
+    bool flush()
+    {
+        qint64 bytes = qint64(sizeof(float)) * m_block.size();
+        bool ok = m_file.write(reinterpret_cast<const char *>(m_block.constData()), bytes) == bytes;
+        m_block.resize(0);
+        return ok;
+    }
+
+    QSaveFile m_file;
+    DatasetHeader m_header;
+    int m_columns = 0;
+    QVector<float> m_block;
+};
+
+bool Dataset::writeBinary(const QString &path, const DatasetView &view, QString *errorString)
+{
+    PackedDatasetWriter writer(path);
+    bool ok = writer.begin(view.inputSize, view.outputSize);
+
+    for (int sample = 0; ok && sample < view.samples; ++sample)
+        ok = writer.addRow(view.inputRow(sample), view.targetRow(sample));
+
+    ok = ok && writer.finish();
+
+    if (!ok && errorString)
+        *errorString = writer.errorString();
+
+    return ok;
+}
+
+bool Dataset::convertCsv(const QString &csvPath, const QString &binaryPath, int outputSize, QString *errorString)
+{
+    PackedDatasetWriter writer(binaryPath);
+    QString error;
+    bool started = false;
+    bool writeFailed = false;
+
+    bool ok = parseCsv(csvPath, error, [&](const float *values, int columns)
+    {
+        if (columns <= outputSize)
+        {
+            error = csvPath + ": needs more than " + QString::number(outputSize) + " columns";
+            return false;
+        }
+
+        if (!started)
+        {
+            started = true;
+            if (!writer.begin(columns - outputSize, outputSize))
+            {
+                writeFailed = true;
+                return false;
+            }
+        }
+
+        writeFailed = !writer.addRow(values, values + columns - outputSize);
+        return !writeFailed;
+    });
+
+    if (ok && !started)
+    {
+        ok = false;
+        error = csvPath + ": no samples";
+    }
+
+    if (ok && !writer.finish())
+    {
+        ok = false;
+        writeFailed = true;
+    }
+
+    if (!ok && errorString)
+        *errorString = writeFailed ? writer.errorString() : error;
+
+    return ok;
+}
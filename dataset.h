@@ -0,0 +1,108 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// Row-major view over a block of training samples, one row per sample
+struct DatasetView
+{
+    const float *inputs = nullptr;
+    const float *targets = nullptr;
+    int samples = 0;
+    int inputSize = 0;
+    int outputSize = 0;
+
+    // Floats from one row to the next, 0 for rows packed back to back
+    int inputStride = 0;
+    int targetStride = 0;
+
+    const float *inputRow(int sample) const;
+    const float *targetRow(int sample) const;
+
+    DatasetView rows(int first, int count) const;
+};
+
+inline const float *DatasetView::inputRow(int sample) const
+{
+    return inputs + size_t(sample) * size_t(inputStride ? inputStride : inputSize);
+}
+
+inline const float *DatasetView::targetRow(int sample) const
+{
+    return targets + size_t(sample) * size_t(targetStride ? targetStride : outputSize);
+}
+
+// On disk layout of a packed dataset, native endian: the header, then from dataOffset one
+// row of inputSize inputs followed by outputSize targets per sample.
+struct DatasetHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 headerSize;
+    quint64 samples;
+    quint32 inputSize;
+    quint32 outputSize;
+    quint64 dataOffset;
+    quint64 fileSize;
+};
+
+// Training samples as one contiguous row-major matrix, each row holding a sample's inputs and
+// then its targets. The matrix is either owned or a read-only mapping of a packed file, which
+// the OS pages in as the evaluator walks it, so files larger than memory are never copied.
+class Dataset
+{
+public:
+    static const quint32 Version = 1;
+
+    Dataset();
+    ~Dataset();
+
+    Dataset(const Dataset &) = delete;
+    Dataset &operator=(const Dataset &) = delete;
+
+    // The last outputSize columns of every line are the targets. A first line that does not
+    // parse as numbers is taken as a header.
+    bool loadCsv(const QString &path, int outputSize);
+    bool openBinary(const QString &path);
+
+    // Opens a packed file, anything else is read as CSV
+    bool load(const QString &path, int outputSize);
+
+    // Copies samples rows of inputSize + outputSize floats
+    void setData(const float *rows, int samples, int inputSize, int outputSize);
+    void close();
+
+    QString errorString() const;
+
+    bool isEmpty() const;
+    bool isMapped() const;
+    int samples() const;
+    int inputSize() const;
+    int outputSize() const;
+    int columns() const;
+
+    const float *row(int sample) const;
+    DatasetView view() const;
+
+    static bool writeBinary(const QString &path, const DatasetView &view, QString *errorString = nullptr);
+
+    // Streams a CSV file into the packed format a block at a time, for data larger than memory
+    static bool convertCsv(const QString &csvPath, const QString &binaryPath, int outputSize, QString *errorString = nullptr);
+
+private:
+    bool fail(const QString &error);
+
+    QVector<float> m_rows;
+    QFile m_file;
+    uchar *m_mapping = nullptr;
+
+    const float *m_data = nullptr;
+    int m_samples = 0;
+    int m_inputSize = 0;
+    int m_outputSize = 0;
+    QString m_errorString;
+};
+
+#endif // DATASET_H
@@ -0,0 +1,837 @@
+#include "distributedengine.h"
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static const char ProtocolMagic[8] = {'G', 'N', 'N', 'D', 'I', 'S', 'T', '\0'};
+static const quint32 ProtocolVersion = 2;
+// Reads back as another value on a peer of the other byte order
+static const quint32 ByteOrderMark = 0x01020304;
+static const quint32 MaxPayloadSize = 1u << 30;
+static const int ConnectRetryInterval = 100;
+
+struct MessageHeader
+{
+    quint32 type;
+    quint32 size;
+};
+
+// Appends native endian values to a payload
+class MessageWriter
+{
+public:
+    template<typename T>
+    void write(T value)
+    {
+        m_data.append(reinterpret_cast<const char *>(&value), int(sizeof(T)));
+    }
+
+    void write(const float *values, int count)
+    {
+        m_data.append(reinterpret_cast<const char *>(values), int(sizeof(float)) * count);
+    }
+
+    const QByteArray &data() const
+    {
+        return m_data;
+    }
+
+private:
+    QByteArray m_data;
+};
+
+// Reads a payload back, running past its end invalidates the reader instead of reading garbage
+class MessageReader
+{
+public:
+    explicit MessageReader(const QByteArray &data)
+        : m_data(data)
+    {
+    }
+
+    template<typename T>
+    T read()
+    {
+        T value = T();
+        readBytes(&value, sizeof(T));
+        return value;
+    }
+
+    void read(float *values, int count)
+    {
+        readBytes(values, sizeof(float) * size_t(qMax(0, count)));
+    }
+
+    bool isValid() const
+    {
+        return m_valid;
+    }
+
+    bool atEnd() const
+    {
+        return m_position == size_t(m_data.size());
+    }
+
+    size_t remaining() const
+    {
+        return m_valid ? size_t(m_data.size()) - m_position : 0;
+    }
+
+private:
+    void readBytes(void *data, size_t bytes)
+    {
+        if (!m_valid || bytes > size_t(m_data.size()) - m_position)
+        {
+            m_valid = false;
+            return;
+        }
+
+        std::memcpy(data, m_data.constData() + m_position, bytes);
+        m_position += bytes;
+    }
+
+    const QByteArray &m_data;
+    size_t m_position = 0;
+    bool m_valid = true;
+};
+
+static bool isLocalAddress(const QString &address)
+{
+    return address.startsWith("unix:");
+}
+
+static QString localServerName(const QString &address)
+{
+    return address.mid(5);
+}
+
+static bool parseTcpAddress(const QString &address, QString &host, quint16 &port)
+{
+    int colon = address.lastIndexOf(':');
+    bool ok = false;
+
+    host = address.left(colon);
+    port = colon > 0 ? address.mid(colon + 1).toUShort(&ok) : 0;
+    return ok;
+}
+
+static void writeTopology(MessageWriter &writer, const NetworkTopology &topology)
+{
+    writer.write(quint32(topology.inputs()));
+    writer.write(quint32(topology.layerCount()));
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+    {
+        writer.write(quint32(topology.layerSize(layer)));
+        writer.write(quint32(topology.layerActivation(layer)));
+    }
+}
+
+static bool readTopology(MessageReader &reader, NetworkTopology &topology)
+{
+    int inputs = int(reader.read<quint32>());
+    quint32 layerCount = reader.read<quint32>();
+
+    QVector<int> layers;
+    QVector<Activation> activations;
+    quint64 genomeSize = 0;
+    int previousSize = inputs;
+    for (quint32 layer = 0; layer < layerCount && reader.isValid(); ++layer)
+    {
+        int size = int(reader.read<quint32>());
+        quint32 activation = reader.read<quint32>();
+        if (size <= 0 || activation > quint32(Activation::HardSigmoid))
+            return false;
+
+        // Weights and a bias per perceptron, kept small enough for the int sizes of a population
+        genomeSize += quint64(size) * (quint64(qMax(0, previousSize)) + 1);
+        if (genomeSize > quint64(std::numeric_limits<int>::max()))
+            return false;
+
+        layers << size;
+        activations << Activation(activation);
+        previousSize = size;
+    }
+
+    if (!reader.isValid() || inputs <= 0 || layers.isEmpty())
+        return false;
+
+    topology = NetworkTopology(inputs, layers);
+    for (int layer = 0; layer < activations.size(); ++layer)
+        topology.setLayerActivation(layer, activations[layer]);
+
+    return true;
+}
+
+static void writeSettings(MessageWriter &writer, const GenerationSettings &settings)
+{
+    writer.write(qint32(settings.poolSize));
+    writer.write(qint32(settings.tournamentSize));
+    writer.write(quint32(settings.selectionMethod));
+    writer.write(settings.rankPressure);
+    writer.write(quint8(settings.earlyAbort));
+    writer.write(quint8(settings.fitnessCache));
+    writer.write(quint8(settings.incrementalEvaluation));
+    writer.write(qint32(settings.miniBatchSize));
+    writer.write(qint32(settings.miniBatchStrata));
+    writer.write(qint32(settings.eliteRescoreInterval));
+    writer.write(qint32(settings.eliteRescoreCount));
+    writer.write(qint32(settings.fineTuneCount));
+    writer.write(qint32(settings.fineTuneSteps));
+    writer.write(qint32(settings.fineTuneBatchSize));
+    writer.write(settings.learningRate);
+    writer.write(quint32(settings.fineTuneMode));
+    writer.write(settings.mutationRate);
+    writer.write(settings.mutationMaxChange);
+    writer.write(quint8(settings.sigmoidOutputLayer));
+    writer.write(settings.seed);
+}
+
+// Settings a peer sends are checked for what the engines divide by, size buffers with or switch on
+static bool readSettings(MessageReader &reader, GenerationSettings &settings)
+{
+    settings.poolSize = reader.read<qint32>();
+    settings.tournamentSize = reader.read<qint32>();
+    quint32 selectionMethod = reader.read<quint32>();
+    settings.rankPressure = reader.read<float>();
+    settings.earlyAbort = reader.read<quint8>();
+    settings.fitnessCache = reader.read<quint8>();
+    settings.incrementalEvaluation = reader.read<quint8>();
+    settings.miniBatchSize = reader.read<qint32>();
+    settings.miniBatchStrata = reader.read<qint32>();
+    settings.eliteRescoreInterval = reader.read<qint32>();
+    settings.eliteRescoreCount = reader.read<qint32>();
+    settings.fineTuneCount = reader.read<qint32>();
+    settings.fineTuneSteps = reader.read<qint32>();
+    settings.fineTuneBatchSize = reader.read<qint32>();
+    settings.learningRate = reader.read<float>();
+    quint32 fineTuneMode = reader.read<quint32>();
+    settings.mutationRate = reader.read<float>();
+    settings.mutationMaxChange = reader.read<float>();
+    settings.sigmoidOutputLayer = reader.read<quint8>();
+    settings.seed = reader.read<quint64>();
+
+    if (!reader.isValid() || selectionMethod > quint32(SelectionMethod::Roulette) || fineTuneMode > quint32(FineTuneMode::Baldwinian))
+        return false;
+
+    settings.selectionMethod = SelectionMethod(selectionMethod);
+    settings.fineTuneMode = FineTuneMode(fineTuneMode);
+
+    return settings.poolSize > 0 && settings.tournamentSize > 0
+            && settings.miniBatchSize >= 0 && settings.miniBatchStrata >= 1
+            && settings.eliteRescoreInterval >= 1 && settings.eliteRescoreCount >= 0
+            && settings.fineTuneCount >= 0 && settings.fineTuneSteps >= 0 && settings.fineTuneBatchSize > 0
+            && std::isfinite(settings.rankPressure) && std::isfinite(settings.learningRate)
+            && std::isfinite(settings.mutationRate) && std::isfinite(settings.mutationMaxChange);
+}
+
+MessageChannel::MessageChannel(QIODevice *socket)
+    : m_socket(socket)
+{
+}
+
+MessageChannel::~MessageChannel()
+{
+    delete m_socket;
+}
+
+bool MessageChannel::send(MessageType type, const QByteArray &payload)
+{
+    MessageHeader header;
+    header.type = quint32(type);
+    header.size = quint32(payload.size());
+
+    if (m_socket->write(reinterpret_cast<const char *>(&header), sizeof(header)) != qint64(sizeof(header))
+            || m_socket->write(payload.constData(), payload.size()) != qint64(payload.size()))
+        return fail(m_socket->errorString());
+
+    while (m_socket->bytesToWrite() > 0)
+    {
+        if (!m_socket->waitForBytesWritten(-1))
+            return fail(m_socket->errorString());
+    }
+
+    return true;
+}
+
+bool MessageChannel::receive(MessageType &type, QByteArray &payload, int msecs)
+{
+    MessageHeader header;
+    if (!readExactly(reinterpret_cast<char *>(&header), sizeof(header), msecs))
+        return false;
+
+    if (header.type > quint32(MessageType::Shutdown))
+        return fail("Unknown message type " + QString::number(int(header.type)));
+    if (header.size > MaxPayloadSize)
+        return fail("Message too large");
+
+    type = MessageType(header.type);
+    payload.resize(int(header.size));
+    return readExactly(payload.data(), header.size, msecs);
+}
+
+bool MessageChannel::expect(MessageType expected, QByteArray &payload, int msecs)
+{
+    MessageType type;
+    if (!receive(type, payload, msecs))
+        return false;
+
+    if (type != expected)
+        return fail("Unexpected message type " + QString::number(int(type)));
+
+    return true;
+}
+
+QString MessageChannel::errorString() const
+{
+    return m_errorString;
+}
+
+bool MessageChannel::readExactly(char *data, qint64 size, int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    while (size > 0)
+    {
+        if (m_socket->bytesAvailable() == 0)
+        {
+            int remaining = msecs < 0 ? -1 : int(qMax(qint64(0), msecs - timer.elapsed()));
+            if (!m_socket->waitForReadyRead(remaining))
+                return fail(m_socket->errorString());
+        }
+
+        qint64 read = m_socket->read(data, size);
+        if (read < 0)
+            return fail(m_socket->errorString());
+
+        data += read;
+        size -= read;
+    }
+
+    return true;
+}
+
+bool MessageChannel::fail(const QString &error)
+{
+    m_errorString = error;
+    return false;
+}
+
+DistributedCoordinator::DistributedCoordinator(const NetworkTopology &topology, const GenerationSettings &settings, const IslandSettings &islandSettings)
+    : m_topology(topology),
+      m_settings(settings),
+      m_islandSettings(islandSettings)
+{
+    m_islandSettings.islandCount = qMax(1, islandSettings.islandCount);
+
+    // The workers' populations drop the output sigmoid the same way, so the best network runs as trained
+    if (!settings.sigmoidOutputLayer)
+        m_topology.setOutputActivation(Activation::Identity);
+
+    m_bestNetwork.initialiseNetwork(m_topology);
+}
+
+DistributedCoordinator::~DistributedCoordinator()
+{
+    shutdown();
+    delete m_tcpServer;
+    delete m_localServer;
+}
+
+bool DistributedCoordinator::listen(const QString &address)
+{
+    if (isLocalAddress(address))
+    {
+        m_localServer = new QLocalServer;
+
+        // A coordinator that crashed leaves its socket file behind
+        QLocalServer::removeServer(localServerName(address));
+        if (!m_localServer->listen(localServerName(address)))
+            return fail(address + ": " + m_localServer->errorString());
+
+        return true;
+    }
+
+    QString host;
+    quint16 port;
+    if (!parseTcpAddress(address, host, port))
+        return fail(address + ": Expected host:port or unix:path");
+
+    QHostAddress hostAddress(host);
+    if (host.isEmpty() || host == "*")
+        hostAddress = QHostAddress(QHostAddress::Any);
+    else if (host == "localhost")
+        hostAddress = QHostAddress(QHostAddress::LocalHost);
+
+    m_tcpServer = new QTcpServer;
+    if (!m_tcpServer->listen(hostAddress, port))
+        return fail(address + ": " + m_tcpServer->errorString());
+
+    return true;
+}
+
+bool DistributedCoordinator::start(int workerCount, const DatasetView &dataset, int msecs)
+{
+    if (!m_tcpServer && !m_localServer)
+        return fail("Not listening");
+    if (workerCount < 1 || workerCount > m_islandSettings.islandCount)
+        return fail("Need between 1 and " + QString::number(m_islandSettings.islandCount) + " workers, one island each at least");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (m_workers.size() < workerCount)
+    {
+        if (!acceptWorker(int(qMax(qint64(1), msecs - timer.elapsed()))))
+            return false;
+    }
+
+    // Contiguous shares, as even as the island count allows
+    m_firstIslands.clear();
+    for (int worker = 0; worker <= workerCount; ++worker)
+        m_firstIslands << worker * m_islandSettings.islandCount / workerCount;
+
+    for (int worker = 0; worker < workerCount; ++worker)
+    {
+        QByteArray setup = setupMessage(m_firstIslands[worker], m_firstIslands[worker + 1] - m_firstIslands[worker], dataset);
+        if (setup.isEmpty())
+            return fail("Dataset too large to send");
+        if (!m_workers[worker]->send(MessageType::Setup, setup))
+            return fail("Worker " + QString::number(worker) + ": " + m_workers[worker]->errorString());
+    }
+
+    return true;
+}
+
+bool DistributedCoordinator::acceptWorker(int msecs)
+{
+    QIODevice *socket = nullptr;
+    QString error;
+
+    if (m_tcpServer)
+    {
+        if (m_tcpServer->waitForNewConnection(msecs))
+        {
+            QTcpSocket *tcpSocket = m_tcpServer->nextPendingConnection();
+            tcpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            socket = tcpSocket;
+        }
+        else
+        {
+            error = m_tcpServer->errorString();
+        }
+    }
+    else if (m_localServer->waitForNewConnection(msecs))
+    {
+        socket = m_localServer->nextPendingConnection();
+    }
+    else
+    {
+        error = m_localServer->errorString();
+    }
+
+    if (!socket)
+        return fail("Waiting for worker " + QString::number(m_workers.size()) + ": " + (error.isEmpty() ? QString("Timed out") : error));
+
+    auto *channel = new MessageChannel(socket);
+    QByteArray hello;
+    if (!channel->expect(MessageType::Hello, hello, msecs))
+    {
+        error = channel->errorString();
+        delete channel;
+        return fail("Worker hello: " + error);
+    }
+
+    MessageReader reader(hello);
+    char magic[sizeof(ProtocolMagic)];
+    for (char &c : magic)
+        c = reader.read<char>();
+    quint32 version = reader.read<quint32>();
+    quint32 byteOrder = reader.read<quint32>();
+
+    if (!reader.isValid() || std::memcmp(magic, ProtocolMagic, sizeof(ProtocolMagic)) != 0 || version != ProtocolVersion || byteOrder != ByteOrderMark)
+    {
+        delete channel;
+        return fail("Worker speaks another protocol version or byte order");
+    }
+
+    m_workers << channel;
+    return true;
+}
+
+QByteArray DistributedCoordinator::setupMessage(int firstIsland, int islandCount, const DatasetView &dataset) const
+{
+    quint64 datasetBytes = sizeof(float) * quint64(dataset.samples) * quint64(dataset.inputSize + dataset.outputSize);
+    if (datasetBytes > MaxPayloadSize / 2)
+        return QByteArray();
+
+    MessageWriter writer;
+    writeTopology(writer, m_topology);
+    writeSettings(writer, m_settings);
+
+    writer.write(qint32(m_islandSettings.islandCount));
+    writer.write(qint32(m_islandSettings.migrationInterval));
+    writer.write(qint32(m_islandSettings.migrantCount));
+    writer.write(quint32(m_islandSettings.topology));
+    writer.write(qint32(firstIsland));
+    writer.write(qint32(islandCount));
+
+    // Rows of inputs followed by targets, as Dataset::setData takes them
+    writer.write(qint32(dataset.samples));
+    writer.write(qint32(dataset.inputSize));
+    writer.write(qint32(dataset.outputSize));
+    for (int sample = 0; sample < dataset.samples; ++sample)
+    {
+        writer.write(dataset.inputRow(sample), dataset.inputSize);
+        writer.write(dataset.targetRow(sample), dataset.outputSize);
+    }
+
+    return writer.data();
+}
+
+bool DistributedCoordinator::runEpoch()
+{
+    for (int worker = 0; worker < m_workers.size(); ++worker)
+    {
+        if (!m_workers[worker]->send(MessageType::RunEpoch))
+            return fail("Worker " + QString::number(worker) + ": " + m_workers[worker]->errorString());
+    }
+
+    // Workers run their epochs side by side, the replies are collected in order
+    for (int worker = 0; worker < m_workers.size(); ++worker)
+    {
+        if (!receiveMigrants(worker))
+            return false;
+    }
+
+    MessageWriter writer;
+    writer.write(m_migrantErrors.constData(), m_migrantErrors.size());
+    writer.write(m_migrantGenomes.constData(), m_migrantGenomes.size());
+
+    for (int worker = 0; worker < m_workers.size(); ++worker)
+    {
+        if (!m_workers[worker]->send(MessageType::AllMigrants, writer.data()))
+            return fail("Worker " + QString::number(worker) + ": " + m_workers[worker]->errorString());
+    }
+
+    return true;
+}
+
+bool DistributedCoordinator::receiveMigrants(int worker)
+{
+    QString name = "Worker " + QString::number(worker) + ": ";
+    QByteArray payload;
+    if (!m_workers[worker]->expect(MessageType::Migrants, payload))
+        return fail(name + m_workers[worker]->errorString());
+
+    MessageReader reader(payload);
+    int generation = reader.read<qint32>();
+    float minError = reader.read<float>();
+    int genomeSize = m_topology.genomeSize();
+
+    // The best genome is only copied when it improves on the others
+    QVector<float> bestGenome(genomeSize);
+    reader.read(bestGenome.data(), genomeSize);
+
+    int migrantCount = reader.read<qint32>();
+    int stride = reader.read<qint32>();
+
+    if (!reader.isValid() || migrantCount < 0 || stride < genomeSize)
+        return fail(name + "Malformed migrants");
+
+    if (m_migrantErrors.isEmpty())
+    {
+        m_migrantCount = migrantCount;
+        m_stride = stride;
+        m_migrantErrors.resize(m_islandSettings.islandCount * migrantCount);
+        m_migrantGenomes.resize(m_islandSettings.islandCount * migrantCount * stride);
+    }
+    else if (migrantCount != m_migrantCount || stride != m_stride)
+    {
+        return fail(name + "Migrant layout differs from the other workers");
+    }
+
+    int firstIsland = m_firstIslands[worker];
+    int islands = m_firstIslands[worker + 1] - firstIsland;
+    reader.read(m_migrantErrors.data() + firstIsland * m_migrantCount, islands * m_migrantCount);
+    reader.read(m_migrantGenomes.data() + firstIsland * m_migrantCount * m_stride, islands * m_migrantCount * m_stride);
+
+    if (!reader.isValid() || !reader.atEnd())
+        return fail(name + "Malformed migrants");
+
+    m_generation = generation;
+    if (!m_hasBestNetwork || minError < m_minError)
+    {
+        std::copy(bestGenome.constBegin(), bestGenome.constEnd(), m_bestNetwork.genome());
+        m_bestNetwork.resetError();
+        m_bestNetwork.setError(minError);
+        m_minError = minError;
+        m_hasBestNetwork = true;
+    }
+
+    return true;
+}
+
+void DistributedCoordinator::shutdown()
+{
+    for (auto *worker : m_workers)
+        worker->send(MessageType::Shutdown);
+
+    qDeleteAll(m_workers);
+    m_workers.clear();
+}
+
+QString DistributedCoordinator::errorString() const
+{
+    return m_errorString;
+}
+
+bool DistributedCoordinator::fail(const QString &error)
+{
+    m_errorString = error;
+    return false;
+}
+
+int DistributedCoordinator::workerCount() const
+{
+    return m_workers.size();
+}
+
+int DistributedCoordinator::generation() const
+{
+    return m_generation;
+}
+
+float DistributedCoordinator::minError() const
+{
+    return m_minError;
+}
+
+NeuralNetwork *DistributedCoordinator::bestNetwork()
+{
+    return &m_bestNetwork;
+}
+
+DistributedWorker::DistributedWorker()
+{
+}
+
+DistributedWorker::~DistributedWorker()
+{
+    delete m_engine;
+    delete m_channel;
+}
+
+void DistributedWorker::setThreadPool(ThreadPool *threadPool)
+{
+    m_threadPool = threadPool;
+}
+
+bool DistributedWorker::connectToCoordinator(const QString &address, int msecs)
+{
+    QString host;
+    quint16 port = 0;
+    if (!isLocalAddress(address) && !parseTcpAddress(address, host, port))
+        return fail(address + ": Expected host:port or unix:path");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // The coordinator may not be listening yet
+    for (;;)
+    {
+        int remaining = int(qMax(qint64(1), msecs - timer.elapsed()));
+        QIODevice *socket = nullptr;
+        QString error;
+
+        if (isLocalAddress(address))
+        {
+            auto *localSocket = new QLocalSocket;
+            localSocket->connectToServer(localServerName(address));
+            if (localSocket->waitForConnected(remaining))
+            {
+                socket = localSocket;
+            }
+            else
+            {
+                error = localSocket->errorString();
+                delete localSocket;
+            }
+        }
+        else
+        {
+            auto *tcpSocket = new QTcpSocket;
+            tcpSocket->connectToHost(host, port);
+            if (tcpSocket->waitForConnected(remaining))
+            {
+                tcpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+                socket = tcpSocket;
+            }
+            else
+            {
+                error = tcpSocket->errorString();
+                delete tcpSocket;
+            }
+        }
+
+        if (socket)
+        {
+            m_channel = new MessageChannel(socket);
+            break;
+        }
+
+        if (timer.elapsed() >= msecs)
+            return fail(address + ": " + error);
+
+        QThread::msleep(ConnectRetryInterval);
+    }
+
+    MessageWriter hello;
+    for (char c : ProtocolMagic)
+        hello.write(c);
+    hello.write(ProtocolVersion);
+    hello.write(ByteOrderMark);
+
+    if (!m_channel->send(MessageType::Hello, hello.data()))
+        return fail(m_channel->errorString());
+
+    return true;
+}
+
+bool DistributedWorker::run()
+{
+    if (!m_channel)
+        return fail("Not connected");
+
+    QByteArray payload;
+    if (!m_channel->expect(MessageType::Setup, payload))
+        return fail(m_channel->errorString());
+    if (!setup(payload))
+        return false;
+
+    for (;;)
+    {
+        MessageType type;
+        if (!m_channel->receive(type, payload))
+            return fail(m_channel->errorString());
+
+        if (type == MessageType::Shutdown)
+            return true;
+        if (type != MessageType::RunEpoch)
+            return fail("Unexpected message type " + QString::number(int(type)));
+        if (!runEpoch())
+            return false;
+    }
+}
+
+bool DistributedWorker::setup(const QByteArray &payload)
+{
+    MessageReader reader(payload);
+
+    NetworkTopology topology;
+    if (!readTopology(reader, topology))
+        return fail("Malformed topology");
+
+    GenerationSettings settings;
+    if (!readSettings(reader, settings))
+        return fail("Malformed setup");
+
+    IslandSettings islandSettings;
+    islandSettings.islandCount = reader.read<qint32>();
+    islandSettings.migrationInterval = reader.read<qint32>();
+    islandSettings.migrantCount = reader.read<qint32>();
+    quint32 migrationTopology = reader.read<quint32>();
+    int firstIsland = reader.read<qint32>();
+    int islandCount = reader.read<qint32>();
+
+    int samples = reader.read<qint32>();
+    int inputSize = reader.read<qint32>();
+    int outputSize = reader.read<qint32>();
+
+    // Every island holds two populations, their genomes have to be addressable with an int
+    quint64 islandFloats = 2 * quint64(settings.poolSize) * quint64(topology.genomeSize());
+
+    if (!reader.isValid() || migrationTopology > quint32(MigrationTopology::FullyConnected)
+            || islandSettings.islandCount <= 0 || islandSettings.migrationInterval <= 0 || islandSettings.migrantCount < 0
+            || firstIsland < 0 || firstIsland >= islandSettings.islandCount
+            || islandCount <= 0 || islandCount > islandSettings.islandCount - firstIsland
+            || islandFloats > quint64(std::numeric_limits<int>::max()) / quint64(islandSettings.islandCount)
+            || samples < 0 || inputSize != topology.inputs() || outputSize != topology.layerSize(topology.layerCount() - 1))
+        return fail("Malformed setup");
+
+    islandSettings.topology = MigrationTopology(migrationTopology);
+
+    // The payload has to hold every row before anything is allocated for them
+    quint64 rowFloats = quint64(samples) * quint64(inputSize + outputSize);
+    if (rowFloats * sizeof(float) != reader.remaining())
+        return fail("Malformed setup");
+
+    QVector<float> rows(int(rowFloats));
+    reader.read(rows.data(), rows.size());
+    if (!reader.isValid() || !reader.atEnd())
+        return fail("Malformed dataset");
+
+    m_dataset.setData(rows.constData(), samples, inputSize, outputSize);
+
+    delete m_engine;
+    m_engine = new IslandEngine(topology, settings, islandSettings, firstIsland, islandCount);
+    m_engine->setThreadPool(m_threadPool);
+    m_engine->setDataset(m_dataset.view());
+    return true;
+}
+
+bool DistributedWorker::runEpoch()
+{
+    m_engine->runGenerations();
+    m_engine->publishMigrants();
+
+    int migrantCount = m_engine->migrantCount();
+    int stride = m_engine->stride();
+    int firstIsland = m_engine->firstIsland();
+    int islands = m_engine->localIslandCount();
+    NeuralNetwork *bestNetwork = m_engine->bestNetwork();
+
+    MessageWriter writer;
+    writer.write(qint32(m_engine->generation()));
+    writer.write(m_engine->minError());
+    writer.write(bestNetwork->genome(), bestNetwork->topology().genomeSize());
+    writer.write(qint32(migrantCount));
+    writer.write(qint32(stride));
+    writer.write(m_engine->migrantErrors() + firstIsland * migrantCount, islands * migrantCount);
+    writer.write(m_engine->migrantGenomes() + firstIsland * migrantCount * stride, islands * migrantCount * stride);
+
+    if (!m_channel->send(MessageType::Migrants, writer.data()))
+        return fail(m_channel->errorString());
+
+    QByteArray payload;
+    if (!m_channel->expect(MessageType::AllMigrants, payload))
+        return fail(m_channel->errorString());
+
+    MessageReader reader(payload);
+    reader.read(m_engine->migrantErrors(), m_engine->islandCount() * migrantCount);
+    reader.read(m_engine->migrantGenomes(), m_engine->islandCount() * migrantCount * stride);
+    if (!reader.isValid() || !reader.atEnd())
+        return fail("Malformed migrants");
+
+    m_engine->acceptMigrants();
+    return true;
+}
+
+QString DistributedWorker::errorString() const
+{
+    return m_errorString;
+}
+
+bool DistributedWorker::fail(const QString &error)
+{
+    m_errorString = error;
+    return false;
+}
@@ -0,0 +1,145 @@
+#ifndef DISTRIBUTEDENGINE_H
+#define DISTRIBUTEDENGINE_H
+
+#include <QIODevice>
+#include <QString>
+#include <QVector>
+#include "dataset.h"
+#include "islandengine.h"
+
+class QLocalServer;
+class QTcpServer;
+
+// Addresses are "host:port" for TCP, or "unix:path" for a local socket on the same host.
+// A coordinator may listen on "*:port" to accept workers on every interface.
+
+enum class MessageType : quint32
+{
+    // Worker to coordinator once connected, carries the protocol version
+    Hello,
+    // Topology, settings, the worker's share of the islands and the dataset
+    Setup,
+    // Run migrationInterval generations on every island
+    RunEpoch,
+    // Worker to coordinator after an epoch, its best genome and the migrants of its islands
+    Migrants,
+    // Coordinator to every worker, the migrants of all islands
+    AllMigrants,
+    Shutdown
+};
+
+// Length prefixed messages over a socket, blocking so that no event loop is needed.
+// Payloads are native endian, peers of another byte order are turned away at Hello.
+class MessageChannel
+{
+public:
+    // Takes ownership of an open socket
+    explicit MessageChannel(QIODevice *socket);
+    ~MessageChannel();
+
+    MessageChannel(const MessageChannel &) = delete;
+    MessageChannel &operator=(const MessageChannel &) = delete;
+
+    bool send(MessageType type, const QByteArray &payload = QByteArray());
+    // A negative timeout waits for as long as the peer stays connected
+    bool receive(MessageType &type, QByteArray &payload, int msecs = -1);
+    // Fails unless the next message is of the expected type
+    bool expect(MessageType expected, QByteArray &payload, int msecs = -1);
+
+    QString errorString() const;
+
+private:
+    bool readExactly(char *data, qint64 size, int msecs);
+    bool fail(const QString &error);
+
+    QIODevice *m_socket;
+    QString m_errorString;
+};
+
+// Spreads the islands of an IslandEngine run over worker processes, each hosting a contiguous
+// share of them. Workers evolve their islands on their own and only send their migrants and
+// best genome once per epoch, the coordinator hands every worker the migrants of all islands.
+// Islands are seeded from their index, so the run matches an IslandEngine with the same
+// settings whatever the number of workers.
+class DistributedCoordinator
+{
+public:
+    DistributedCoordinator(const NetworkTopology &topology, const GenerationSettings &settings, const IslandSettings &islandSettings);
+    ~DistributedCoordinator();
+
+    DistributedCoordinator(const DistributedCoordinator &) = delete;
+    DistributedCoordinator &operator=(const DistributedCoordinator &) = delete;
+
+    bool listen(const QString &address);
+    // Waits for workerCount workers, then sends each its islands and the dataset
+    bool start(int workerCount, const DatasetView &dataset, int msecs = 30000);
+    bool runEpoch();
+    // Tells the workers to exit
+    void shutdown();
+
+    QString errorString() const;
+
+    int workerCount() const;
+    int generation() const;
+    float minError() const;
+    NeuralNetwork *bestNetwork();
+
+private:
+    bool acceptWorker(int msecs);
+    QByteArray setupMessage(int firstIsland, int islandCount, const DatasetView &dataset) const;
+    bool receiveMigrants(int worker);
+    bool fail(const QString &error);
+
+    NetworkTopology m_topology;
+    GenerationSettings m_settings;
+    IslandSettings m_islandSettings;
+
+    QTcpServer *m_tcpServer = nullptr;
+    QLocalServer *m_localServer = nullptr;
+    QVector<MessageChannel*> m_workers;
+    QVector<int> m_firstIslands;
+
+    int m_migrantCount = 0;
+    int m_stride = 0;
+    QVector<float> m_migrantGenomes;
+    QVector<float> m_migrantErrors;
+
+    int m_generation = 0;
+    float m_minError = 0;
+    bool m_hasBestNetwork = false;
+    NeuralNetwork m_bestNetwork;
+    QString m_errorString;
+};
+
+// Hosts the islands the coordinator assigns to it, run with ThreadPool workers of its own
+class DistributedWorker
+{
+public:
+    DistributedWorker();
+    ~DistributedWorker();
+
+    DistributedWorker(const DistributedWorker &) = delete;
+    DistributedWorker &operator=(const DistributedWorker &) = delete;
+
+    void setThreadPool(ThreadPool *threadPool);
+
+    // Retries until the coordinator listens or msecs have passed
+    bool connectToCoordinator(const QString &address, int msecs = 30000);
+    // Serves the coordinator until it shuts the run down
+    bool run();
+
+    QString errorString() const;
+
+private:
+    bool setup(const QByteArray &payload);
+    bool runEpoch();
+    bool fail(const QString &error);
+
+    ThreadPool *m_threadPool = nullptr;
+    MessageChannel *m_channel = nullptr;
+    IslandEngine *m_engine = nullptr;
+    Dataset m_dataset;
+    QString m_errorString;
+};
+
+#endif // DISTRIBUTEDENGINE_H
@@ -0,0 +1,466 @@
+#include "evaluator.h"
+#include "population.h"
+#include <algorithm>
+
+const int Evaluator::SampleBlockSize;
+const int GenomeDelta::MaxPerceptrons;
+
+// row = bias + weights . inputs for one neuron over a sample block
+static inline void weightedSum(float *row, const float *weights, int fanIn, const float *layerInputs, int samples)
+{
+    const float bias = weights[fanIn];
+
+    for (int s = 0; s < samples; ++s)
+        row[s] = bias;
+
+    for (int i = 0; i < fanIn; ++i)
+    {
+        const float weight = weights[i];
+        const float *inputRow = layerInputs + i * Evaluator::SampleBlockSize;
+
+        for (int s = 0; s < samples; ++s)
+            row[s] += weight * inputRow[s];
+    }
+}
+
+Evaluator::Evaluator()
+{
+}
+
+void Evaluator::reserve(const NetworkTopology &topology)
+{
+    int layerBlock = topology.maxLayerSize() * SampleBlockSize;
+
+    if (m_current.size() < layerBlock)
+    {
+        m_current.resize(layerBlock);
+        m_next.resize(layerBlock);
+    }
+
+    if (m_inputBlock.size() < topology.inputs() * SampleBlockSize)
+        m_inputBlock.resize(topology.inputs() * SampleBlockSize);
+
+    if (m_targetBlock.size() < topology.outputs() * SampleBlockSize)
+        m_targetBlock.resize(topology.outputs() * SampleBlockSize);
+}
+
+void Evaluator::loadInputBlock(const DatasetView &dataset, int firstSample, int samples)
+{
+    // Transpose the rows into neuron-major blocks, this is shared by every genome
+    for (int s = 0; s < samples; ++s)
+    {
+        const float *inputRow = dataset.inputRow(firstSample + s);
+        for (int i = 0; i < dataset.inputSize; ++i)
+            m_inputBlock[i * SampleBlockSize + s] = inputRow[i];
+    }
+}
+
+void Evaluator::loadSampleBlock(const DatasetView &dataset, int firstSample, int samples)
+{
+    loadInputBlock(dataset, firstSample, samples);
+
+    for (int s = 0; s < samples; ++s)
+    {
+        const float *targetRow = dataset.targetRow(firstSample + s);
+        for (int o = 0; o < dataset.outputSize; ++o)
+            m_targetBlock[o * SampleBlockSize + s] = targetRow[o];
+    }
+}
+
+float Evaluator::runSampleBlock(const NetworkTopology &topology, const float *genome, int samples)
+{
+    return blockError(topology, runLayers(topology, genome, samples), samples);
+}
+
+const float *Evaluator::runLayers(const NetworkTopology &topology, const float *genome, int samples)
+{
+    const float *layerInputs = m_inputBlock.constData();
+    float *layerOutputs = m_next.data();
+    float *spare = m_current.data();
+
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+    {
+        int fanIn = topology.layerInputs(layer);
+        int size = topology.layerSize(layer);
+        Activation activation = topology.layerActivation(layer);
+
+        const float *weights = genome + topology.layerOffset(layer);
+
+        for (int j = 0; j < size; ++j)
+        {
+            float *row = layerOutputs + j * SampleBlockSize;
+
+            weightedSum(row, weights, fanIn, layerInputs, samples);
+            ActivationKernels::apply(activation, row, samples);
+
+            weights += fanIn + 1;
+        }
+
+        layerInputs = layerOutputs;
+        std::swap(layerOutputs, spare);
+    }
+
+    return layerInputs;
+}
+
+float Evaluator::blockError(const NetworkTopology &topology, const float *outputs, int samples) const
+{
+    float error = 0;
+    for (int o = 0; o < topology.outputs(); ++o)
+    {
+        const float *outputRow = outputs + o * SampleBlockSize;
+        const float *targetRow = m_targetBlock.constData() + o * SampleBlockSize;
+
+        for (int s = 0; s < samples; ++s)
+        {
+            float difference = outputRow[s] - targetRow[s];
+            error += difference * difference;
+        }
+    }
+
+    return error;
+}
+
+void Evaluator::evaluate(const NetworkTopology &topology,
+                         const float *genomes, int stride, int count,
+                         const DatasetView &dataset, float *errors)
+{
+    Q_ASSERT(dataset.inputSize == topology.inputs());
+    Q_ASSERT(dataset.outputSize == topology.outputs());
+
+    reserve(topology);
+
+    for (int firstSample = 0; firstSample < dataset.samples; firstSample += SampleBlockSize)
+    {
+        int samples = qMin(SampleBlockSize, dataset.samples - firstSample);
+        loadSampleBlock(dataset, firstSample, samples);
+
+        for (int g = 0; g < count; ++g)
+            errors[g] += runSampleBlock(topology, genomes + size_t(g) * stride, samples);
+    }
+}
+
+void Evaluator::evaluate(const Population &population, int first, int count,
+                         const DatasetView &dataset, float *errors)
+{
+    evaluate(population.topology(),
+             population.genome(first), population.stride(), count,
+             dataset, errors);
+}
+
+int Evaluator::evaluateRacing(const NetworkTopology &topology,
+                              const float *genomes, int stride, int count,
+                              const DatasetView &dataset, float *errors,
+                              const std::atomic<float> &cutoff, quint64 &skippedSamples)
+{
+    Q_ASSERT(dataset.inputSize == topology.inputs());
+    Q_ASSERT(dataset.outputSize == topology.outputs());
+
+    reserve(topology);
+
+    if (m_racing.size() < count)
+        m_racing.resize(count);
+
+    // Indices of the genomes still in the race, compacted as genomes drop out
+    int racing = count;
+    int aborted = 0;
+    for (int g = 0; g < count; ++g)
+        m_racing[g] = g;
+
+    for (int firstSample = 0; firstSample < dataset.samples && racing > 0; firstSample += SampleBlockSize)
+    {
+        int samples = qMin(SampleBlockSize, dataset.samples - firstSample);
+        loadSampleBlock(dataset, firstSample, samples);
+
+        float limit = cutoff.load(std::memory_order_relaxed);
+        int stillRacing = 0;
+
+        for (int r = 0; r < racing; ++r)
+        {
+            int g = m_racing[r];
+            errors[g] += runSampleBlock(topology, genomes + size_t(g) * stride, samples);
+
+            int remaining = dataset.samples - firstSample - samples;
+
+            if (errors[g] < limit)
+            {
+                m_racing[stillRacing++] = g;
+            }
+            else if (remaining > 0)
+            {
+                skippedSamples += quint64(remaining);
+                aborted++;
+            }
+        }
+
+        racing = stillRacing;
+    }
+
+    return aborted;
+}
+
+int Evaluator::evaluateRacing(const Population &population, int first, int count,
+                              const DatasetView &dataset, float *errors,
+                              const std::atomic<float> &cutoff, quint64 &skippedSamples)
+{
+    return evaluateRacing(population.topology(),
+                          population.genome(first), population.stride(), count,
+                          dataset, errors, cutoff, skippedSamples);
+}
+
+void Evaluator::runBaseBlock(const NetworkTopology &topology, const float *base, int samples)
+{
+    // Every layer is kept, both before and after the activation, for the children to start from
+    const float *layerInputs = m_inputBlock.constData();
+
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+    {
+        int fanIn = topology.layerInputs(layer);
+        int size = topology.layerSize(layer);
+        int first = topology.layerFirstPerceptron(layer);
+        Activation activation = topology.layerActivation(layer);
+
+        const float *weights = base + topology.layerOffset(layer);
+        float *sums = m_baseSums.data() + first * SampleBlockSize;
+        float *activations = m_baseActivations.data() + first * SampleBlockSize;
+
+        for (int j = 0; j < size; ++j)
+        {
+            float *sumRow = sums + j * SampleBlockSize;
+            float *row = activations + j * SampleBlockSize;
+
+            weightedSum(sumRow, weights, fanIn, layerInputs, samples);
+            std::copy(sumRow, sumRow + samples, row);
+            ActivationKernels::apply(activation, row, samples);
+
+            weights += fanIn + 1;
+        }
+
+        layerInputs = activations;
+    }
+}
+
+float Evaluator::runDeltaBlock(const NetworkTopology &topology, const float *genome, const GenomeDelta &delta, int samples)
+{
+    const float *layerInputs = m_inputBlock.constData();
+    const float *baseInputs = m_inputBlock.constData();
+    float *layerOutputs = m_next.data();
+    float *spare = m_current.data();
+
+    // Rows of layerInputs that differ from the base. Once most of a layer differs the next
+    // layer is computed in full, as the delta update would cost as much.
+    int *changedRows = m_changedRows.data();
+    int changedCount = 0;
+    bool allChanged = false;
+
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+    {
+        int fanIn = topology.layerInputs(layer);
+        int size = topology.layerSize(layer);
+        int first = topology.layerFirstPerceptron(layer);
+        Activation activation = topology.layerActivation(layer);
+
+        const float *weights = genome + topology.layerOffset(layer);
+        const float *baseSums = m_baseSums.constData() + first * SampleBlockSize;
+        const float *baseActivations = m_baseActivations.constData() + first * SampleBlockSize;
+
+        bool ownChanges = false;
+        for (int j = 0; j < size && !ownChanges; ++j)
+            ownChanges = delta.changes(first + j);
+
+        // Nothing differs yet, the child runs on the base's activations
+        if (!allChanged && changedCount == 0 && !ownChanges)
+        {
+            layerInputs = baseActivations;
+            baseInputs = baseActivations;
+            continue;
+        }
+
+        if (allChanged)
+        {
+            for (int j = 0; j < size; ++j)
+            {
+                float *row = layerOutputs + j * SampleBlockSize;
+
+                weightedSum(row, weights, fanIn, layerInputs, samples);
+                ActivationKernels::apply(activation, row, samples);
+
+                weights += fanIn + 1;
+            }
+        }
+        else
+        {
+            // The input rows the child changed, relative to the base
+            for (int c = 0; c < changedCount; ++c)
+            {
+                float *difference = m_differences.data() + c * SampleBlockSize;
+                const float *childRow = layerInputs + changedRows[c] * SampleBlockSize;
+                const float *baseRow = baseInputs + changedRows[c] * SampleBlockSize;
+
+                for (int s = 0; s < samples; ++s)
+                    difference[s] = childRow[s] - baseRow[s];
+            }
+
+            for (int j = 0; j < size; ++j)
+            {
+                float *row = layerOutputs + j * SampleBlockSize;
+
+                if (delta.changes(first + j))
+                {
+                    weightedSum(row, weights, fanIn, layerInputs, samples);
+                    ActivationKernels::apply(activation, row, samples);
+                }
+                else if (changedCount > 0)
+                {
+                    const float *baseRow = baseSums + j * SampleBlockSize;
+                    std::copy(baseRow, baseRow + samples, row);
+
+                    for (int c = 0; c < changedCount; ++c)
+                    {
+                        const float weight = weights[changedRows[c]];
+                        const float *difference = m_differences.constData() + c * SampleBlockSize;
+
+                        for (int s = 0; s < samples; ++s)
+                            row[s] += weight * difference[s];
+                    }
+
+                    ActivationKernels::apply(activation, row, samples);
+                }
+                else
+                {
+                    const float *baseRow = baseActivations + j * SampleBlockSize;
+                    std::copy(baseRow, baseRow + samples, row);
+                }
+
+                weights += fanIn + 1;
+            }
+        }
+
+        // Changed inputs reach every neuron of the layer, otherwise only its own changed perceptrons differ
+        if (allChanged || changedCount > 0)
+        {
+            changedCount = size;
+        }
+        else
+        {
+            changedCount = 0;
+            for (int j = 0; j < size; ++j)
+                if (delta.changes(first + j))
+                    changedRows[changedCount++] = j;
+        }
+
+        allChanged = changedCount * 2 > size;
+
+        layerInputs = layerOutputs;
+        baseInputs = baseActivations;
+        std::swap(layerOutputs, spare);
+    }
+
+    return blockError(topology, layerInputs, samples);
+}
+
+void Evaluator::predict(const NetworkTopology &topology, const float *genome,
+                        const DatasetView &samples, float *outputs, int outputStride)
+{
+    Q_ASSERT(samples.inputSize == topology.inputs());
+
+    reserve(topology);
+
+    for (int firstSample = 0; firstSample < samples.samples; firstSample += SampleBlockSize)
+    {
+        int count = qMin(SampleBlockSize, samples.samples - firstSample);
+        loadInputBlock(samples, firstSample, count);
+
+        // Back from neuron-major to one row per sample
+        const float *block = runLayers(topology, genome, count);
+        for (int o = 0; o < topology.outputs(); ++o)
+        {
+            float *output = outputs + size_t(firstSample) * outputStride + o;
+            for (int s = 0; s < count; ++s)
+                output[size_t(s) * outputStride] = block[o * SampleBlockSize + s];
+        }
+    }
+}
+
+int Evaluator::deltaCost(const NetworkTopology &topology, const GenomeDelta &delta)
+{
+    // Follows the choices runDeltaBlock makes
+    int cost = 0;
+    int changedCount = 0;
+    bool allChanged = false;
+
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+    {
+        int fanIn = topology.layerInputs(layer);
+        int size = topology.layerSize(layer);
+        int first = topology.layerFirstPerceptron(layer);
+
+        int own = 0;
+        for (int j = 0; j < size; ++j)
+            own += delta.changes(first + j);
+
+        if (!allChanged && changedCount == 0 && own == 0)
+            continue;
+
+        if (allChanged)
+            cost += size * fanIn;
+        else
+            cost += own * fanIn + (size - own) * changedCount;
+
+        changedCount = allChanged || changedCount > 0 ? size : own;
+        allChanged = changedCount * 2 > size;
+    }
+
+    return cost;
+}
+
+void Evaluator::evaluateDeltas(const Population &population, const int *genomes, int count,
+                               const GenomeDelta *deltas, const DatasetView &dataset, float *errors)
+{
+    const NetworkTopology &topology = population.topology();
+
+    Q_ASSERT(dataset.inputSize == topology.inputs());
+    Q_ASSERT(dataset.outputSize == topology.outputs());
+
+    reserve(topology);
+
+    int layerBlock = topology.maxLayerSize() * SampleBlockSize;
+    int networkBlock = topology.perceptronCount() * SampleBlockSize;
+
+    if (m_baseSums.size() < networkBlock)
+    {
+        m_baseSums.resize(networkBlock);
+        m_baseActivations.resize(networkBlock);
+    }
+
+    if (m_differences.size() < layerBlock)
+    {
+        m_differences.resize(layerBlock);
+        m_changedRows.resize(topology.maxLayerSize());
+    }
+
+    int firstGenome = 0;
+    while (firstGenome < count)
+    {
+        const float *base = deltas[genomes[firstGenome]].base;
+
+        int endGenome = firstGenome + 1;
+        while (endGenome < count && deltas[genomes[endGenome]].base == base)
+            endGenome++;
+
+        for (int firstSample = 0; firstSample < dataset.samples; firstSample += SampleBlockSize)
+        {
+            int samples = qMin(SampleBlockSize, dataset.samples - firstSample);
+            loadSampleBlock(dataset, firstSample, samples);
+            runBaseBlock(topology, base, samples);
+
+            for (int g = firstGenome; g < endGenome; ++g)
+            {
+                int genome = genomes[g];
+                errors[genome] += runDeltaBlock(topology, population.genome(genome), deltas[genome], samples);
+            }
+        }
+
+        firstGenome = endGenome;
+    }
+}
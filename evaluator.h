@@ -0,0 +1,106 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <QVector>
+#include <atomic>
+#include "dataset.h"
+#include "networktopology.h"
+
+class Population;
+
+// A genome that equals base everywhere except in the listed perceptrons and in every perceptron
+// from tail on. A crossover child differs from its first parent only in a tail like that.
+struct GenomeDelta
+{
+    static const int MaxPerceptrons = 4;
+
+    const float *base = nullptr;
+    int tail = 0;
+    int perceptronCount = 0;
+    int perceptrons[MaxPerceptrons];
+
+    bool changes(int perceptron) const;
+};
+
+inline bool GenomeDelta::changes(int perceptron) const
+{
+    if (perceptron >= tail)
+        return true;
+
+    for (int d = 0; d < perceptronCount; ++d)
+        if (perceptrons[d] == perceptron)
+            return true;
+
+    return false;
+}
+
+// Scores a block of genomes against a dataset as a batched kernel. Samples are processed
+// SampleBlockSize at a time and every layer is a weights x activation-matrix product, with
+// activations stored neuron-major so the inner loop runs over contiguous samples.
+// An Evaluator owns scratch buffers and is meant to be used by one thread at a time.
+class Evaluator
+{
+public:
+    static const int SampleBlockSize = 64;
+
+    Evaluator();
+
+    // Adds the summed squared error of each genome over the dataset to errors[i]
+    void evaluate(const NetworkTopology &topology,
+                  const float *genomes, int stride, int count,
+                  const DatasetView &dataset, float *errors);
+
+    void evaluate(const Population &population, int first, int count,
+                  const DatasetView &dataset, float *errors);
+
+    // Like evaluate, but a genome is dropped as soon as its error reaches cutoff, which is
+    // re-read before every sample block. The error of a dropped genome is only a lower bound.
+    // Returns how many genomes were dropped early and adds the skipped sample evaluations to skippedSamples.
+    int evaluateRacing(const NetworkTopology &topology,
+                       const float *genomes, int stride, int count,
+                       const DatasetView &dataset, float *errors,
+                       const std::atomic<float> &cutoff, quint64 &skippedSamples);
+
+    int evaluateRacing(const Population &population, int first, int count,
+                       const DatasetView &dataset, float *errors,
+                       const std::atomic<float> &cutoff, quint64 &skippedSamples);
+
+    // Adds the error of each listed genome, genomes[i], to errors[genomes[i]]. Only the perceptrons in
+    // deltas[genomes[i]] and what they feed are recomputed against the base's activations, and
+    // consecutive genomes sharing a base share its forward pass. Rounding can differ from evaluate.
+    void evaluateDeltas(const Population &population, const int *genomes, int count,
+                        const GenomeDelta *deltas, const DatasetView &dataset, float *errors);
+
+    // Multiply-adds per sample evaluateDeltas spends on a child, against genomeSize for a full pass
+    static int deltaCost(const NetworkTopology &topology, const GenomeDelta &delta);
+
+    // Runs genome over the input rows of samples, the targets are not read, and writes
+    // topology.outputs() values per row to outputs, outputStride floats apart
+    void predict(const NetworkTopology &topology, const float *genome,
+                 const DatasetView &samples, float *outputs, int outputStride);
+
+private:
+    void reserve(const NetworkTopology &topology);
+    void loadInputBlock(const DatasetView &dataset, int firstSample, int samples);
+    void loadSampleBlock(const DatasetView &dataset, int firstSample, int samples);
+    // Returns the output layer's activations, neuron-major
+    const float *runLayers(const NetworkTopology &topology, const float *genome, int samples);
+    float runSampleBlock(const NetworkTopology &topology, const float *genome, int samples);
+    void runBaseBlock(const NetworkTopology &topology, const float *base, int samples);
+    float runDeltaBlock(const NetworkTopology &topology, const float *genome, const GenomeDelta &delta, int samples);
+    float blockError(const NetworkTopology &topology, const float *outputs, int samples) const;
+
+    QVector<float> m_inputBlock;
+    QVector<float> m_targetBlock;
+    QVector<float> m_current;
+    QVector<float> m_next;
+    QVector<int> m_racing;
+
+    // Sums and activations of every layer of the current base, and the rows a child changed
+    QVector<float> m_baseSums;
+    QVector<float> m_baseActivations;
+    QVector<float> m_differences;
+    QVector<int> m_changedRows;
+};
+
+#endif // EVALUATOR_H
@@ -0,0 +1,654 @@
+#include "evolutionstrategy.h"
+#include "evaluator.h"
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Independent random streams derived from the run seed
+enum RandomStream : quint64
+{
+    InitialStream,
+    OffspringStream
+};
+
+static const int DefaultSelfAdaptiveMu = 15;
+static const int SelfAdaptiveOffspringPerParent = 7;
+static const float MinSelfAdaptiveSigma = 1e-6f;
+
+static const int CovarianceRowChunkSize = 16;
+
+static Evaluator &threadEvaluator()
+{
+    static thread_local Evaluator evaluator;
+    return evaluator;
+}
+
+// Householder reduction to tridiagonal form and the QL algorithm, after the public domain
+// JAMA routines tred2 and tql2. matrix is symmetric n x n row-major and is replaced by the
+// eigenvectors as columns, eigenvalues gets the eigenvalues, offDiagonal is scratch of n.
+static void symmetricEigen(int n, double *matrix, double *eigenvalues, double *offDiagonal)
+{
+    auto V = [&](int row, int column) -> double & { return matrix[size_t(row) * size_t(n) + size_t(column)]; };
+    double *d = eigenvalues;
+    double *e = offDiagonal;
+
+    for (int j = 0; j < n; ++j)
+        d[j] = V(n - 1, j);
+
+    for (int i = n - 1; i > 0; --i)
+    {
+        double scale = 0;
+        double h = 0;
+        for (int k = 0; k < i; ++k)
+            scale += std::fabs(d[k]);
+
+        if (scale == 0)
+        {
+            e[i] = d[i - 1];
+            for (int j = 0; j < i; ++j)
+            {
+                d[j] = V(i - 1, j);
+                V(i, j) = 0;
+                V(j, i) = 0;
+            }
+        }
+        else
+        {
+            for (int k = 0; k < i; ++k)
+            {
+                d[k] /= scale;
+                h += d[k] * d[k];
+            }
+
+            double f = d[i - 1];
+            double g = f > 0 ? -std::sqrt(h) : std::sqrt(h);
+            e[i] = scale * g;
+            h -= f * g;
+            d[i - 1] = f - g;
+
+            for (int j = 0; j < i; ++j)
+                e[j] = 0;
+
+            for (int j = 0; j < i; ++j)
+            {
+                f = d[j];
+                V(j, i) = f;
+                g = e[j] + V(j, j) * f;
+                for (int k = j + 1; k <= i - 1; ++k)
+                {
+                    g += V(k, j) * d[k];
+                    e[k] += V(k, j) * f;
+                }
+                e[j] = g;
+            }
+
+            f = 0;
+            for (int j = 0; j < i; ++j)
+            {
+                e[j] /= h;
+                f += e[j] * d[j];
+            }
+
+            double hh = f / (h + h);
+            for (int j = 0; j < i; ++j)
+                e[j] -= hh * d[j];
+
+            for (int j = 0; j < i; ++j)
+            {
+                f = d[j];
+                g = e[j];
+                for (int k = j; k <= i - 1; ++k)
+                    V(k, j) -= f * e[k] + g * d[k];
+                d[j] = V(i - 1, j);
+                V(i, j) = 0;
+            }
+        }
+        d[i] = h;
+    }
+
+    // Accumulate the transformations
+    for (int i = 0; i < n - 1; ++i)
+    {
+        V(n - 1, i) = V(i, i);
+        V(i, i) = 1;
+        double h = d[i + 1];
+
+        if (h != 0)
+        {
+            for (int k = 0; k <= i; ++k)
+                d[k] = V(k, i + 1) / h;
+
+            for (int j = 0; j <= i; ++j)
+            {
+                double g = 0;
+                for (int k = 0; k <= i; ++k)
+                    g += V(k, i + 1) * V(k, j);
+                for (int k = 0; k <= i; ++k)
+                    V(k, j) -= g * d[k];
+            }
+        }
+
+        for (int k = 0; k <= i; ++k)
+            V(k, i + 1) = 0;
+    }
+
+    for (int j = 0; j < n; ++j)
+    {
+        d[j] = V(n - 1, j);
+        V(n - 1, j) = 0;
+    }
+    V(n - 1, n - 1) = 1;
+    e[0] = 0;
+
+    // Diagonalise the tridiagonal matrix
+    for (int i = 1; i < n; ++i)
+        e[i - 1] = e[i];
+    e[n - 1] = 0;
+
+    double f = 0;
+    double largest = 0;
+    const double epsilon = std::numeric_limits<double>::epsilon();
+
+    for (int l = 0; l < n; ++l)
+    {
+        largest = qMax(largest, std::fabs(d[l]) + std::fabs(e[l]));
+
+        int m = l;
+        while (m < n - 1 && std::fabs(e[m]) > epsilon * largest)
+            ++m;
+
+        if (m > l)
+        {
+            do
+            {
+                double g = d[l];
+                double p = (d[l + 1] - g) / (2 * e[l]);
+                double r = std::hypot(p, 1.0);
+                if (p < 0)
+                    r = -r;
+
+                d[l] = e[l] / (p + r);
+                d[l + 1] = e[l] * (p + r);
+                double dl1 = d[l + 1];
+                double h = g - d[l];
+                for (int i = l + 2; i < n; ++i)
+                    d[i] -= h;
+                f += h;
+
+                p = d[m];
+                double c = 1;
+                double c2 = c;
+                double c3 = c;
+                double el1 = e[l + 1];
+                double s = 0;
+                double s2 = 0;
+
+                for (int i = m - 1; i >= l; --i)
+                {
+                    c3 = c2;
+                    c2 = c;
+                    s2 = s;
+                    g = c * e[i];
+                    h = c * p;
+                    r = std::hypot(p, e[i]);
+                    e[i + 1] = s * r;
+                    s = e[i] / r;
+                    c = p / r;
+                    p = c * d[i] - s * g;
+                    d[i + 1] = h + s * (c * g + s * d[i]);
+
+                    for (int k = 0; k < n; ++k)
+                    {
+                        h = V(k, i + 1);
+                        V(k, i + 1) = s * V(k, i) + c * h;
+                        V(k, i) = c * V(k, i) - s * h;
+                    }
+                }
+
+                p = -s * s2 * c3 * el1 * e[l] / dl1;
+                e[l] = s * p;
+                d[l] = c * p;
+            }
+            while (std::fabs(e[l]) > epsilon * largest);
+        }
+
+        d[l] += f;
+        e[l] = 0;
+    }
+}
+
+EvolutionStrategy::EvolutionStrategy(const NetworkTopology &topology, const EvolutionStrategySettings &settings)
+    : m_settings(settings),
+      m_topology(topology),
+      m_size(topology.genomeSize()),
+      m_stride(topology.paddedGenomeSize()),
+      m_sigma(settings.initialSigma),
+      m_minError(std::numeric_limits<float>::max()),
+      m_generationMinError(std::numeric_limits<float>::max()),
+      m_random(settings.seed)
+{
+    // Disable sigmoid activation for the output layer so it can be used for regression problems
+    if (!settings.sigmoidOutputLayer)
+        m_topology.setOutputActivation(Activation::Identity);
+
+    const int n = m_size;
+    Random initialRandom = m_random.split(InitialStream);
+
+    if (settings.method == EvolutionStrategyMethod::MuCommaLambda)
+    {
+        m_mu = settings.mu > 0 ? settings.mu : DefaultSelfAdaptiveMu;
+        m_lambda = settings.lambda > 0 ? qMax(settings.lambda, m_mu) : m_mu * SelfAdaptiveOffspringPerParent;
+        m_diagonal = true;
+
+        m_parents.fill(0.0f, m_mu * m_stride);
+        for (int p = 0; p < m_mu; ++p)
+            for (int i = 0; i < n; ++i)
+                m_parents[p * m_stride + i] = (initialRandom.uniform() * 2 - 1) * settings.initialRange;
+
+        m_parentSigmas.fill(settings.initialSigma, m_mu * n);
+        m_offspringSigmas.fill(settings.initialSigma, m_lambda * n);
+    }
+    else
+    {
+        m_lambda = settings.lambda > 0 ? qMax(settings.lambda, 2) : 4 + int(3 * std::log(double(n)));
+        m_mu = settings.mu > 0 ? qMin(settings.mu, m_lambda) : m_lambda / 2;
+        m_diagonal = n > settings.fullCovarianceLimit;
+
+        // Log-linear recombination weights summing to one
+        m_weights.resize(m_mu);
+        double sum = 0;
+        double squares = 0;
+        for (int i = 0; i < m_mu; ++i)
+        {
+            m_weights[i] = std::log(m_mu + 0.5) - std::log(i + 1.0);
+            sum += m_weights[i];
+        }
+        for (double &weight : m_weights)
+        {
+            weight /= sum;
+            squares += weight * weight;
+        }
+        m_muEffective = 1.0 / squares;
+
+        m_cSigma = (m_muEffective + 2) / (n + m_muEffective + 5);
+        m_dSigma = 1 + 2 * qMax(0.0, std::sqrt((m_muEffective - 1) / (n + 1)) - 1) + m_cSigma;
+        m_cC = (4 + m_muEffective / n) / (n + 4 + 2 * m_muEffective / n);
+        m_c1 = 2 / ((n + 1.3) * (n + 1.3) + m_muEffective);
+        m_cMu = qMin(1 - m_c1, 2 * (m_muEffective - 2 + 1 / m_muEffective) / ((n + 2.0) * (n + 2.0) + m_muEffective));
+        m_expectedNorm = std::sqrt(double(n)) * (1 - 1.0 / (4 * n) + 1.0 / (21.0 * n * n));
+
+        // A diagonal covariance learns faster, see Ros and Hansen's sep-CMA-ES
+        if (m_diagonal)
+        {
+            double speedUp = (n + 2) / 3.0;
+            m_c1 = qMin(1.0, m_c1 * speedUp);
+            m_cMu = qMin(1 - m_c1, m_cMu * speedUp);
+        }
+
+        m_mean.resize(n);
+        for (double &weight : m_mean)
+            weight = (initialRandom.uniform() * 2 - 1) * settings.initialRange;
+
+        m_previousMean.fill(0.0, n);
+        m_pathSigma.fill(0.0, n);
+        m_pathC.fill(0.0, n);
+        m_weightedZ.fill(0.0, n);
+        m_deviations.fill(1.0, n);
+
+        if (m_diagonal)
+        {
+            m_covariance.fill(1.0, n);
+        }
+        else
+        {
+            m_covariance.fill(0.0, n * n);
+            m_eigenvectors.fill(0.0, n * n);
+            for (int i = 0; i < n; ++i)
+            {
+                m_covariance[i * n + i] = 1;
+                m_eigenvectors[i * n + i] = 1;
+            }
+            m_eigenvalues.fill(1.0, n);
+        }
+
+        m_z.fill(0.0, m_lambda * n);
+        m_y.fill(0.0, m_lambda * n);
+    }
+
+    m_offspring.fill(0.0f, m_lambda * m_stride);
+    m_errors.fill(0.0f, m_lambda);
+    m_order.resize(m_lambda);
+
+    m_bestNetwork.initialiseNetwork(m_topology);
+}
+
+const EvolutionStrategySettings &EvolutionStrategy::settings() const
+{
+    return m_settings;
+}
+
+const NetworkTopology &EvolutionStrategy::topology() const
+{
+    return m_topology;
+}
+
+void EvolutionStrategy::setThreadPool(ThreadPool *threadPool)
+{
+    m_threadPool = threadPool;
+}
+
+void EvolutionStrategy::setDataset(const DatasetView &dataset)
+{
+    m_dataset = dataset;
+}
+
+int EvolutionStrategy::lambda() const
+{
+    return m_lambda;
+}
+
+int EvolutionStrategy::mu() const
+{
+    return m_mu;
+}
+
+bool EvolutionStrategy::isDiagonal() const
+{
+    return m_diagonal;
+}
+
+void EvolutionStrategy::runGeneration()
+{
+    bool cma = m_settings.method == EvolutionStrategyMethod::CmaEs;
+
+    parallelFor(m_lambda, 1, [&](int first, int count)
+    {
+        if (cma)
+            sampleCma(first, count);
+        else
+            sampleSelfAdaptive(first, count);
+    });
+
+    evaluateOffspring();
+
+    // Ties go to the lower index so the order does not depend on the sort
+    for (int k = 0; k < m_lambda; ++k)
+        m_order[k] = k;
+    std::sort(m_order.begin(), m_order.end(), [this](int a, int b)
+    {
+        return m_errors[a] < m_errors[b] || (m_errors[a] == m_errors[b] && a < b);
+    });
+
+    int best = m_order[0];
+    m_generationMinError = m_errors[best];
+    if (m_generationMinError < m_minError)
+    {
+        m_minError = m_generationMinError;
+        std::copy(m_offspring.constData() + best * m_stride, m_offspring.constData() + best * m_stride + m_size, m_bestNetwork.genome());
+        m_bestNetwork.resetError();
+        m_bestNetwork.setError(m_minError);
+    }
+
+    if (cma)
+        updateCma();
+    else
+        selectSelfAdaptive();
+
+    m_generation++;
+}
+
+void EvolutionStrategy::evaluateOffspring()
+{
+    std::fill(m_errors.begin(), m_errors.end(), 0.0f);
+
+    // One genome per task, its error does not depend on how the work is split
+    parallelFor(m_lambda, 1, [this](int first, int count)
+    {
+        threadEvaluator().evaluate(m_topology, m_offspring.constData() + first * m_stride, m_stride, count,
+                                   m_dataset, m_errors.data() + first);
+    });
+
+    m_evaluations += quint64(m_lambda);
+}
+
+void EvolutionStrategy::sampleSelfAdaptive(int first, int count)
+{
+    const int n = m_size;
+
+    // Learning rates of the shared and the per weight log-normal step size changes
+    const double globalRate = 1 / std::sqrt(2.0 * n);
+    const double localRate = 1 / std::sqrt(2 * std::sqrt(double(n)));
+
+    Random generationRandom = m_random.split(OffspringStream).split(quint64(m_generation));
+
+    for (int k = first; k < first + count; ++k)
+    {
+        Random random = generationRandom.split(quint64(k));
+
+        int a = random.bounded(m_mu);
+        int b = random.bounded(m_mu);
+        const float *parentA = m_parents.constData() + a * m_stride;
+        const float *parentB = m_parents.constData() + b * m_stride;
+        const float *sigmasA = m_parentSigmas.constData() + a * n;
+        const float *sigmasB = m_parentSigmas.constData() + b * n;
+
+        float *child = m_offspring.data() + k * m_stride;
+        float *sigmas = m_offspringSigmas.data() + k * n;
+        double globalStep = globalRate * random.normal();
+
+        for (int i = 0; i < n; ++i)
+        {
+            double sigma = 0.5 * (sigmasA[i] + sigmasB[i]) * std::exp(globalStep + localRate * random.normal());
+            sigmas[i] = qMax(MinSelfAdaptiveSigma, float(sigma));
+            child[i] = 0.5f * (parentA[i] + parentB[i]) + sigmas[i] * float(random.normal());
+        }
+    }
+}
+
+void EvolutionStrategy::selectSelfAdaptive()
+{
+    const int n = m_size;
+
+    // Comma selection, the parents are replaced whatever they scored
+    for (int p = 0; p < m_mu; ++p)
+    {
+        int k = m_order[p];
+        std::copy(m_offspring.constData() + k * m_stride, m_offspring.constData() + (k + 1) * m_stride, m_parents.data() + p * m_stride);
+        std::copy(m_offspringSigmas.constData() + k * n, m_offspringSigmas.constData() + (k + 1) * n, m_parentSigmas.data() + p * n);
+    }
+}
+
+void EvolutionStrategy::sampleCma(int first, int count)
+{
+    const int n = m_size;
+    Random generationRandom = m_random.split(OffspringStream).split(quint64(m_generation));
+
+    for (int k = first; k < first + count; ++k)
+    {
+        Random random = generationRandom.split(quint64(k));
+
+        double *z = m_z.data() + k * n;
+        double *y = m_y.data() + k * n;
+        float *child = m_offspring.data() + k * m_stride;
+
+        for (int i = 0; i < n; ++i)
+            z[i] = random.normal();
+
+        // y = B D z, with B the identity for a diagonal covariance
+        if (m_diagonal)
+        {
+            for (int i = 0; i < n; ++i)
+                y[i] = m_deviations[i] * z[i];
+        }
+        else
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                const double *row = m_eigenvectors.constData() + size_t(i) * size_t(n);
+                double sum = 0;
+                for (int j = 0; j < n; ++j)
+                    sum += row[j] * m_deviations[j] * z[j];
+                y[i] = sum;
+            }
+        }
+
+        for (int i = 0; i < n; ++i)
+            child[i] = float(m_mean[i] + m_sigma * y[i]);
+    }
+}
+
+void EvolutionStrategy::updateCma()
+{
+    const int n = m_size;
+
+    std::swap(m_previousMean, m_mean);
+    std::fill(m_mean.begin(), m_mean.end(), 0.0);
+    std::fill(m_weightedZ.begin(), m_weightedZ.end(), 0.0);
+
+    for (int i = 0; i < m_mu; ++i)
+    {
+        const double weight = m_weights[i];
+        const double *y = m_y.constData() + m_order[i] * n;
+        const double *z = m_z.constData() + m_order[i] * n;
+
+        for (int j = 0; j < n; ++j)
+        {
+            m_mean[j] += weight * y[j];
+            m_weightedZ[j] += weight * z[j];
+        }
+    }
+
+    // The mean moves by sigma times the weighted step
+    for (int j = 0; j < n; ++j)
+        m_mean[j] = m_previousMean[j] + m_sigma * m_mean[j];
+
+    // Evolution paths. C^-1/2 (mean - previousMean) / sigma is B times the weighted z.
+    double sigmaScale = std::sqrt(m_cSigma * (2 - m_cSigma) * m_muEffective);
+    double pathSigmaNorm = 0;
+
+    for (int i = 0; i < n; ++i)
+    {
+        double whitened = m_weightedZ[i];
+        if (!m_diagonal)
+        {
+            const double *row = m_eigenvectors.constData() + size_t(i) * size_t(n);
+            whitened = 0;
+            for (int j = 0; j < n; ++j)
+                whitened += row[j] * m_weightedZ[j];
+        }
+
+        m_pathSigma[i] = (1 - m_cSigma) * m_pathSigma[i] + sigmaScale * whitened;
+        pathSigmaNorm += m_pathSigma[i] * m_pathSigma[i];
+    }
+    pathSigmaNorm = std::sqrt(pathSigmaNorm);
+
+    // Stall the covariance path while the step size path is unusually long
+    double decay = 1 - std::pow(1 - m_cSigma, 2.0 * (m_generation + 1));
+    bool stall = pathSigmaNorm / std::sqrt(decay) >= (1.4 + 2.0 / (n + 1)) * m_expectedNorm;
+    double hSigma = stall ? 0.0 : 1.0;
+
+    double cScale = std::sqrt(m_cC * (2 - m_cC) * m_muEffective);
+    for (int i = 0; i < n; ++i)
+        m_pathC[i] = (1 - m_cC) * m_pathC[i] + hSigma * cScale * (m_mean[i] - m_previousMean[i]) / m_sigma;
+
+    // Rank one update from the path and rank mu update from the selected steps
+    double keep = 1 - m_c1 - m_cMu + (1 - hSigma) * m_c1 * m_cC * (2 - m_cC);
+
+    if (m_diagonal)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            double rankMu = 0;
+            for (int k = 0; k < m_mu; ++k)
+            {
+                double y = m_y[m_order[k] * n + i];
+                rankMu += m_weights[k] * y * y;
+            }
+
+            m_covariance[i] = keep * m_covariance[i] + m_c1 * m_pathC[i] * m_pathC[i] + m_cMu * rankMu;
+            m_deviations[i] = std::sqrt(qMax(m_covariance[i], std::numeric_limits<double>::min()));
+        }
+    }
+    else
+    {
+        parallelFor(n, CovarianceRowChunkSize, [&](int first, int count)
+        {
+            for (int i = first; i < first + count; ++i)
+            {
+                double *row = m_covariance.data() + size_t(i) * size_t(n);
+                for (int j = 0; j <= i; ++j)
+                {
+                    double rankMu = 0;
+                    for (int k = 0; k < m_mu; ++k)
+                    {
+                        const double *y = m_y.constData() + m_order[k] * n;
+                        rankMu += m_weights[k] * y[i] * y[j];
+                    }
+
+                    row[j] = keep * row[j] + m_c1 * m_pathC[i] * m_pathC[j] + m_cMu * rankMu;
+                }
+            }
+        });
+
+        // Only the lower triangle was updated
+        for (int i = 0; i < n; ++i)
+            for (int j = i + 1; j < n; ++j)
+                m_covariance[i * n + j] = m_covariance[j * n + i];
+
+        // The decomposition is O(n^3), it is only redone once the covariance has moved enough
+        if ((m_generation + 1 - m_eigenGeneration) > m_lambda / (m_c1 + m_cMu) / n / 10)
+            updateEigenDecomposition();
+    }
+
+    m_sigma *= std::exp((m_cSigma / m_dSigma) * (pathSigmaNorm / m_expectedNorm - 1));
+}
+
+void EvolutionStrategy::updateEigenDecomposition()
+{
+    const int n = m_size;
+    m_eigenGeneration = m_generation + 1;
+
+    std::copy(m_covariance.constBegin(), m_covariance.constEnd(), m_eigenvectors.begin());
+    symmetricEigen(n, m_eigenvectors.data(), m_eigenvalues.data(), m_deviations.data());
+
+    // Rounding can leave tiny negative eigenvalues
+    for (int i = 0; i < n; ++i)
+        m_deviations[i] = std::sqrt(qMax(m_eigenvalues[i], std::numeric_limits<double>::min()));
+}
+
+int EvolutionStrategy::generation() const
+{
+    return m_generation;
+}
+
+quint64 EvolutionStrategy::evaluations() const
+{
+    return m_evaluations;
+}
+
+double EvolutionStrategy::sigma() const
+{
+    if (m_settings.method == EvolutionStrategyMethod::CmaEs)
+        return m_sigma;
+
+    double sum = 0;
+    for (float sigma : m_parentSigmas)
+        sum += sigma;
+    return sum / qMax(1, m_parentSigmas.size());
+}
+
+float EvolutionStrategy::minError() const
+{
+    return m_minError;
+}
+
+float EvolutionStrategy::generationMinError() const
+{
+    return m_generationMinError;
+}
+
+NeuralNetwork *EvolutionStrategy::bestNetwork()
+{
+    return &m_bestNetwork;
+}
@@ -0,0 +1,150 @@
+#ifndef EVOLUTIONSTRATEGY_H
+#define EVOLUTIONSTRATEGY_H
+
+#include <QVector>
+#include "dataset.h"
+#include "neuralnetwork.h"
+#include "random.h"
+#include "threadpool.h"
+
+enum class EvolutionStrategyMethod
+{
+    // (mu/2, lambda)-ES, every offspring recombines two parents and carries one self-adapted
+    // step size per weight. The mu best offspring become the next parents.
+    MuCommaLambda,
+    // CMA-ES, offspring are drawn around a weighted mean from a covariance matrix and step size
+    // learnt from the successful steps. Above fullCovarianceLimit weights the covariance is kept
+    // diagonal (sep-CMA-ES) so that a generation stays linear in the genome size.
+    CmaEs
+};
+
+struct EvolutionStrategySettings
+{
+    EvolutionStrategyMethod method = EvolutionStrategyMethod::CmaEs;
+    // Offspring per generation and how many of them are selected, 0 for the method's default:
+    // 4 + 3 ln(n) and half of them for CMA-ES, 15 parents and seven offspring each for the ES
+    int lambda = 0;
+    int mu = 0;
+    // Starting step size, the weights start uniform in [-initialRange, initialRange]
+    float initialSigma = 0.5f;
+    float initialRange = 1.0f;
+    int fullCovarianceLimit = 500;
+    bool sigmoidOutputLayer = true;
+    // Every random decision of a run is derived from this seed
+    quint64 seed = 0;
+};
+
+// Evolution strategies over the flat weight vector, an alternative to the GA of
+// GenerationEngine for continuous weights. Offspring live in one strided block and are scored
+// by the same Evaluator, spread over the same ThreadPool. Every offspring draws from its own
+// random stream, so a run is the same on any number of threads.
+class EvolutionStrategy
+{
+public:
+    EvolutionStrategy(const NetworkTopology &topology, const EvolutionStrategySettings &settings);
+
+    EvolutionStrategy(const EvolutionStrategy &) = delete;
+    EvolutionStrategy &operator=(const EvolutionStrategy &) = delete;
+
+    const EvolutionStrategySettings &settings() const;
+    const NetworkTopology &topology() const;
+
+    // Sampling, evaluation and the covariance update are spread over the pool
+    void setThreadPool(ThreadPool *threadPool);
+    void setDataset(const DatasetView &dataset);
+
+    int lambda() const;
+    int mu() const;
+    // True when CMA-ES keeps only the diagonal of the covariance
+    bool isDiagonal() const;
+
+    void runGeneration();
+
+    int generation() const;
+    // Genomes scored so far
+    quint64 evaluations() const;
+    // Overall step size, for the ES the mean over the parents' weights
+    double sigma() const;
+
+    float minError() const;
+    float generationMinError() const;
+    NeuralNetwork *bestNetwork();
+
+private:
+    void sampleSelfAdaptive(int first, int count);
+    void selectSelfAdaptive();
+    void sampleCma(int first, int count);
+    void updateCma();
+    void updateEigenDecomposition();
+    void evaluateOffspring();
+
+    template<typename Body>
+    void parallelFor(int count, int chunkSize, const Body &body);
+
+    EvolutionStrategySettings m_settings;
+    NetworkTopology m_topology;
+    DatasetView m_dataset;
+    ThreadPool *m_threadPool = nullptr;
+
+    int m_size;
+    int m_stride;
+    int m_lambda;
+    int m_mu;
+    bool m_diagonal;
+
+    // Offspring genomes, stride floats each, their errors and their indices sorted by error
+    QVector<float> m_offspring;
+    QVector<float> m_errors;
+    QVector<int> m_order;
+
+    // (mu, lambda)-ES: the parents and the step sizes of parents and offspring, one per weight
+    QVector<float> m_parents;
+    QVector<float> m_parentSigmas;
+    QVector<float> m_offspringSigmas;
+
+    // CMA-ES state in double, see Hansen's "The CMA Evolution Strategy: A Tutorial"
+    QVector<double> m_weights;
+    double m_muEffective = 0;
+    double m_cSigma = 0;
+    double m_dSigma = 0;
+    double m_cC = 0;
+    double m_c1 = 0;
+    double m_cMu = 0;
+    double m_expectedNorm = 0;
+
+    double m_sigma;
+    QVector<double> m_mean;
+    QVector<double> m_previousMean;
+    QVector<double> m_pathSigma;
+    QVector<double> m_pathC;
+    // n x n row-major, or its diagonal alone. B holds the eigenvectors as columns, D the
+    // square roots of the eigenvalues.
+    QVector<double> m_covariance;
+    QVector<double> m_eigenvectors;
+    QVector<double> m_eigenvalues;
+    QVector<double> m_deviations;
+    int m_eigenGeneration = 0;
+
+    // The standard normal draws of each offspring and the steps they became
+    QVector<double> m_z;
+    QVector<double> m_y;
+    QVector<double> m_weightedZ;
+
+    int m_generation = 0;
+    quint64 m_evaluations = 0;
+    float m_minError;
+    float m_generationMinError;
+    NeuralNetwork m_bestNetwork;
+    Random m_random;
+};
+
+template<typename Body>
+void EvolutionStrategy::parallelFor(int count, int chunkSize, const Body &body)
+{
+    if (m_threadPool)
+        m_threadPool->parallelFor(count, chunkSize, body);
+    else
+        body(0, count);
+}
+
+#endif // EVOLUTIONSTRATEGY_H
@@ -0,0 +1,50 @@
+#include "fitnessaccumulator.h"
+#include <algorithm>
+
+// 64 byte cache lines
+static const int RowAlignment = 16;
+
+FitnessAccumulator::FitnessAccumulator()
+{
+}
+
+void FitnessAccumulator::reset(int rows, int genomes)
+{
+    m_rowCount = rows;
+    m_genomes = genomes;
+    m_stride = ((genomes + RowAlignment - 1) / RowAlignment + 1) * RowAlignment;
+
+    if (m_rows.size() < rows * m_stride)
+        m_rows.resize(rows * m_stride);
+
+    std::fill(m_rows.begin(), m_rows.begin() + rows * m_stride, 0.0f);
+}
+
+int FitnessAccumulator::rows() const
+{
+    return m_rowCount;
+}
+
+int FitnessAccumulator::genomes() const
+{
+    return m_genomes;
+}
+
+float *FitnessAccumulator::row(int index)
+{
+    return m_rows.data() + index * m_stride;
+}
+
+void FitnessAccumulator::reduce(float *errors, int first, int count) const
+{
+    const float *rows = m_rows.constData();
+
+    for (int i = first; i < first + count; ++i)
+    {
+        float total = 0;
+        for (int row = 0; row < m_rowCount; ++row)
+            total += rows[row * m_stride + i];
+
+        errors[i - first] = total;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef FITNESSACCUMULATOR_H
+#define FITNESSACCUMULATOR_H
+
+#include <QVector>
+
+// Rows of partial errors, one per sample shard, padded apart so that rows never share a cache
+// line. Several tasks may write the same row at once, each for its own range of genomes, so it
+// is each element that has a single writer during an evaluation pass, not each row. reduce()
+// sums the rows at the end in a fixed order, so the totals do not depend on which thread wrote what.
+class FitnessAccumulator
+{
+public:
+    FitnessAccumulator();
+
+    // Sizes and zeroes the rows, the storage only grows
+    void reset(int rows, int genomes);
+
+    int rows() const;
+    int genomes() const;
+
+    float *row(int index);
+
+    // errors[i] = sum over rows of row[first + i]
+    void reduce(float *errors, int first, int count) const;
+
+private:
+    int m_rowCount = 0;
+    int m_genomes = 0;
+    int m_stride = 0;
+    QVector<float> m_rows;
+};
+
+#endif // FITNESSACCUMULATOR_H
@@ -0,0 +1,117 @@
+#include "fitnesscache.h"
+#include "random.h"
+#include <cstring>
+
+// Slots examined from the home slot before an entry is replaced
+static const int ProbeWindow = 8;
+
+FitnessCache::FitnessCache(int capacity)
+{
+    setCapacity(capacity);
+}
+
+void FitnessCache::setCapacity(int capacity)
+{
+    int size = ProbeWindow;
+    while (size < capacity)
+        size *= 2;
+
+    m_entries.resize(size);
+    m_mask = quint64(size - 1);
+    clear();
+}
+
+int FitnessCache::capacity() const
+{
+    return m_entries.size();
+}
+
+void FitnessCache::setDatasetVersion(quint32 version)
+{
+    m_version = version;
+}
+
+quint32 FitnessCache::datasetVersion() const
+{
+    return m_version;
+}
+
+void FitnessCache::clear()
+{
+    // An age of zero marks an empty slot
+    for (auto &entry : m_entries)
+        entry = Entry{0, 0.0f, 0, 0};
+
+    m_insertions = 0;
+}
+
+quint64 FitnessCache::hash(const float *genome, int size)
+{
+    quint64 hash = quint64(size) * 0x9e3779b97f4a7c15ULL;
+
+    // Two genes per step, the genes are hashed by their bit patterns
+    int i = 0;
+    for (; i + 1 < size; i += 2)
+    {
+        quint64 pair;
+        std::memcpy(&pair, genome + i, sizeof(pair));
+        hash = (hash ^ pair) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+
+    if (i < size)
+    {
+        quint32 last;
+        std::memcpy(&last, genome + i, sizeof(last));
+        hash = (hash ^ last) * 0xff51afd7ed558ccdULL;
+    }
+
+    return Random::mix(hash);
+}
+
+quint64 FitnessCache::replacementAge(const Entry &entry) const
+{
+    // Free and stale slots go first
+    return entry.version == m_version ? entry.age : 0;
+}
+
+bool FitnessCache::lookup(quint64 hash, float &error) const
+{
+    const Entry *entries = m_entries.constData();
+
+    for (int probe = 0; probe < ProbeWindow; ++probe)
+    {
+        const Entry &entry = entries[(hash + quint64(probe)) & m_mask];
+
+        if (entry.age != 0 && entry.hash == hash && entry.version == m_version)
+        {
+            error = entry.error;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void FitnessCache::insert(quint64 hash, float error)
+{
+    Entry *entries = m_entries.data();
+    Entry *victim = nullptr;
+
+    for (int probe = 0; probe < ProbeWindow; ++probe)
+    {
+        Entry &entry = entries[(hash + quint64(probe)) & m_mask];
+
+        // Refresh an existing entry, otherwise prefer a free or stale slot, then the oldest one
+        if (entry.age != 0 && entry.hash == hash && entry.version == m_version)
+        {
+            victim = &entry;
+            break;
+        }
+
+        if (!victim || replacementAge(entry) < replacementAge(*victim))
+            victim = &entry;
+    }
+
+    *victim = Entry{hash, error, m_version, ++m_insertions};
+}
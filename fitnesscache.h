@@ -0,0 +1,48 @@
+#ifndef FITNESSCACHE_H
+#define FITNESSCACHE_H
+
+#include <QVector>
+
+// Errors of genomes already scored against the current dataset, keyed on a 64 bit hash of the
+// genome's genes. Unmutated children, whole-parent crossovers and elite copies hash the same as
+// the genome they came from and skip evaluation. The table is allocated once; when a probe window
+// is full the entry stored longest ago is replaced. Two different genomes sharing a hash is
+// treated as impossible.
+class FitnessCache
+{
+public:
+    explicit FitnessCache(int capacity = 0);
+
+    // Rounds up to a power of two and clears the cache
+    void setCapacity(int capacity);
+    int capacity() const;
+
+    // Entries stored under an older version are treated as empty
+    void setDatasetVersion(quint32 version);
+    quint32 datasetVersion() const;
+    void clear();
+
+    static quint64 hash(const float *genome, int size);
+
+    // Safe to call concurrently as long as nothing is being inserted
+    bool lookup(quint64 hash, float &error) const;
+    void insert(quint64 hash, float error);
+
+private:
+    struct Entry
+    {
+        quint64 hash;
+        float error;
+        quint32 version;
+        quint64 age;
+    };
+
+    quint64 replacementAge(const Entry &entry) const;
+
+    QVector<Entry> m_entries;
+    quint64 m_mask = 0;
+    quint32 m_version = 1;
+    quint64 m_insertions = 0;
+};
+
+#endif // FITNESSCACHE_H
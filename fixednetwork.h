@@ -0,0 +1,256 @@
+#ifndef FIXEDNETWORK_H
+#define FIXEDNETWORK_H
+
+#include <QtGlobal>
+#include <algorithm>
+#include <array>
+#include "dataset.h"
+#include "evaluator.h"
+#include "networktopology.h"
+
+// A fully connected network whose input count and layer sizes are template arguments, eg.
+// FixedNetwork<3, 2, 1> for three inputs, a hidden layer of two and one output. The genome has
+// the NetworkTopology layout in a std::array, so it can be copied to and from any population
+// genome of the same topology, and every loop of the forward pass has a compile time bound.
+// Activations stay per layer values so that the output layer follows the run's settings.
+template<int Inputs, int... Layers>
+class FixedNetwork
+{
+public:
+    static constexpr int InputCount = Inputs;
+    static constexpr int LayerCount = int(sizeof...(Layers));
+    static constexpr std::array<int, LayerCount + 1> Sizes = {{Inputs, Layers...}};
+    static constexpr int OutputCount = Sizes[LayerCount];
+
+    static_assert(LayerCount > 0, "FixedNetwork needs at least one layer");
+
+    static constexpr int layerOffset(int layer)
+    {
+        int offset = 0;
+        for (int l = 0; l < layer; ++l)
+            offset += Sizes[l + 1] * (Sizes[l] + 1);
+        return offset;
+    }
+
+    static constexpr int maxLayerSize()
+    {
+        int size = Inputs;
+        for (int l = 1; l <= LayerCount; ++l)
+            size = std::max(size, Sizes[l]);
+        return size;
+    }
+
+    static constexpr int GenomeSize = layerOffset(LayerCount);
+    static constexpr int MaxLayerSize = maxLayerSize();
+
+    FixedNetwork()
+    {
+        m_genome.fill(0.0f);
+        m_activations.fill(Activation::Sigmoid);
+    }
+
+    explicit FixedNetwork(const NetworkTopology &topology, const float *genome = nullptr)
+        : FixedNetwork()
+    {
+        setActivations(topology);
+        if (genome)
+            load(genome);
+    }
+
+    // The equivalent runtime topology
+    NetworkTopology topology() const
+    {
+        NetworkTopology topology(Inputs, QVector<int>{Layers...});
+        for (int layer = 0; layer < LayerCount; ++layer)
+            topology.setLayerActivation(layer, m_activations[size_t(layer)]);
+        return topology;
+    }
+
+    // True when topology has the same sizes, activations may differ
+    static bool matches(const NetworkTopology &topology)
+    {
+        if (topology.inputs() != Inputs || topology.layerCount() != LayerCount)
+            return false;
+
+        for (int layer = 0; layer < LayerCount; ++layer)
+            if (topology.layerSize(layer) != Sizes[size_t(layer + 1)])
+                return false;
+
+        return true;
+    }
+
+    void setActivations(const NetworkTopology &topology)
+    {
+        Q_ASSERT(matches(topology));
+        for (int layer = 0; layer < LayerCount; ++layer)
+            m_activations[size_t(layer)] = topology.layerActivation(layer);
+    }
+
+    void load(const float *genome)
+    {
+        std::copy(genome, genome + GenomeSize, m_genome.begin());
+    }
+
+    void store(float *genome) const
+    {
+        std::copy(m_genome.begin(), m_genome.end(), genome);
+    }
+
+    std::array<float, GenomeSize> &genome()
+    {
+        return m_genome;
+    }
+
+    const std::array<float, GenomeSize> &genome() const
+    {
+        return m_genome;
+    }
+
+    std::array<float, OutputCount> run(const std::array<float, Inputs> &inputs) const
+    {
+        std::array<float, OutputCount> outputs;
+        run(inputs.data(), outputs.data());
+        return outputs;
+    }
+
+    void run(const float *inputs, float *outputs) const
+    {
+        runBlock<1, 1>(m_genome.data(), m_activations.data(), &inputs, outputs);
+    }
+
+    // Runs Lanes genomes side by side on Samples input rows. Weights are lane major, weight g
+    // of lane l at weights[g * Lanes + l]. Output o of lane l for sample s is written to
+    // outputs[(s * OutputCount + o) * Lanes + l]. Batching samples keeps the activation
+    // kernels fed with enough values per call.
+    template<int Lanes, int Samples>
+    static void runBlock(const float *weights, const Activation *activations, const float *const *inputs, float *outputs)
+    {
+        alignas(32) float current[MaxLayerSize * Lanes * Samples];
+        alignas(32) float next[MaxLayerSize * Lanes * Samples];
+
+        for (int s = 0; s < Samples; ++s)
+            for (int i = 0; i < Inputs; ++i)
+                for (int lane = 0; lane < Lanes; ++lane)
+                    current[(s * Inputs + i) * Lanes + lane] = inputs[s][i];
+
+        runLayer<0, Lanes, Samples>(weights, activations, current, next, outputs);
+    }
+
+private:
+    template<int Layer, int Lanes, int Samples>
+    static void runLayer(const float *weights, const Activation *activations, float *layerInputs, float *layerOutputs, float *outputs)
+    {
+        constexpr int FanIn = Sizes[Layer];
+        constexpr int Size = Sizes[Layer + 1];
+        constexpr bool Last = Layer + 1 == LayerCount;
+
+        float *results = Last ? outputs : layerOutputs;
+
+        for (int s = 0; s < Samples; ++s)
+        {
+            const float *sampleInputs = layerInputs + s * FanIn * Lanes;
+            const float *perceptron = weights + layerOffset(Layer) * Lanes;
+
+            for (int j = 0; j < Size; ++j)
+            {
+                // The bias follows the weights of each perceptron
+                float totals[Lanes];
+                for (int lane = 0; lane < Lanes; ++lane)
+                    totals[lane] = perceptron[FanIn * Lanes + lane];
+
+                for (int i = 0; i < FanIn; ++i)
+                    for (int lane = 0; lane < Lanes; ++lane)
+                        totals[lane] += sampleInputs[i * Lanes + lane] * perceptron[i * Lanes + lane];
+
+                for (int lane = 0; lane < Lanes; ++lane)
+                    results[(s * Size + j) * Lanes + lane] = totals[lane];
+
+                perceptron += (FanIn + 1) * Lanes;
+            }
+        }
+
+        ActivationKernels::apply(activations[Layer], results, Size * Lanes * Samples);
+
+        if constexpr (!Last)
+            runLayer<Layer + 1, Lanes, Samples>(weights, activations, layerOutputs, layerInputs, outputs);
+    }
+
+    std::array<float, GenomeSize> m_genome;
+    std::array<Activation, LayerCount> m_activations;
+};
+
+// Scores genomes of a FixedNetwork topology Lanes at a time. Each run of genomes is copied lane
+// major once, then Samples rows at a time go through all of them together. A drop-in for
+// Evaluator::evaluate, errors are summed per Evaluator::SampleBlockSize samples the same way.
+template<typename Network>
+class FixedEvaluator
+{
+public:
+    static const int Lanes = 8;
+    static const int Samples = 4;
+
+    static_assert(Network::GenomeSize <= 2048, "FixedEvaluator keeps the weights of a run on the stack");
+
+    static void evaluate(const NetworkTopology &topology,
+                         const float *genomes, int stride, int count,
+                         const DatasetView &dataset, float *errors)
+    {
+        Q_ASSERT(Network::matches(topology));
+        Q_ASSERT(dataset.inputSize == Network::InputCount);
+        Q_ASSERT(dataset.outputSize == Network::OutputCount);
+
+        std::array<Activation, Network::LayerCount> activations;
+        for (int layer = 0; layer < Network::LayerCount; ++layer)
+            activations[size_t(layer)] = topology.layerActivation(layer);
+
+        alignas(32) float weights[Network::GenomeSize * Lanes];
+        alignas(32) float outputs[Network::OutputCount * Lanes * Samples];
+        const float *inputs[Samples];
+
+        for (int first = 0; first < count; first += Lanes)
+        {
+            int lanes = qMin(Lanes, count - first);
+
+            // Missing lanes run on zero weights and are never read back
+            for (int g = 0; g < Network::GenomeSize; ++g)
+                for (int lane = 0; lane < Lanes; ++lane)
+                    weights[g * Lanes + lane] = lane < lanes ? genomes[size_t(first + lane) * stride + g] : 0.0f;
+
+            for (int firstSample = 0; firstSample < dataset.samples; firstSample += Evaluator::SampleBlockSize)
+            {
+                int blockEnd = qMin(firstSample + Evaluator::SampleBlockSize, dataset.samples);
+                float blockErrors[Lanes] = {};
+
+                for (int sample = firstSample; sample < blockEnd; sample += Samples)
+                {
+                    // A short last group repeats its last row, the repeats are not counted
+                    int samples = qMin(Samples, blockEnd - sample);
+                    for (int s = 0; s < Samples; ++s)
+                        inputs[s] = dataset.inputRow(sample + qMin(s, samples - 1));
+
+                    Network::template runBlock<Lanes, Samples>(weights, activations.data(), inputs, outputs);
+
+                    for (int s = 0; s < samples; ++s)
+                    {
+                        const float *targets = dataset.targetRow(sample + s);
+                        const float *sampleOutputs = outputs + s * Network::OutputCount * Lanes;
+
+                        for (int o = 0; o < Network::OutputCount; ++o)
+                        {
+                            for (int lane = 0; lane < Lanes; ++lane)
+                            {
+                                float difference = sampleOutputs[o * Lanes + lane] - targets[o];
+                                blockErrors[lane] += difference * difference;
+                            }
+                        }
+                    }
+                }
+
+                for (int lane = 0; lane < lanes; ++lane)
+                    errors[first + lane] += blockErrors[lane];
+            }
+        }
+    }
+};
+
+#endif // FIXEDNETWORK_H
@@ -0,0 +1,50 @@
+#include "forwardpass.h"
+
+ForwardPass::ForwardPass()
+{
+}
+
+void ForwardPass::reserve(const NetworkTopology &topology)
+{
+    int size = qMax(topology.inputs(), topology.maxLayerSize());
+
+    if (m_current.size() < size)
+    {
+        m_current.resize(size);
+        m_next.resize(size);
+    }
+}
+
+const float *ForwardPass::run(const NetworkTopology &topology, const float *genome, const float *inputs)
+{
+    reserve(topology);
+
+    const float *layerInputs = inputs;
+    float *layerOutputs = m_next.data();
+    float *spare = m_current.data();
+
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+    {
+        int fanIn = topology.layerInputs(layer);
+        int size = topology.layerSize(layer);
+        const float *weights = genome + topology.layerOffset(layer);
+
+        for (int j = 0; j < size; ++j)
+        {
+            // The bias follows the weights of each perceptron
+            float total = weights[fanIn];
+            for (int i = 0; i < fanIn; ++i)
+                total += layerInputs[i] * weights[i];
+
+            layerOutputs[j] = total;
+            weights += fanIn + 1;
+        }
+
+        ActivationKernels::apply(topology.layerActivation(layer), layerOutputs, size);
+
+        layerInputs = layerOutputs;
+        std::swap(layerOutputs, spare);
+    }
+
+    return layerInputs;
+}
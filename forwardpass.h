@@ -0,0 +1,24 @@
+#ifndef FORWARDPASS_H
+#define FORWARDPASS_H
+
+#include <QVector>
+#include "networktopology.h"
+
+// Runs a genome layer by layer, computing each layer's activations exactly once
+// into two reusable buffers that are swapped between layers.
+class ForwardPass
+{
+public:
+    ForwardPass();
+
+    // Returns a pointer to topology.outputs() values, valid until the next run
+    const float *run(const NetworkTopology &topology, const float *genome, const float *inputs);
+
+private:
+    void reserve(const NetworkTopology &topology);
+
+    QVector<float> m_current;
+    QVector<float> m_next;
+};
+
+#endif // FORWARDPASS_H
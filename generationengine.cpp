@@ -0,0 +1,999 @@
+#include "generationengine.h"
+#include "allocationcounter.h"
+#include "threadpool.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <limits>
+
+// Independent random streams derived from the run seed
+enum RandomStream : quint64
+{
+    InitialPopulationStream,
+    ShuffleStream,
+    SelectionStream,
+    BreedStream,
+    MiniBatchStream,
+    FineTuneStream
+};
+
+static const int EvaluationChunkSize = 64;
+static const int BreedChunkSize = 256;
+static const int ReduceChunkSize = 1024;
+
+// Samples per task when elites are rescored on the whole dataset, fixed for reproducibility
+static const int RescoreShardSamples = 16 * 1024;
+
+// Below this many genome chunks the samples are sharded as well. It does not depend on the
+// thread count so that the summation order, and with it the run, is the same on every machine.
+static const int MinEvaluationTasks = 64;
+static const int MinShardSamples = 4 * Evaluator::SampleBlockSize;
+
+// How a genome got its error before the full evaluation pass
+enum ScoreSource : char
+{
+    Unscored,
+    ScoredFromCache,
+    ScoredIncrementally
+};
+
+// Breeding pool entry that stands for the best network found so far
+static const int EliteParent = -1;
+
+// Adds the wall time of its scope to a phase, when metrics are being recorded
+class PhaseTimer
+{
+public:
+    PhaseTimer(GenerationMetrics *metrics, GenerationPhase phase)
+        : m_nanoseconds(metrics ? &metrics->phaseNanoseconds[int(phase)] : nullptr)
+    {
+        if (m_nanoseconds)
+            m_timer.start();
+    }
+
+    ~PhaseTimer()
+    {
+        if (m_nanoseconds)
+            *m_nanoseconds += m_timer.nsecsElapsed();
+    }
+
+private:
+    qint64 *m_nanoseconds;
+    QElapsedTimer m_timer;
+};
+
+GenerationEngine::GenerationEngine(const NetworkTopology &topology, const GenerationSettings &settings)
+    : m_settings(settings),
+      m_first(settings.poolSize, topology, settings.sigmoidOutputLayer),
+      m_second(settings.poolSize, topology, settings.sigmoidOutputLayer),
+      m_front(&m_first),
+      m_back(&m_second),
+      m_errors(settings.poolSize, 0.0),
+      m_skippedSamples(0),
+      m_abortedGenomes(0),
+      m_cache(settings.fitnessCache ? 4 * settings.poolSize : 0),
+      m_hashes(settings.poolSize, 0),
+      m_scored(settings.poolSize, Unscored),
+      m_deltas(settings.poolSize),
+      m_incremental(settings.poolSize),
+      m_breedingPool(qMax(1, settings.poolSize / settings.tournamentSize)),
+      m_minError(std::numeric_limits<float>::max()),
+      m_generationMinError(std::numeric_limits<float>::max()),
+      m_random(settings.seed)
+{
+    m_first.randomise(1000, m_random.split(InitialPopulationStream).next());
+    m_bestNetwork.initialiseNetwork(m_first.topology());
+
+    if (settings.fineTuneCount > 0)
+    {
+        m_fineTuneIndices.resize(qMin(settings.fineTuneCount, settings.poolSize));
+        m_fineTuneGenomes.resize(m_fineTuneIndices.size() * m_first.stride());
+        m_fineTuneErrors.resize(m_fineTuneIndices.size());
+    }
+
+    m_selection.setMethod(settings.selectionMethod);
+    m_selection.setTournamentSize(settings.tournamentSize);
+    m_selection.setRankPressure(settings.rankPressure);
+}
+
+const GenerationSettings &GenerationEngine::settings() const
+{
+    return m_settings;
+}
+
+void GenerationEngine::setThreadPool(ThreadPool *threadPool)
+{
+    m_threadPool = threadPool;
+}
+
+ThreadPool *GenerationEngine::threadPool() const
+{
+    return m_threadPool;
+}
+
+// The count errors that come first under before, best first, kept sorted by a short insertion.
+// Returns how many were found, fewer than count only when size is smaller.
+template<typename Compare>
+static int extremeErrors(const float *errors, int size, int *indices, int count, Compare before)
+{
+    int found = 0;
+
+    for (int i = 0; i < size; ++i)
+    {
+        int position = found < count ? found++ : count;
+
+        while (position > 0 && before(errors[i], errors[indices[position - 1]]))
+        {
+            if (position < count)
+                indices[position] = indices[position - 1];
+            position--;
+        }
+
+        if (position < count)
+            indices[position] = i;
+    }
+
+    return found;
+}
+
+void GenerationEngine::setDataset(const DatasetView &dataset)
+{
+    m_dataset = dataset;
+    m_fullDataset = dataset;
+
+    // Cached errors belong to the previous data
+    m_cache.setDatasetVersion(++m_datasetVersion);
+
+    if (usesMiniBatches())
+    {
+        buildStrata();
+
+        m_batchInputs.resize(m_settings.miniBatchSize * dataset.inputSize);
+        m_batchTargets.resize(m_settings.miniBatchSize * dataset.outputSize);
+        m_elites.resize(qMin(qMax(1, m_settings.eliteRescoreCount), poolSize()));
+        m_eliteGenomes.resize(m_elites.size() * m_front->stride());
+    }
+}
+
+bool GenerationEngine::usesMiniBatches() const
+{
+    return m_settings.miniBatchSize > 0 && m_settings.miniBatchSize < m_fullDataset.samples;
+}
+
+void GenerationEngine::buildStrata()
+{
+    const DatasetView &dataset = m_fullDataset;
+    int strata = qMax(1, m_settings.miniBatchStrata);
+
+    if (strata > 1 && dataset.outputSize > 1)
+        strata = dataset.outputSize;
+
+    float low = 0;
+    float high = 0;
+    if (strata > 1 && dataset.outputSize == 1)
+    {
+        low = high = dataset.targetRow(0)[0];
+        for (int i = 1; i < dataset.samples; ++i)
+        {
+            low = qMin(low, dataset.targetRow(i)[0]);
+            high = qMax(high, dataset.targetRow(i)[0]);
+        }
+    }
+
+    auto stratum = [&](int sample)
+    {
+        const float *targets = dataset.targetRow(sample);
+
+        if (strata == 1)
+            return 0;
+        if (dataset.outputSize > 1)
+            return int(std::max_element(targets, targets + dataset.outputSize) - targets);
+        if (high <= low)
+            return 0;
+
+        return qMin(strata - 1, int((targets[0] - low) / (high - low) * strata));
+    };
+
+    // Counting sort of the sample indices by stratum
+    m_strataOffsets = QVector<int>(strata + 1, 0);
+    for (int i = 0; i < dataset.samples; ++i)
+        m_strataOffsets[stratum(i) + 1]++;
+
+    for (int s = 0; s < strata; ++s)
+        m_strataOffsets[s + 1] += m_strataOffsets[s];
+
+    QVector<int> next = m_strataOffsets;
+    m_strataSamples.resize(dataset.samples);
+    for (int i = 0; i < dataset.samples; ++i)
+        m_strataSamples[next[stratum(i)]++] = i;
+
+    // Quotas in proportion to the stratum sizes, the rounding remainder goes to the largest fractions
+    m_strataQuota = QVector<int>(strata, 0);
+    QVector<double> remainders(strata);
+    int assigned = 0;
+
+    for (int s = 0; s < strata; ++s)
+    {
+        double share = double(m_settings.miniBatchSize) * (m_strataOffsets[s + 1] - m_strataOffsets[s]) / dataset.samples;
+        m_strataQuota[s] = int(share);
+        remainders[s] = share - m_strataQuota[s];
+        assigned += m_strataQuota[s];
+    }
+
+    for (; assigned < m_settings.miniBatchSize; ++assigned)
+    {
+        int largest = int(std::max_element(remainders.constBegin(), remainders.constEnd()) - remainders.constBegin());
+        m_strataQuota[largest]++;
+        remainders[largest] = -1;
+    }
+}
+
+void GenerationEngine::sampleMiniBatch()
+{
+    // Drawn with replacement from a stream of the generation, so the batch does not depend on
+    // earlier batches and a restored run draws the same ones
+    Random random = m_random.split(MiniBatchStream).split(quint64(m_generation));
+    const DatasetView &dataset = m_fullDataset;
+
+    float *inputs = m_batchInputs.data();
+    float *targets = m_batchTargets.data();
+
+    for (int s = 0; s < m_strataQuota.size(); ++s)
+    {
+        int first = m_strataOffsets[s];
+        int size = m_strataOffsets[s + 1] - first;
+
+        for (int q = 0; q < m_strataQuota[s]; ++q)
+        {
+            int sample = m_strataSamples[first + random.bounded(size)];
+
+            inputs = std::copy(dataset.inputRow(sample), dataset.inputRow(sample) + dataset.inputSize, inputs);
+            targets = std::copy(dataset.targetRow(sample), dataset.targetRow(sample) + dataset.outputSize, targets);
+        }
+    }
+
+    m_dataset = dataset;
+    m_dataset.inputs = m_batchInputs.constData();
+    m_dataset.targets = m_batchTargets.constData();
+    m_dataset.samples = m_settings.miniBatchSize;
+    m_dataset.inputStride = 0;
+    m_dataset.targetStride = 0;
+
+    // Errors of the previous batch are not comparable
+    m_cache.setDatasetVersion(++m_datasetVersion);
+}
+
+void GenerationEngine::rescoreElites()
+{
+    int eliteCount = extremeErrors(m_errors.constData(), poolSize(), m_elites.data(), m_elites.size(), std::less<float>());
+
+    int stride = m_front->stride();
+    for (int e = 0; e < eliteCount; ++e)
+        std::copy(m_front->genome(m_elites[e]), m_front->genome(m_elites[e]) + stride, m_eliteGenomes.begin() + e * stride);
+
+    // Every shard scores all elites on its slice of the dataset, the rows are summed in order
+    int shards = qMax(1, m_fullDataset.samples / RescoreShardSamples);
+    int shardSize = (m_fullDataset.samples + shards - 1) / shards;
+    m_rescoreAccumulator.reset(shards, eliteCount);
+
+    parallelFor(shards, 1, [&](int firstShard, int count)
+    {
+        for (int shard = firstShard; shard < firstShard + count; ++shard)
+        {
+            int firstSample = shard * shardSize;
+            int samples = qMin(shardSize, m_fullDataset.samples - firstSample);
+
+            if (samples > 0)
+                evaluateGenomes(m_eliteGenomes.constData(), stride, eliteCount,
+                                m_fullDataset.rows(firstSample, samples), m_rescoreAccumulator.row(shard));
+        }
+    });
+
+    float errors[64];
+    int best = -1;
+    float bestError = m_minError;
+
+    for (int first = 0; first < eliteCount; first += 64)
+    {
+        int count = qMin(64, eliteCount - first);
+        m_rescoreAccumulator.reduce(errors, first, count);
+
+        for (int e = 0; e < count; ++e)
+            if (errors[e] < bestError)
+            {
+                best = first + e;
+                bestError = errors[e];
+            }
+    }
+
+    if (best >= 0)
+    {
+        m_minError = bestError;
+        m_bestNetwork.clone(m_front->network(m_elites[best]));
+        m_bestNetwork.resetError();
+        m_bestNetwork.setError(m_minError);
+    }
+
+    m_evaluationStatistics.rescoredGenomes = eliteCount;
+}
+
+void GenerationEngine::setCheckpointWriter(CheckpointWriter *writer, int interval)
+{
+    m_checkpointWriter = writer;
+    m_checkpointInterval = qMax(1, interval);
+}
+
+void GenerationEngine::snapshot(CheckpointSnapshot &snapshot) const
+{
+    const NetworkTopology &topology = m_front->topology();
+    int genomeSize = topology.genomeSize();
+
+    // resize keeps the storage of the previous snapshot, so after the first one this is copies only
+    snapshot.topology = topology;
+    snapshot.genomeCount = poolSize();
+    snapshot.stride = m_front->stride();
+    snapshot.genomes.resize(poolSize() * m_front->stride());
+    std::copy(m_front->data(), m_front->data() + snapshot.genomes.size(), snapshot.genomes.begin());
+    snapshot.errors.resize(poolSize());
+    std::copy(m_errors.constBegin(), m_errors.constEnd(), snapshot.errors.begin());
+
+    bool hasBest = m_minError < std::numeric_limits<float>::max();
+    snapshot.bestGenome.resize(hasBest ? genomeSize : 0);
+    if (hasBest)
+        std::copy(m_bestNetwork.genome(), m_bestNetwork.genome() + genomeSize, snapshot.bestGenome.begin());
+    snapshot.bestError = m_minError;
+
+    snapshot.generation = quint64(m_generation);
+    snapshot.seed = m_settings.seed;
+    snapshot.randomKey = m_random.key();
+    snapshot.randomCounter = m_random.counter();
+}
+
+bool GenerationEngine::restore(const Checkpoint &checkpoint)
+{
+    if (!checkpoint.isOpen() || checkpoint.topology() != m_front->topology() || checkpoint.genomeCount() != poolSize())
+        return false;
+
+    int genomeSize = m_front->topology().genomeSize();
+
+    for (int i = 0; i < poolSize(); ++i)
+        std::copy(checkpoint.genome(i), checkpoint.genome(i) + genomeSize, m_front->genome(i));
+    std::copy(checkpoint.errors(), checkpoint.errors() + poolSize(), m_errors.begin());
+
+    if (checkpoint.hasBestGenome())
+    {
+        std::copy(checkpoint.bestGenome(), checkpoint.bestGenome() + genomeSize, m_bestNetwork.genome());
+        m_minError = checkpoint.bestError();
+        m_bestNetwork.resetError();
+        m_bestNetwork.setError(m_minError);
+    }
+    else
+    {
+        m_minError = std::numeric_limits<float>::max();
+    }
+
+    m_settings.seed = checkpoint.seed();
+    m_random.setState(checkpoint.randomKey(), checkpoint.randomCounter());
+    m_generation = int(checkpoint.generation());
+
+    // The parents the deltas point at are gone
+    for (auto &delta : m_deltas)
+        delta = GenomeDelta();
+
+    m_evaluated = true;
+    return true;
+}
+
+int GenerationEngine::poolSize() const
+{
+    return m_settings.poolSize;
+}
+
+int GenerationEngine::breedingPoolSize() const
+{
+    return m_breedingPool.size();
+}
+
+int GenerationEngine::generation() const
+{
+    return m_generation;
+}
+
+Population &GenerationEngine::population()
+{
+    return *m_front;
+}
+
+const QVector<float> &GenerationEngine::errors() const
+{
+    return m_errors;
+}
+
+const EvaluationStatistics &GenerationEngine::evaluationStatistics() const
+{
+    return m_evaluationStatistics;
+}
+
+void GenerationEngine::setMetricsEnabled(bool enabled)
+{
+    m_metricsEnabled = enabled;
+}
+
+bool GenerationEngine::metricsEnabled() const
+{
+    return m_metricsEnabled;
+}
+
+const GenerationMetrics &GenerationEngine::metrics() const
+{
+    return m_metrics;
+}
+
+GenerationMetrics *GenerationEngine::recordingMetrics()
+{
+    return m_recordingMetrics ? &m_pendingMetrics : nullptr;
+}
+
+void GenerationEngine::startMetrics()
+{
+    if (!m_metricsEnabled || m_recordingMetrics)
+        return;
+
+    m_recordingMetrics = true;
+    std::fill(std::begin(m_pendingMetrics.phaseNanoseconds), std::end(m_pendingMetrics.phaseNanoseconds), 0);
+
+    int threads = m_threadPool ? m_threadPool->threadCount() : 0;
+    if (m_busyNanoseconds.size() != threads)
+    {
+        m_busyNanoseconds.resize(threads);
+        m_pendingMetrics.threadUtilization.resize(threads);
+    }
+
+    for (int i = 0; i < threads; ++i)
+        m_busyNanoseconds[i] = m_threadPool->busyNanoseconds(i);
+
+    m_operatorNewCalls = AllocationCounter::operatorNewCalls();
+    m_operatorNewBytes = AllocationCounter::operatorNewBytes();
+}
+
+void GenerationEngine::finishMetrics()
+{
+    if (!m_recordingMetrics)
+        return;
+
+    m_recordingMetrics = false;
+
+    GenerationMetrics &metrics = m_pendingMetrics;
+    metrics.generation = m_generation;
+    metrics.nanoseconds = 0;
+    for (qint64 nanoseconds : metrics.phaseNanoseconds)
+        metrics.nanoseconds += nanoseconds;
+
+    // The pool may have been swapped mid generation, utilization is then left out
+    int threads = m_threadPool ? m_threadPool->threadCount() : 0;
+    metrics.threadUtilization.resize(threads == m_busyNanoseconds.size() ? threads : 0);
+    for (int i = 0; i < metrics.threadUtilization.size(); ++i)
+    {
+        qint64 busy = m_threadPool->busyNanoseconds(i) - m_busyNanoseconds[i];
+        metrics.threadUtilization[i] = metrics.nanoseconds > 0 ? float(double(busy) / double(metrics.nanoseconds)) : 0.0f;
+    }
+
+    metrics.operatorNewCalls = AllocationCounter::operatorNewCalls() - m_operatorNewCalls;
+    metrics.operatorNewBytes = AllocationCounter::operatorNewBytes() - m_operatorNewBytes;
+
+    double sum = 0;
+    double squares = 0;
+    float minError = std::numeric_limits<float>::max();
+    float maxError = std::numeric_limits<float>::lowest();
+    for (float error : m_errors)
+    {
+        sum += error;
+        squares += double(error) * error;
+        minError = qMin(minError, error);
+        maxError = qMax(maxError, error);
+    }
+
+    double mean = sum / qMax(1, m_errors.size());
+    metrics.minError = minError;
+    metrics.maxError = maxError;
+    metrics.meanError = float(mean);
+    metrics.errorDeviation = float(std::sqrt(qMax(0.0, squares / qMax(1, m_errors.size()) - mean * mean)));
+    metrics.bestError = m_minError;
+    metrics.evaluation = m_evaluationStatistics;
+
+    // Swapped rather than copied so that recording does not allocate
+    std::swap(m_metrics, m_pendingMetrics);
+}
+
+Evaluator &GenerationEngine::threadEvaluator()
+{
+    static thread_local Evaluator evaluator;
+    return evaluator;
+}
+
+Backpropagation &GenerationEngine::threadBackpropagation()
+{
+    static thread_local Backpropagation backpropagation;
+    return backpropagation;
+}
+
+void GenerationEngine::evaluateGenomes(const float *genomes, int stride, int count, const DatasetView &dataset, float *errors)
+{
+    if (m_fixedEvaluate)
+        m_fixedEvaluate(m_front->topology(), genomes, stride, count, dataset, errors);
+    else
+        threadEvaluator().evaluate(m_front->topology(), genomes, stride, count, dataset, errors);
+}
+
+template<typename Body>
+void GenerationEngine::forEachUnscoredRun(int first, int count, const Body &body) const
+{
+    int end = first + count;
+    int runFirst = first;
+
+    while (runFirst < end)
+    {
+        while (runFirst < end && m_scored[runFirst] != Unscored)
+            runFirst++;
+
+        int runEnd = runFirst;
+        while (runEnd < end && m_scored[runEnd] == Unscored)
+            runEnd++;
+
+        if (runEnd > runFirst)
+            body(runFirst, runEnd - runFirst);
+
+        runFirst = runEnd;
+    }
+}
+
+void GenerationEngine::evaluate(int first, int count)
+{
+    forEachUnscoredRun(first, count, [this](int runFirst, int runCount)
+    {
+        float *errors = m_errors.data() + runFirst;
+        std::fill(errors, errors + runCount, 0.0f);
+
+        evaluateGenomes(m_front->genome(runFirst), m_front->stride(), runCount, m_dataset, errors);
+    });
+}
+
+void GenerationEngine::evaluateRacing(int first, int count)
+{
+    forEachUnscoredRun(first, count, [this](int runFirst, int runCount)
+    {
+        float *errors = m_errors.data() + runFirst;
+        std::fill(errors, errors + runCount, 0.0f);
+
+        quint64 skippedSamples = 0;
+        int aborted = threadEvaluator().evaluateRacing(*m_front, runFirst, runCount, m_dataset, errors,
+                                                       m_cutoff.value(), skippedSamples);
+
+        // Tighten the cutoff for the chunks still to come
+        m_cutoff.offer(errors, runCount);
+
+        m_skippedSamples += skippedSamples;
+        m_abortedGenomes += aborted;
+    });
+}
+
+void GenerationEngine::lookupCachedErrors(int first, int count)
+{
+    int genomeSize = m_front->topology().genomeSize();
+
+    for (int i = first; i < first + count; ++i)
+    {
+        m_hashes[i] = FitnessCache::hash(m_front->genome(i), genomeSize);
+        m_scored[i] = m_cache.lookup(m_hashes[i], m_errors[i]) ? ScoredFromCache : Unscored;
+    }
+}
+
+void GenerationEngine::storeCachedErrors(bool racing)
+{
+    // Serial so the cache contents do not depend on the thread count
+    float cutoff = m_cutoff.cutoff();
+    m_cachedGenomes = 0;
+
+    for (int i = 0; i < poolSize(); ++i)
+    {
+        if (m_scored[i] == ScoredFromCache)
+            m_cachedGenomes++;
+        // An aborted genome ends at or above the final cutoff and only has a partial error
+        else if (!racing || m_errors[i] < cutoff)
+            m_cache.insert(m_hashes[i], m_errors[i]);
+    }
+}
+
+void GenerationEngine::evaluateIncremental()
+{
+    // Children with a usable delta, grouped by parent so each group shares the parent's forward pass
+    int *incremental = m_incremental.data();
+    int count = 0;
+
+    for (int i = 0; i < poolSize(); ++i)
+        if (m_scored[i] == Unscored && m_deltas[i].base)
+            incremental[count++] = i;
+
+    std::sort(incremental, incremental + count, [this](int a, int b)
+    {
+        const float *baseA = m_deltas[a].base;
+        const float *baseB = m_deltas[b].base;
+        return baseA != baseB ? std::less<const float *>()(baseA, baseB) : a < b;
+    });
+
+    parallelFor(count, EvaluationChunkSize, [this, incremental](int first, int chunk)
+    {
+        for (int i = first; i < first + chunk; ++i)
+        {
+            m_errors[incremental[i]] = 0.0f;
+            m_scored[incremental[i]] = ScoredIncrementally;
+        }
+
+        threadEvaluator().evaluateDeltas(*m_front, incremental + first, chunk, m_deltas.constData(), m_dataset, m_errors.data());
+    });
+
+    m_incrementalGenomes = count;
+}
+
+GenomeDelta GenerationEngine::genomeDelta(const float *child, const NeuralNetwork *mateA, const NeuralNetwork *mateB) const
+{
+    const NetworkTopology &topology = m_front->topology();
+    GenomeDelta best;
+    int bestCost = topology.genomeSize() / 2;
+
+    // Relative to mateA a crossover child differs in a tail, relative to mateB in a head
+    // that is only cheap when the crossover copied mateB whole
+    for (const NeuralNetwork *mate : {mateA, mateB})
+    {
+        GenomeDelta delta;
+        delta.base = mate->genome();
+        delta.tail = topology.perceptronCount();
+
+        for (int p = 0; p < topology.perceptronCount(); ++p)
+        {
+            int offset = topology.perceptronOffset(p);
+            size_t bytes = sizeof(float) * size_t(topology.perceptronInputs(p) + 1);
+
+            if (std::memcmp(child + offset, delta.base + offset, bytes) == 0)
+                continue;
+
+            // Too many scattered changes, recompute everything from here on
+            if (delta.perceptronCount == GenomeDelta::MaxPerceptrons)
+            {
+                delta.tail = p;
+                break;
+            }
+
+            delta.perceptrons[delta.perceptronCount++] = p;
+        }
+
+        int cost = Evaluator::deltaCost(topology, delta);
+        if (cost < bestCost)
+        {
+            best = delta;
+            bestCost = cost;
+        }
+    }
+
+    return best;
+}
+
+void GenerationEngine::evaluatePopulation()
+{
+    m_skippedSamples = 0;
+    m_abortedGenomes = 0;
+    m_cachedGenomes = 0;
+    m_incrementalGenomes = 0;
+
+    if (usesMiniBatches())
+        sampleMiniBatch();
+
+    if (m_settings.fitnessCache)
+        parallelFor(poolSize(), ReduceChunkSize, [this](int first, int count) { lookupCachedErrors(first, count); });
+    else
+        std::fill(m_scored.begin(), m_scored.end(), Unscored);
+
+    if (m_settings.incrementalEvaluation)
+        evaluateIncremental();
+
+    int genomeChunks = (poolSize() + EvaluationChunkSize - 1) / EvaluationChunkSize;
+    int shards = qMin((MinEvaluationTasks + genomeChunks - 1) / genomeChunks, m_dataset.samples / MinShardSamples);
+
+    // Enough genome chunks to go round, each genome is scored by exactly one task
+    if (shards <= 1)
+    {
+        bool racing = m_settings.earlyAbort && m_settings.selectionMethod == SelectionMethod::Truncation;
+
+        if (racing)
+        {
+            m_cutoff.reset(m_breedingPool.size());
+
+            // Genomes scored already are in the race with their full error
+            for (int i = 0; i < poolSize(); ++i)
+                if (m_scored[i] != Unscored)
+                    m_cutoff.offer(&m_errors[i], 1);
+
+            parallelFor(poolSize(), EvaluationChunkSize, [this](int first, int count) { evaluateRacing(first, count); });
+        }
+        else
+        {
+            parallelFor(poolSize(), EvaluationChunkSize, [this](int first, int count) { evaluate(first, count); });
+        }
+
+        if (m_settings.fitnessCache)
+            storeCachedErrors(racing);
+
+        finishEvaluation();
+        return;
+    }
+
+    // Otherwise split the samples too. Every tile accumulates into its shard's row, at the columns
+    // of its own genomes, without any locking or atomics, and the rows are reduced afterwards.
+    m_accumulator.reset(shards, poolSize());
+    int shardSize = (m_dataset.samples + shards - 1) / shards;
+
+    parallelFor(genomeChunks * shards, 1, [&](int firstTile, int tiles)
+    {
+        for (int tile = firstTile; tile < firstTile + tiles; ++tile)
+        {
+            int shard = tile % shards;
+            int firstGenome = (tile / shards) * EvaluationChunkSize;
+            int genomes = qMin(EvaluationChunkSize, poolSize() - firstGenome);
+            int firstSample = shard * shardSize;
+            int samples = qMin(shardSize, m_dataset.samples - firstSample);
+
+            if (samples <= 0)
+                continue;
+
+            forEachUnscoredRun(firstGenome, genomes, [&](int runFirst, int runCount)
+            {
+                evaluateGenomes(m_front->genome(runFirst), m_front->stride(), runCount, m_dataset.rows(firstSample, samples),
+                                m_accumulator.row(shard) + runFirst);
+            });
+        }
+    });
+
+    parallelFor(poolSize(), ReduceChunkSize, [this](int first, int count)
+    {
+        forEachUnscoredRun(first, count, [this](int runFirst, int runCount)
+        {
+            m_accumulator.reduce(m_errors.data() + runFirst, runFirst, runCount);
+        });
+    });
+
+    if (m_settings.fitnessCache)
+        storeCachedErrors(false);
+
+    finishEvaluation();
+}
+
+void GenerationEngine::evaluateGeneration()
+{
+    {
+        PhaseTimer timer(recordingMetrics(), GenerationPhase::Evaluate);
+        evaluatePopulation();
+    }
+
+    PhaseTimer timer(recordingMetrics(), GenerationPhase::FineTune);
+    fineTuneElites();
+}
+
+void GenerationEngine::fineTuneElites()
+{
+    m_evaluationStatistics.fineTunedGenomes = 0;
+
+    if (m_fineTuneIndices.isEmpty())
+        return;
+
+    const NetworkTopology &topology = m_front->topology();
+    int stride = m_front->stride();
+    int count = extremeErrors(m_errors.constData(), poolSize(), m_fineTuneIndices.data(), m_fineTuneIndices.size(), std::less<float>());
+    Random generationRandom = m_random.split(FineTuneStream).split(quint64(m_generation));
+
+    // Batches come from the whole dataset, the tuned copies are scored like the rest of the
+    // generation. Each elite draws from its own stream so any number of threads gives the same run.
+    parallelFor(count, 1, [&](int first, int elites)
+    {
+        for (int e = first; e < first + elites; ++e)
+        {
+            float *genome = m_fineTuneGenomes.data() + e * stride;
+            const float *original = m_front->genome(m_fineTuneIndices[e]);
+            std::copy(original, original + stride, genome);
+
+            Random random = generationRandom.split(quint64(e));
+            threadBackpropagation().train(topology, genome, m_fullDataset, m_settings.fineTuneSteps,
+                                          m_settings.fineTuneBatchSize, m_settings.learningRate, random);
+
+            m_fineTuneErrors[e] = 0;
+            evaluateGenomes(genome, stride, 1, m_dataset, &m_fineTuneErrors[e]);
+        }
+    });
+
+    float scale = usesMiniBatches() ? float(m_fullDataset.samples) / float(m_dataset.samples) : 1.0f;
+
+    for (int e = 0; e < count; ++e)
+    {
+        int index = m_fineTuneIndices[e];
+        float error = m_fineTuneErrors[e] * scale;
+
+        if (!(error < m_errors[index]))
+            continue;
+
+        if (m_settings.fineTuneMode == FineTuneMode::Lamarckian)
+            std::copy(m_fineTuneGenomes.constData() + e * stride, m_fineTuneGenomes.constData() + (e + 1) * stride, m_front->genome(index));
+
+        m_errors[index] = error;
+        m_evaluationStatistics.fineTunedGenomes++;
+    }
+}
+
+void GenerationEngine::finishEvaluation()
+{
+    // Scale batch errors up to whole dataset sums
+    if (usesMiniBatches())
+    {
+        float scale = float(m_fullDataset.samples) / float(m_dataset.samples);
+        for (auto &error : m_errors)
+            error *= scale;
+    }
+
+    updateEvaluationStatistics();
+}
+
+void GenerationEngine::updateEvaluationStatistics()
+{
+    m_evaluationStatistics.skippedSampleEvaluations = m_skippedSamples;
+    m_evaluationStatistics.abortedGenomes = m_abortedGenomes;
+    m_evaluationStatistics.cachedGenomes = m_cachedGenomes;
+    m_evaluationStatistics.incrementalGenomes = m_incrementalGenomes;
+    m_evaluationStatistics.sampleEvaluations = quint64(poolSize() - m_cachedGenomes) * quint64(m_dataset.samples) - m_skippedSamples;
+}
+
+void GenerationEngine::select()
+{
+    {
+        PhaseTimer timer(recordingMetrics(), GenerationPhase::Elitism);
+
+        int bestIndex = Selection::bestIndex(m_errors.constData(), m_errors.size());
+        m_generationMinError = m_errors[bestIndex];
+        m_evaluationStatistics.rescoredGenomes = 0;
+
+        // Batch errors are estimates, only whole dataset errors may replace the best network
+        if (usesMiniBatches())
+        {
+            bool firstBest = m_minError == std::numeric_limits<float>::max();
+            if (firstBest || m_generation % qMax(1, m_settings.eliteRescoreInterval) == 0)
+                rescoreElites();
+        }
+        else if (m_generationMinError < m_minError)
+        {
+            m_minError = m_generationMinError;
+            m_bestNetwork.clone(m_front->network(bestIndex));
+            m_bestNetwork.resetError();
+            m_bestNetwork.setError(m_minError);
+        }
+    }
+
+    PhaseTimer timer(recordingMetrics(), GenerationPhase::Select);
+
+    Random selectionRandom = m_random.split(SelectionStream).split(quint64(m_generation));
+    m_selection.select(m_errors.constData(), m_errors.size(), m_breedingPool.data(), m_breedingPool.size(), selectionRandom);
+
+    // Push the best network back into the pool if we get worse
+    if (m_generationMinError > m_minError)
+        m_breedingPool.last() = EliteParent;
+
+    Random shuffleRandom = m_random.split(ShuffleStream).split(quint64(m_generation));
+    std::shuffle(m_breedingPool.begin(), m_breedingPool.end(), shuffleRandom);
+}
+
+void GenerationEngine::breed(int first, int count)
+{
+    int breedingPoolSize = m_breedingPool.size();
+    Random generationRandom = m_random.split(BreedStream).split(quint64(m_generation));
+
+    for (int brood = first; brood < first + count; ++brood)
+    {
+        // Each child draws from its own stream so breeding can be split across any number of threads
+        Random random = generationRandom.split(quint64(brood));
+
+        auto *selectionA = parent(m_breedingPool[brood % breedingPoolSize]);
+        auto *selectionB = parent(m_breedingPool[(brood + 1) % breedingPoolSize]);
+
+        NeuralNetwork *child = m_back->network(brood);
+        NeuralNetwork::crossOverBreed(child, selectionA, selectionB,
+                                      m_settings.mutationRate, m_settings.mutationMaxChange, random);
+
+        if (m_settings.incrementalEvaluation)
+            m_deltas[brood] = genomeDelta(child->genome(), selectionA, selectionB);
+    }
+}
+
+NeuralNetwork *GenerationEngine::parent(int breedingPoolIndex)
+{
+    return breedingPoolIndex == EliteParent ? &m_bestNetwork : m_front->network(breedingPoolIndex);
+}
+
+void GenerationEngine::swapPopulations()
+{
+    std::swap(m_front, m_back);
+    m_generation++;
+}
+
+void GenerationEngine::evaluateNextGeneration()
+{
+    if (!m_evaluated)
+    {
+        startMetrics();
+        evaluateGeneration();
+        m_evaluated = true;
+    }
+}
+
+int GenerationEngine::bestGenomes(int *indices, int count) const
+{
+    return extremeErrors(m_errors.constData(), poolSize(), indices, count, std::less<float>());
+}
+
+void GenerationEngine::replaceWorstGenomes(const float *genomes, int stride, const float *errors, int count, int *scratch)
+{
+    Q_ASSERT(m_evaluated);
+
+    int genomeSize = m_front->topology().genomeSize();
+    count = extremeErrors(m_errors.constData(), poolSize(), scratch, count, std::greater<float>());
+
+    for (int i = 0; i < count; ++i)
+    {
+        const float *genome = genomes + size_t(i) * stride;
+        std::copy(genome, genome + genomeSize, m_front->genome(scratch[i]));
+        m_errors[scratch[i]] = errors[i];
+    }
+}
+
+void GenerationEngine::runGeneration()
+{
+    startMetrics();
+
+    if (m_evaluated)
+        m_evaluated = false;
+    else
+        evaluateGeneration();
+
+    if (m_checkpointWriter && m_generation % m_checkpointInterval == 0)
+    {
+        PhaseTimer timer(recordingMetrics(), GenerationPhase::Checkpoint);
+        if (CheckpointSnapshot *snapshot = m_checkpointWriter->acquire())
+        {
+            this->snapshot(*snapshot);
+            m_checkpointWriter->submit();
+        }
+    }
+
+    select();
+
+    {
+        PhaseTimer timer(recordingMetrics(), GenerationPhase::Breed);
+        parallelFor(poolSize(), BreedChunkSize, [this](int first, int count) { breed(first, count); });
+    }
+
+    finishMetrics();
+    swapPopulations();
+}
+
+float GenerationEngine::minError() const
+{
+    return m_minError;
+}
+
+float GenerationEngine::generationMinError() const
+{
+    return m_generationMinError;
+}
+
+NeuralNetwork *GenerationEngine::bestNetwork()
+{
+    return &m_bestNetwork;
+}
@@ -0,0 +1,303 @@
+#ifndef GENERATIONENGINE_H
+#define GENERATIONENGINE_H
+
+#include <QVector>
+#include "backpropagation.h"
+#include "checkpoint.h"
+#include "evaluator.h"
+#include "fitnesscache.h"
+#include "fitnessaccumulator.h"
+#include "fixednetwork.h"
+#include "racingcutoff.h"
+#include "neuralnetwork.h"
+#include "population.h"
+#include "random.h"
+#include "selection.h"
+#include "threadpool.h"
+
+enum class FineTuneMode
+{
+    // The tuned weights replace the genome's, so children inherit what was learned
+    Lamarckian,
+    // The genome keeps its bred weights and only takes the tuned error as its fitness
+    Baldwinian
+};
+
+struct GenerationSettings
+{
+    int poolSize = 10000;
+    // The breeding pool holds poolSize / tournamentSize parents, Tournament selection uses it as k
+    int tournamentSize = 10;
+    SelectionMethod selectionMethod = SelectionMethod::Truncation;
+    float rankPressure = 1.5;
+    // Stop scoring a genome once it can no longer make the breeding pool. Only used with
+    // Truncation selection and when the samples are not sharded, the errors of dropped
+    // genomes are then lower bounds.
+    bool earlyAbort = false;
+    // Reuse the error of a genome already scored on the current dataset
+    bool fitnessCache = true;
+    // Score children that differ from a parent in at most GenomeDelta::MaxPerceptrons perceptrons
+    // by updating the parent's activations. Pays off for wide layers, rounding differs slightly.
+    bool incrementalEvaluation = false;
+    // Score each generation on miniBatchSize samples drawn with replacement, 0 for the whole
+    // dataset. The batch errors are scaled up to the dataset size so they stay comparable.
+    int miniBatchSize = 0;
+    // Draw from each class in proportion to its size. The class is the largest target, or with a
+    // single target its value binned into miniBatchStrata equal-width bins. 1 disables this.
+    int miniBatchStrata = 1;
+    // With mini-batches the best network only changes when the eliteRescoreCount best genomes
+    // of a generation are scored on the whole dataset, every eliteRescoreInterval generations
+    int eliteRescoreInterval = 10;
+    int eliteRescoreCount = 4;
+    // Memetic fine-tuning. After scoring, the fineTuneCount best genomes take fineTuneSteps
+    // gradient steps on batches of fineTuneBatchSize samples and are scored again, a tuned
+    // genome is only kept when it does better. With Baldwinian tuning the best network's error
+    // is that of its tuned version. 0 disables this.
+    int fineTuneCount = 0;
+    int fineTuneSteps = 5;
+    int fineTuneBatchSize = 32;
+    float learningRate = 0.1f;
+    FineTuneMode fineTuneMode = FineTuneMode::Lamarckian;
+    float mutationRate = 0.5;
+    float mutationMaxChange = 1.0;
+    bool sigmoidOutputLayer = true;
+    // Every random decision of a run is derived from this seed
+    quint64 seed = 0;
+};
+
+struct EvaluationStatistics
+{
+    quint64 sampleEvaluations = 0;
+    quint64 skippedSampleEvaluations = 0;
+    int abortedGenomes = 0;
+    int cachedGenomes = 0;
+    int incrementalGenomes = 0;
+    int rescoredGenomes = 0;
+    int fineTunedGenomes = 0;
+};
+
+enum class GenerationPhase
+{
+    Evaluate,
+    FineTune,
+    // Keeping the best network, and rescoring the elites with mini-batches
+    Elitism,
+    Select,
+    // Crossover and mutation, which are one pass over each child's genome
+    Breed,
+    Checkpoint
+};
+
+// What one generation cost and how its population scored
+struct GenerationMetrics
+{
+    static const int PhaseCount = 6;
+
+    int generation = 0;
+    // Wall time per GenerationPhase, and their sum
+    qint64 phaseNanoseconds[PhaseCount] = {};
+    qint64 nanoseconds = 0;
+    // Busy time of each ThreadPool worker over the phases, empty without a pool
+    QVector<float> threadUtilization;
+    // Calls to operator new during the generation and the bytes they asked for, only counted
+    // while the AllocationCounter is enabled in a build that has it
+    quint64 operatorNewCalls = 0;
+    quint64 operatorNewBytes = 0;
+    // Over the errors the generation selected from
+    float minError = 0;
+    float meanError = 0;
+    float maxError = 0;
+    float errorDeviation = 0;
+    // Of the run so far
+    float bestError = 0;
+    EvaluationStatistics evaluation;
+};
+
+// Runs the generational loop over two preallocated populations. Children are bred
+// straight from the front population into the back one and the two are swapped, so
+// once constructed a generation does not touch the heap.
+class GenerationEngine
+{
+public:
+    GenerationEngine(const NetworkTopology &topology, const GenerationSettings &settings);
+
+    GenerationEngine(const GenerationEngine &) = delete;
+    GenerationEngine &operator=(const GenerationEngine &) = delete;
+
+    const GenerationSettings &settings() const;
+
+    // Evaluation and breeding are spread over the pool, without one they run on the calling thread
+    void setThreadPool(ThreadPool *threadPool);
+    ThreadPool *threadPool() const;
+
+    void setDataset(const DatasetView &dataset);
+
+    // Scores genomes with FixedEvaluator<Network> instead of the generic Evaluator, where Network
+    // is a FixedNetwork. Returns false and changes nothing when its sizes differ from the topology.
+    // Racing and incremental evaluation keep using the generic Evaluator.
+    template<typename Network>
+    bool useFixedNetwork();
+
+    // Records a GenerationMetrics for every generation. May be switched between generations,
+    // the cost while enabled is a timer per phase and a pass over the errors.
+    void setMetricsEnabled(bool enabled);
+    bool metricsEnabled() const;
+    // Of the last generation recorded
+    const GenerationMetrics &metrics() const;
+
+    // Every interval generations the evaluated population is copied to the writer, which saves it
+    // in the background. A snapshot is skipped when the previous one is still being written.
+    void setCheckpointWriter(CheckpointWriter *writer, int interval);
+
+    // Copies the evaluated front population and the run state, reusing the snapshot's storage
+    void snapshot(CheckpointSnapshot &snapshot) const;
+    // Continues the run saved in checkpoint, the next generation starts from its selection
+    bool restore(const Checkpoint &checkpoint);
+
+    int poolSize() const;
+    int breedingPoolSize() const;
+    int generation() const;
+
+    Population &population();
+    const QVector<float> &errors() const;
+    const EvaluationStatistics &evaluationStatistics() const;
+
+    // Phases of one generation. evaluate and breed may be called concurrently for disjoint ranges.
+    void evaluate(int first, int count);
+    void evaluateRacing(int first, int count);
+    void evaluatePopulation();
+    void select();
+    void breed(int first, int count);
+    void swapPopulations();
+
+    void runGeneration();
+
+    // Evaluates the front population ahead of time, the next runGeneration starts from its
+    // selection. Between the two the evaluated genomes can be inspected and replaced.
+    void evaluateNextGeneration();
+    // Indices of the count lowest errors of the evaluated front population, best first
+    int bestGenomes(int *indices, int count) const;
+    // Overwrites the count worst genomes of the evaluated front population, scratch holds count ints
+    void replaceWorstGenomes(const float *genomes, int stride, const float *errors, int count, int *scratch);
+
+    float minError() const;
+    float generationMinError() const;
+    NeuralNetwork *bestNetwork();
+
+private:
+    GenerationSettings m_settings;
+    // The samples scored this generation, the whole dataset or the mini-batch
+    DatasetView m_dataset;
+    DatasetView m_fullDataset;
+    ThreadPool *m_threadPool = nullptr;
+    CheckpointWriter *m_checkpointWriter = nullptr;
+    int m_checkpointInterval = 0;
+    // Set by restore and evaluateNextGeneration, the front population's errors are already known
+    bool m_evaluated = false;
+
+    Population m_first;
+    Population m_second;
+    Population *m_front;
+    Population *m_back;
+
+    NeuralNetwork *parent(int breedingPoolIndex);
+    void lookupCachedErrors(int first, int count);
+    void storeCachedErrors(bool racing);
+    void evaluateIncremental();
+    GenomeDelta genomeDelta(const float *child, const NeuralNetwork *mateA, const NeuralNetwork *mateB) const;
+    void finishEvaluation();
+    void evaluateGeneration();
+    void fineTuneElites();
+    GenerationMetrics *recordingMetrics();
+    void startMetrics();
+    void finishMetrics();
+    void updateEvaluationStatistics();
+    bool usesMiniBatches() const;
+    void buildStrata();
+    void sampleMiniBatch();
+    void rescoreElites();
+
+    template<typename Body>
+    void forEachUnscoredRun(int first, int count, const Body &body) const;
+
+    template<typename Body>
+    void parallelFor(int count, int chunkSize, const Body &body);
+    static Evaluator &threadEvaluator();
+    static Backpropagation &threadBackpropagation();
+    void evaluateGenomes(const float *genomes, int stride, int count, const DatasetView &dataset, float *errors);
+
+    using EvaluateFunction = void (*)(const NetworkTopology &, const float *, int, int, const DatasetView &, float *);
+    EvaluateFunction m_fixedEvaluate = nullptr;
+
+    QVector<float> m_errors;
+    FitnessAccumulator m_accumulator;
+    RacingCutoff m_cutoff;
+    std::atomic<quint64> m_skippedSamples;
+    std::atomic<int> m_abortedGenomes;
+    EvaluationStatistics m_evaluationStatistics;
+
+    bool m_metricsEnabled = false;
+    // Set from the first phase of a generation to its end
+    bool m_recordingMetrics = false;
+    GenerationMetrics m_metrics;
+    GenerationMetrics m_pendingMetrics;
+    QVector<qint64> m_busyNanoseconds;
+    quint64 m_operatorNewCalls = 0;
+    quint64 m_operatorNewBytes = 0;
+    FitnessCache m_cache;
+    QVector<quint64> m_hashes;
+    QVector<char> m_scored;
+    int m_cachedGenomes = 0;
+    // What each child of the front population was bred from
+    QVector<GenomeDelta> m_deltas;
+    QVector<int> m_incremental;
+    int m_incrementalGenomes = 0;
+    quint32 m_datasetVersion = 0;
+
+    // Sample indices grouped by stratum, and how many of each a batch takes
+    QVector<int> m_strataSamples;
+    QVector<int> m_strataOffsets;
+    QVector<int> m_strataQuota;
+    QVector<float> m_batchInputs;
+    QVector<float> m_batchTargets;
+    QVector<int> m_elites;
+    QVector<float> m_eliteGenomes;
+    // The fine-tuned genomes and their errors, in order of their errors before tuning
+    QVector<int> m_fineTuneIndices;
+    QVector<float> m_fineTuneGenomes;
+    QVector<float> m_fineTuneErrors;
+    FitnessAccumulator m_rescoreAccumulator;
+
+    QVector<int> m_breedingPool;
+    Selection m_selection;
+
+    NeuralNetwork m_bestNetwork;
+    float m_minError;
+    float m_generationMinError;
+    int m_generation = 0;
+
+    Random m_random;
+};
+
+template<typename Network>
+bool GenerationEngine::useFixedNetwork()
+{
+    if (!Network::matches(m_front->topology()))
+        return false;
+
+    // Cached errors may round differently from what the fixed evaluator computes
+    m_fixedEvaluate = &FixedEvaluator<Network>::evaluate;
+    m_cache.clear();
+    return true;
+}
+
+template<typename Body>
+void GenerationEngine::parallelFor(int count, int chunkSize, const Body &body)
+{
+    if (m_threadPool)
+        m_threadPool->parallelFor(count, chunkSize, body);
+    else
+        body(0, count);
+}
+
+#endif // GENERATIONENGINE_H
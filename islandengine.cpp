@@ -0,0 +1,233 @@
+#include "islandengine.h"
+#include <algorithm>
+
+// Stream of the run seed used for migration decisions, the islands use streams 0 .. islandCount - 1
+static const quint64 MigrationStream = ~quint64(0);
+
+IslandEngine::IslandEngine(const NetworkTopology &topology, const GenerationSettings &settings, const IslandSettings &islandSettings,
+                           int firstIsland, int localIslandCount)
+    : m_islandSettings(islandSettings),
+      m_random(settings.seed, MigrationStream)
+{
+    m_islandSettings.islandCount = qMax(1, islandSettings.islandCount);
+    m_islandSettings.migrationInterval = qMax(1, islandSettings.migrationInterval);
+
+    m_firstIsland = qBound(0, firstIsland, m_islandSettings.islandCount - 1);
+    if (localIslandCount < 0)
+        localIslandCount = m_islandSettings.islandCount;
+    localIslandCount = qBound(1, localIslandCount, m_islandSettings.islandCount - m_firstIsland);
+
+    for (int i = m_firstIsland; i < m_firstIsland + localIslandCount; ++i)
+    {
+        GenerationSettings islandSettings = settings;
+        islandSettings.seed = Random(settings.seed, quint64(i)).next();
+        m_islands << new GenerationEngine(topology, islandSettings);
+    }
+
+    // Immigrants never take more than half of an island
+    int senders = qMax(1, senderCount());
+    m_migrantCount = qBound(0, islandSettings.migrantCount, settings.poolSize / (2 * senders));
+    m_stride = m_islands.first()->population().stride();
+
+    int islands = m_islandSettings.islandCount;
+    m_migrantGenomes.resize(islands * m_migrantCount * m_stride);
+    m_migrantErrors.resize(islands * m_migrantCount);
+    m_migrantIndices.resize(islands * m_migrantCount);
+    m_replaced.resize(islands * m_migrantCount);
+}
+
+IslandEngine::~IslandEngine()
+{
+    qDeleteAll(m_islands);
+}
+
+const IslandSettings &IslandEngine::islandSettings() const
+{
+    return m_islandSettings;
+}
+
+void IslandEngine::setThreadPool(ThreadPool *threadPool)
+{
+    m_threadPool = threadPool;
+}
+
+void IslandEngine::setDataset(const DatasetView &dataset)
+{
+    for (auto *island : m_islands)
+        island->setDataset(dataset);
+}
+
+int IslandEngine::islandCount() const
+{
+    return m_islandSettings.islandCount;
+}
+
+int IslandEngine::firstIsland() const
+{
+    return m_firstIsland;
+}
+
+int IslandEngine::localIslandCount() const
+{
+    return m_islands.size();
+}
+
+GenerationEngine *IslandEngine::island(int index)
+{
+    return m_islands[index];
+}
+
+int IslandEngine::generation() const
+{
+    return m_islands.first()->generation();
+}
+
+void IslandEngine::runEpoch()
+{
+    runGenerations();
+    migrate();
+}
+
+void IslandEngine::runGenerations()
+{
+    parallelFor(localIslandCount(), [this](int first, int count)
+    {
+        for (int i = first; i < first + count; ++i)
+            for (int generation = 0; generation < m_islandSettings.migrationInterval; ++generation)
+                m_islands[i]->runGeneration();
+    });
+}
+
+void IslandEngine::migrate()
+{
+    // Every island publishes its best before any island takes in others
+    publishMigrants();
+    acceptMigrants();
+}
+
+bool IslandEngine::migrates() const
+{
+    return islandCount() > 1 && m_migrantCount > 0;
+}
+
+void IslandEngine::publishMigrants()
+{
+    if (!migrates())
+        return;
+
+    parallelFor(localIslandCount(), [this](int first, int count)
+    {
+        for (int i = first; i < first + count; ++i)
+            sendMigrants(m_firstIsland + i);
+    });
+}
+
+void IslandEngine::acceptMigrants()
+{
+    if (migrates())
+    {
+        parallelFor(localIslandCount(), [this](int first, int count)
+        {
+            for (int i = first; i < first + count; ++i)
+                receiveMigrants(m_firstIsland + i);
+        });
+    }
+
+    m_epoch++;
+}
+
+int IslandEngine::migrantCount() const
+{
+    return m_migrantCount;
+}
+
+int IslandEngine::stride() const
+{
+    return m_stride;
+}
+
+float *IslandEngine::migrantGenomes()
+{
+    return m_migrantGenomes.data();
+}
+
+float *IslandEngine::migrantErrors()
+{
+    return m_migrantErrors.data();
+}
+
+void IslandEngine::sendMigrants(int island)
+{
+    GenerationEngine *engine = m_islands[island - m_firstIsland];
+    engine->evaluateNextGeneration();
+
+    int *indices = m_migrantIndices.data() + island * m_migrantCount;
+    int count = engine->bestGenomes(indices, m_migrantCount);
+
+    for (int m = 0; m < count; ++m)
+    {
+        const float *genome = engine->population().genome(indices[m]);
+        std::copy(genome, genome + m_stride, m_migrantGenomes.begin() + (island * m_migrantCount + m) * m_stride);
+        m_migrantErrors[island * m_migrantCount + m] = engine->errors()[indices[m]];
+    }
+}
+
+void IslandEngine::receiveMigrants(int island)
+{
+    int *scratch = m_replaced.data() + island * m_migrantCount;
+
+    for (int sender = 0; sender < senderCount(); ++sender)
+    {
+        int source = migrantSource(island, sender);
+
+        m_islands[island - m_firstIsland]->replaceWorstGenomes(m_migrantGenomes.constData() + source * m_migrantCount * m_stride, m_stride,
+                                                               m_migrantErrors.constData() + source * m_migrantCount, m_migrantCount, scratch);
+    }
+}
+
+int IslandEngine::senderCount() const
+{
+    if (m_islandSettings.islandCount < 2)
+        return 0;
+
+    return m_islandSettings.topology == MigrationTopology::FullyConnected ? m_islandSettings.islandCount - 1 : 1;
+}
+
+int IslandEngine::migrantSource(int island, int sender) const
+{
+    int islands = islandCount();
+
+    switch (m_islandSettings.topology)
+    {
+    case MigrationTopology::Ring:
+        return (island + islands - 1) % islands;
+    case MigrationTopology::Random:
+    {
+        Random random = m_random.split(quint64(m_epoch)).split(quint64(island));
+        return (island + 1 + random.bounded(islands - 1)) % islands;
+    }
+    case MigrationTopology::FullyConnected:
+        return sender < island ? sender : sender + 1;
+    }
+
+    return island;
+}
+
+float IslandEngine::minError() const
+{
+    float minError = m_islands.first()->minError();
+    for (auto *island : m_islands)
+        minError = qMin(minError, island->minError());
+
+    return minError;
+}
+
+NeuralNetwork *IslandEngine::bestNetwork()
+{
+    GenerationEngine *best = m_islands.first();
+    for (auto *island : m_islands)
+        if (island->minError() < best->minError())
+            best = island;
+
+    return best->bestNetwork();
+}
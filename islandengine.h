@@ -0,0 +1,125 @@
+#ifndef ISLANDENGINE_H
+#define ISLANDENGINE_H
+
+#include <QVector>
+#include "generationengine.h"
+
+enum class MigrationTopology
+{
+    // Island i sends to island i + 1
+    Ring,
+    // Every island receives from one other island, drawn again at each migration
+    Random,
+    // Every island receives from all the others
+    FullyConnected
+};
+
+struct IslandSettings
+{
+    int islandCount = 4;
+    // Generations each island runs on its own between migrations
+    int migrationInterval = 10;
+    // Best genomes an island sends, they replace the worst genomes of the receiver
+    int migrantCount = 5;
+    MigrationTopology topology = MigrationTopology::Ring;
+};
+
+// Evolves islandCount independent sub-populations, one task per island, so workers only meet
+// at migrations instead of every generation. GenerationSettings::poolSize is per island and
+// each island draws its seed from the run seed, so a run is the same on any number of threads.
+//
+// An engine may host only islands firstIsland .. firstIsland + localIslandCount - 1 of the run,
+// the others being evolved by other processes. The migrant buffers always cover every island,
+// so such engines only have to exchange them between publishMigrants and acceptMigrants.
+class IslandEngine
+{
+public:
+    IslandEngine(const NetworkTopology &topology, const GenerationSettings &settings, const IslandSettings &islandSettings,
+                 int firstIsland = 0, int localIslandCount = -1);
+    ~IslandEngine();
+
+    IslandEngine(const IslandEngine &) = delete;
+    IslandEngine &operator=(const IslandEngine &) = delete;
+
+    const IslandSettings &islandSettings() const;
+
+    // Islands are spread over the pool, without one they run in turn on the calling thread
+    void setThreadPool(ThreadPool *threadPool);
+    void setDataset(const DatasetView &dataset);
+    // See GenerationEngine::useFixedNetwork
+    template<typename Network>
+    bool useFixedNetwork();
+
+    int islandCount() const;
+    int firstIsland() const;
+    int localIslandCount() const;
+    // Local island, index counts from firstIsland
+    GenerationEngine *island(int index);
+    int generation() const;
+
+    // Runs migrationInterval generations on every island, then migrates
+    void runEpoch();
+    void runGenerations();
+    void migrate();
+
+    // The two halves of migrate. Local islands write their best genomes to their slots of
+    // the buffers, then replace their worst genomes with the migrants of their senders.
+    void publishMigrants();
+    void acceptMigrants();
+
+    // Island major, migrantCount genomes of stride floats and migrantCount errors per island
+    int migrantCount() const;
+    int stride() const;
+    float *migrantGenomes();
+    float *migrantErrors();
+
+    // Over the local islands
+    float minError() const;
+    NeuralNetwork *bestNetwork();
+
+private:
+    bool migrates() const;
+    void sendMigrants(int island);
+    void receiveMigrants(int island);
+    int migrantSource(int island, int sender) const;
+    int senderCount() const;
+
+    template<typename Body>
+    void parallelFor(int count, const Body &body);
+
+    IslandSettings m_islandSettings;
+    ThreadPool *m_threadPool = nullptr;
+    QVector<GenerationEngine*> m_islands;
+    int m_firstIsland;
+    int m_epoch = 0;
+    Random m_random;
+
+    // Outgoing genomes and errors, migrantCount per island
+    int m_stride;
+    int m_migrantCount;
+    QVector<float> m_migrantGenomes;
+    QVector<float> m_migrantErrors;
+    QVector<int> m_migrantIndices;
+    QVector<int> m_replaced;
+};
+
+template<typename Network>
+bool IslandEngine::useFixedNetwork()
+{
+    bool used = true;
+    for (auto *island : m_islands)
+        used = island->useFixedNetwork<Network>() && used;
+
+    return used;
+}
+
+template<typename Body>
+void IslandEngine::parallelFor(int count, const Body &body)
+{
+    if (m_threadPool)
+        m_threadPool->parallelFor(count, 1, body);
+    else
+        body(0, count);
+}
+
+#endif // ISLANDENGINE_H
@@ -2,6 +2,7 @@
 #include <QDateTime>
 #include <QDateTime>
 #include <QDebug>
+#include <QProcess>
 #include <QThread>
 #include <QVector>
 #include <random>
@@ -9,136 +10,381 @@
 #include <iterator>
 #include <iostream>
 #include <qmath.h>
+#include <string>
 #include <vector>
+#include "allocationcounter.h"
+#include "checkpoint.h"
+#include "dataset.h"
+#include "distributedengine.h"
+#include "evolutionstrategy.h"
+#include "generationengine.h"
+#include "metricswriter.h"
+#include "neatengine.h"
 #include "neuralnetwork.h"
+#include "quantizednetwork.h"
+#include "threadpool.h"
 #include <iostream>
-#include "opencv2/opencv.hpp"
 
-int main(int argc, char *argv[])
+// Layer sizes and activations, eg. 3-2-1 sigmoid/sigmoid
+static QString topologyName(const NetworkTopology &topology)
 {
-    QCoreApplication a(argc, argv);
-    qsrand(QDateTime::currentMSecsSinceEpoch());
-
-    QVector<QVector<float>> trainingInputs;
-    trainingInputs << std::initializer_list<float>({0, 0, 0}) <<
-                      std::initializer_list<float>({0, 0, 1}) <<
-                      std::initializer_list<float>({0, 1, 0}) <<
-                      std::initializer_list<float>({0, 1, 1}) <<
-                      std::initializer_list<float>({1, 0, 0}) <<
-                      std::initializer_list<float>({1, 0, 1}) <<
-                      std::initializer_list<float>({1, 1, 0}) <<
-                      std::initializer_list<float>({1, 1, 1});
-
-
-    QVector<QVector<float>> trainingOutputs;
-    trainingOutputs << std::initializer_list<float>({0}) <<
-                       std::initializer_list<float>({1}) <<
-                       std::initializer_list<float>({1}) <<
-                       std::initializer_list<float>({0}) <<
-                       std::initializer_list<float>({1}) <<
-                       std::initializer_list<float>({0}) <<
-                       std::initializer_list<float>({0}) <<
-                       std::initializer_list<float>({0});
+    QString sizes = QString::number(topology.inputs());
+    QStringList activations;
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+    {
+        sizes += '-' + QString::number(topology.layerSize(layer));
+        activations << ActivationKernels::name(topology.layerActivation(layer));
+    }
 
-    int poolSize = 10000;
-    int runs = 100;
-    int tournementSize = 10;
-    float mutationRate = 0.5;
-    float mutationMaxChange = 1.0;
+    return sizes + ' ' + activations.join('/');
+}
 
-    QVector<int> layers;
-    layers << 2 << 1;
+// Spreads islands over worker processes, started here when spawnWorkers is set
+static int runCoordinator(const QString &address, int workerCount, bool spawnWorkers, const NetworkTopology &topology,
+                          GenerationSettings settings, const DatasetView &dataset, int generations, const QString &bestNetworkPath)
+{
+    IslandSettings islandSettings;
+    islandSettings.islandCount = qMax(islandSettings.islandCount, workerCount);
+
+    // The pool is shared out over the islands
+    settings.poolSize = qMax(settings.tournamentSize, settings.poolSize / islandSettings.islandCount);
+
+    DistributedCoordinator coordinator(topology, settings, islandSettings);
+    if (!coordinator.listen(address))
+    {
+        qDebug() << "Could not listen:" << coordinator.errorString();
+        return 1;
+    }
 
-    int dataSetSize = trainingInputs.size();
-    int nInputs = trainingInputs.first().size();
+    QList<QProcess*> workers;
+    if (spawnWorkers)
+    {
+        QString workerAddress = address.startsWith("*:") ? "localhost" + address.mid(1) : address;
 
-    QVector<NeuralNetwork*> networkPool(poolSize);
-    QVector<NeuralNetwork*> offspringPool(poolSize);
-    QVector<NeuralNetwork*> superPool(poolSize + (poolSize / 2));
+        for (int i = 0; i < workerCount; ++i)
+        {
+            auto *worker = new QProcess;
+            worker->setProcessChannelMode(QProcess::ForwardedChannels);
+            worker->start(QCoreApplication::applicationFilePath(), QStringList() << "--worker" << workerAddress);
+            workers << worker;
+        }
+    }
 
+    bool ok = coordinator.start(workerCount, dataset);
+    if (ok)
+        qDebug() << "Workers:" << coordinator.workerCount() << "Islands:" << islandSettings.islandCount;
 
-    for (int i = 0; i < poolSize; ++i)
+    for (int epoch = 0; ok && epoch * islandSettings.migrationInterval < generations; ++epoch)
     {
-        networkPool[i] = new NeuralNetwork();
-        auto *network = networkPool[i];
-        network->initialiseNetwork(nInputs, layers);
-        bool debug = true;
+        ok = coordinator.runEpoch();
+        qDebug() << "Generation:" << coordinator.generation() << " Min Error=" << coordinator.minError();
+
+        if (coordinator.minError() <= 0.0)
+            break;
     }
 
-    QVector<NeuralNetwork*> breedingPool(poolSize / tournementSize);
-    QMap<int, NeuralNetwork*> tournamentWinners;
+    if (!ok)
+        qDebug() << "Distributed run failed:" << coordinator.errorString();
+
+    coordinator.shutdown();
+    for (auto *worker : workers)
+        worker->waitForFinished();
+    qDeleteAll(workers);
+
+    QString checkpointError;
+    if (ok && !Checkpoint::writeNetwork(bestNetworkPath, coordinator.bestNetwork(), &checkpointError))
+        qDebug() << "Could not save the best network:" << checkpointError;
+
+    return ok ? 0 : 1;
+}
+
+// Runs an evolution strategy on the same budget of evaluations as the genetic algorithm
+static int runEvolutionStrategy(const NetworkTopology &topology, const EvolutionStrategySettings &settings,
+                                const DatasetView &dataset, quint64 maxEvaluations, const QString &bestNetworkPath)
+{
+    EvolutionStrategy strategy(topology, settings);
+    strategy.setDataset(dataset);
+
+    ThreadPool threadPool(QThread::idealThreadCount());
+    strategy.setThreadPool(&threadPool);
+
+    qDebug() << "Lambda:" << strategy.lambda() << "Mu:" << strategy.mu() << "Diagonal:" << strategy.isDiagonal();
 
-    auto shufflePool = [](QVector<NeuralNetwork*> &pool)->void
+    // Generations are cheap, only report the ones that improve on the best error
+    float reportedError = strategy.minError();
+    while (strategy.evaluations() < maxEvaluations && strategy.minError() > 0.0)
     {
-        std::random_device rd;
-        std::mt19937 g(rd());
-        std::shuffle(pool.begin(), pool.end(), g);
-    };
+        strategy.runGeneration();
 
-    auto sortLeastError = [](QVector<NeuralNetwork*> &pool)->void
+        if (strategy.minError() < reportedError)
+        {
+            reportedError = strategy.minError();
+            qDebug() << "Generation:" << strategy.generation() << "Evaluations:" << strategy.evaluations()
+                     << " Min Error=" << strategy.minError() << " Sigma=" << strategy.sigma();
+        }
+    }
+
+    qDebug() << "Best Error" << strategy.minError() << "after" << strategy.evaluations() << "evaluations";
+
+    QString checkpointError;
+    if (!Checkpoint::writeNetwork(bestNetworkPath, strategy.bestNetwork(), &checkpointError))
+        qDebug() << "Could not save the best network:" << checkpointError;
+
+    return 0;
+}
+
+// Grows networks from bare inputs and outputs, on the same budget of evaluations as the genetic algorithm
+static int runNeat(int inputs, int outputs, const NeatSettings &settings, const DatasetView &dataset, quint64 maxEvaluations)
+{
+    NeatEngine engine(inputs, outputs, settings);
+    engine.setDataset(dataset);
+
+    ThreadPool threadPool(QThread::idealThreadCount());
+    engine.setThreadPool(&threadPool);
+
+    float reportedError = engine.minError();
+    while (engine.evaluations() < maxEvaluations && engine.minError() > 0.0)
     {
-        std::sort(pool.begin(), pool.end(), [&](NeuralNetwork *a, NeuralNetwork *b)->bool { return a->error() < b->error();});
-    };
+        engine.runGeneration();
+        if (engine.minError() >= reportedError)
+            continue;
+
+        reportedError = engine.minError();
+        const NeatGenome &best = engine.bestGenome();
+        qDebug() << "Generation:" << engine.generation() << " Min Error=" << engine.minError()
+                 << " Species:" << engine.speciesCount() << " Hidden nodes:" << best.hiddenCount()
+                 << " Connections:" << best.enabledConnectionCount();
+    }
 
-    float minError = 999999999;
-    NeuralNetwork bestOverallNeuralNetwork;
+    qDebug() << "Best Error" << engine.minError() << "after" << engine.evaluations() << "evaluations";
 
-    cv::Mat threadPool = cv::Mat::zeros(poolSize, 1, CV_8UC1);
+    SparseNetwork *network = engine.bestNetwork();
+    qDebug() << "Compiled nodes:" << network->nodeCount() << "edges:" << network->connectionCount();
 
-    for (int run = 0; run < runs; ++ run)
+    for (const auto &connection : engine.bestGenome().connections())
     {
+        if (connection.enabled)
+            qDebug() << connection.from << "->" << connection.to << "weight" << connection.weight;
+    }
 
-        // Reset error from previous run
-        //for (auto *network : networkPool)
+    for (int i = 0; i < qMin(dataset.samples, 8); ++i)
+    {
+        QVector<float> sample(dataset.inputRow(i), dataset.inputRow(i) + dataset.inputSize);
+        qDebug() << "Input =" << sample << "Output =" << network->runMultiOutput(sample);
+    }
 
+    return 0;
+}
 
-        // Run all perceptrons for each dataset
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
 
-        threadPool.forEach<uchar>([&](uchar &thread, const int *position)->void
-        {
-            int poolIndex = position[0];
-           // int dataSetIndex = position[1];
+    // Three bit parity, each row is the inputs followed by the target
+    const float parityTable[] = {0, 0, 0, 0,
+                                 0, 0, 1, 1,
+                                 0, 1, 0, 1,
+                                 0, 1, 1, 0,
+                                 1, 0, 0, 1,
+                                 1, 0, 1, 0,
+                                 1, 1, 0, 0,
+                                 1, 1, 1, 0};
+
+    // Usage: NeuralNetworkTest [options] [dataset.csv | dataset.gnnd] [target columns]
+    // CSV files are read whole, a packed file is mapped and used in place
+    //   --worker ADDRESS       evolve islands for the coordinator at ADDRESS until it is done
+    //   --coordinator ADDRESS  spread islands over the workers connecting to host:port or unix:path
+    //   --workers N            workers the coordinator waits for, 2 by default
+    //   --spawn-workers        start the workers on this host
+    //   --fine-tune COUNT      take gradient steps on the COUNT best genomes of every generation
+    //   --metrics PATH         record phase times, thread use, operator new calls and errors of every generation
+    //   --metrics-format FMT   jsonl, one line per generation, or prometheus for a text file of the totals
+    //   --optimizer NAME       ga, the default, es for a self-adaptive (mu, lambda)-ES, cma for CMA-ES
+    //                          or neat to evolve the topology along with the weights
+    QStringList arguments;
+    QString workerAddress;
+    QString coordinatorAddress;
+    int workerCount = 2;
+    bool spawnWorkers = false;
+    int fineTuneCount = 0;
+    QString metricsPath;
+    MetricsFormat metricsFormat = MetricsFormat::JsonLines;
+    QString optimizer = "ga";
+
+    QStringList allArguments = QCoreApplication::arguments();
+    for (int i = 0; i < allArguments.size(); ++i)
+    {
+        const QString &argument = allArguments[i];
+        bool hasValue = i + 1 < allArguments.size();
+
+        if (argument == "--worker" && hasValue)
+            workerAddress = allArguments[++i];
+        else if (argument == "--coordinator" && hasValue)
+            coordinatorAddress = allArguments[++i];
+        else if (argument == "--workers" && hasValue)
+            workerCount = qMax(1, allArguments[++i].toInt());
+        else if (argument == "--spawn-workers")
+            spawnWorkers = true;
+        else if (argument == "--fine-tune" && hasValue)
+            fineTuneCount = qMax(0, allArguments[++i].toInt());
+        else if (argument == "--metrics" && hasValue)
+            metricsPath = allArguments[++i];
+        else if (argument == "--metrics-format" && hasValue)
+            metricsFormat = allArguments[++i] == "prometheus" ? MetricsFormat::Prometheus : MetricsFormat::JsonLines;
+        else if (argument == "--optimizer" && hasValue)
+            optimizer = allArguments[++i];
+        else
+            arguments << argument;
+    }
 
-            auto *network = networkPool[poolIndex];
-            network->resetError();
+    if (!QStringList({"ga", "es", "cma", "neat"}).contains(optimizer))
+    {
+        qDebug() << "Unknown optimizer:" << optimizer << "expected ga, es, cma or neat";
+        return 1;
+    }
 
-            for (int i = 0; i < dataSetSize; ++i)
-            {
-            auto &inputs = trainingInputs[i];
-            auto &target = trainingOutputs[i];
+    // Everything else, the dataset included, comes from the coordinator
+    if (!workerAddress.isEmpty())
+    {
+        ThreadPool threadPool(QThread::idealThreadCount());
+        DistributedWorker worker;
+        worker.setThreadPool(&threadPool);
 
-            //network->runAndSaveError(inputs, target);
-            network->runMultiOutputAndSaveError(inputs, target);
-            }
-        });
+        if (!worker.connectToCoordinator(workerAddress) || !worker.run())
+        {
+            qDebug() << "Worker failed:" << worker.errorString();
+            return 1;
+        }
 
-        // Sort best to worst
-        sortLeastError(networkPool);
+        return 0;
+    }
 
-        // Tournament Selection
-        // Take best
+    quint64 seed = QDateTime::currentMSecsSinceEpoch();
+    Random::setGlobalSeed(seed);
+    qDebug() << "Seed:" << seed;
 
-        NeuralNetwork *bestNetwork = networkPool.first();
-        float minBreedingPoolError = bestNetwork->error();
+    Dataset trainingData;
 
-        if (minBreedingPoolError < minError)
+    if (arguments.size() > 1)
+    {
+        int outputColumns = arguments.size() > 2 ? arguments[2].toInt() : 1;
+        if (!trainingData.load(arguments[1], qMax(1, outputColumns)))
         {
-            minError = minBreedingPoolError;
-            bestOverallNeuralNetwork.clone(bestNetwork);
+            qDebug() << "Could not load the dataset:" << trainingData.errorString();
+            return 1;
         }
+    }
+    else
+    {
+        trainingData.setData(parityTable, 8, 3, 1);
+    }
+
+    qDebug() << "Samples:" << trainingData.samples() << "Inputs:" << trainingData.inputSize() << "Outputs:" << trainingData.outputSize();
+
+    int poolSize = 10000;
+    int runs = 100;
+    int tournementSize = 10;
+    float mutationRate = 0.5;
+    float mutationMaxChange = 1.0;
+    int checkpointInterval = 10;
+    QString checkpointPath = "checkpoint.gnn";
+    QString bestNetworkPath = "best.gnn";
+
+    QVector<int> layers;
+    layers << 2 << trainingData.outputSize();
+
+    int nInputs = trainingData.inputSize();
+    DatasetView dataset = trainingData.view();
+
+    GenerationSettings settings;
+    settings.poolSize = poolSize;
+    settings.tournamentSize = tournementSize;
+    settings.mutationRate = mutationRate;
+    settings.mutationMaxChange = mutationMaxChange;
+    settings.seed = seed;
+    settings.fineTuneCount = fineTuneCount;
+
+    if (!coordinatorAddress.isEmpty())
+        return runCoordinator(coordinatorAddress, workerCount, spawnWorkers, NetworkTopology(nInputs, layers), settings, dataset, runs, bestNetworkPath);
+
+    if (optimizer == "es" || optimizer == "cma")
+    {
+        EvolutionStrategySettings strategySettings;
+        strategySettings.method = optimizer == "es" ? EvolutionStrategyMethod::MuCommaLambda : EvolutionStrategyMethod::CmaEs;
+        strategySettings.seed = seed;
+
+        return runEvolutionStrategy(NetworkTopology(nInputs, layers), strategySettings, dataset, quint64(runs) * quint64(poolSize), bestNetworkPath);
+    }
+
+    if (optimizer == "neat")
+    {
+        NeatSettings neatSettings;
+        neatSettings.seed = seed;
+
+        return runNeat(nInputs, trainingData.outputSize(), neatSettings, dataset, quint64(runs) * quint64(poolSize));
+    }
+
+    // Both populations are allocated once, each generation breeds from one into the other
+    GenerationEngine engine(NetworkTopology(nInputs, layers), settings);
+    engine.setDataset(dataset);
+
+    // The parity network is small enough for the compile time specialised evaluator
+    if (engine.useFixedNetwork<FixedNetwork<3, 2, 1>>())
+        qDebug() << "Using FixedNetwork<3, 2, 1>";
+
+    // Pick up where a previous run left off
+    Checkpoint checkpoint;
+    if (QFile::exists(checkpointPath))
+    {
+        if (!checkpoint.open(checkpointPath))
+            qDebug() << "Ignoring checkpoint" << checkpoint.errorString();
+        else if (engine.restore(checkpoint))
+            qDebug() << "Resumed generation" << engine.generation() << "of seed" << engine.settings().seed;
+        else
+            qDebug().noquote() << "Ignoring checkpoint" << checkpointPath << "of" << checkpoint.genomeCount() << "genomes of"
+                               << topologyName(checkpoint.topology()) << "for a run of" << engine.poolSize() << "genomes of"
+                               << topologyName(engine.population().topology()) << "- it will be overwritten";
+
+        checkpoint.close();
+    }
+
+    CheckpointWriter checkpointWriter(checkpointPath);
+    engine.setCheckpointWriter(&checkpointWriter, checkpointInterval);
 
-        for (int seed = 0; seed < breedingPool.size(); ++seed)
+    float minError = 999999999;
+    NeuralNetwork &bestOverallNeuralNetwork = *engine.bestNetwork();
+
+    ThreadPool threadPool(QThread::idealThreadCount());
+    engine.setThreadPool(&threadPool);
+
+    MetricsWriter metricsWriter;
+    if (!metricsPath.isEmpty())
+    {
+        if (metricsWriter.open(metricsPath, metricsFormat))
         {
-            breedingPool[seed] = networkPool[seed];
+            AllocationCounter::setEnabled(true);
+            engine.setMetricsEnabled(true);
         }
-
-        // Push the best perceptron back intro the pool if we get worse
-        if (minBreedingPoolError > minError)
+        else
         {
-            breedingPool[breedingPool.size() - 1]->clone(&bestOverallNeuralNetwork);
+            qDebug() << "Not recording metrics:" << metricsWriter.errorString();
         }
+    }
 
+    for (int run = 0; run < runs; ++ run)
+    {
+        // Evaluate, select and breed into the back population, then swap it to the front
+        engine.runGeneration();
 
+        if (engine.metricsEnabled() && !metricsWriter.write(engine.metrics()))
+        {
+            qDebug() << "Stopped recording metrics:" << metricsWriter.errorString();
+            engine.setMetricsEnabled(false);
+            AllocationCounter::setEnabled(false);
+        }
+
+        minError = engine.minError();
+        float minBreedingPoolError = engine.generationMinError();
 
         // Output min error
         qDebug() << "Run:" << run << " Min Error=" << minError << " CurrentBreedingPoolError: " << minBreedingPoolError;
@@ -154,45 +400,35 @@ int main(int argc, char *argv[])
         }
         qDebug() << "\n";
 
-        // Breed
-        int breedingPoolSize = breedingPool.size();
-        shufflePool(breedingPool);
-        for (int brood = 0; brood < offspringPool.size(); ++brood)
-        {
-            auto *selectionA = breedingPool[brood % breedingPoolSize];
-            auto *selectionB = breedingPool[(brood + 1) % breedingPoolSize];
-
-            offspringPool[brood] = selectionA->breed(selectionB, mutationRate, mutationMaxChange);
-        }
-
-        //        // Merge the pools and choose top 50%
-        //        for (int i = 0; i < poolSize; ++i)
-        //            superPool[i] = offspringPool[i];
-        //        for (int i = poolSize; i < (poolSize + (poolSize / 2)); ++i)
-        //            superPool[i] = perceptronPool[i - poolSize];
-
-        //        // Sort the super pool
-        //        sortLeastError(superPool);
-
-        // Take the top
-        for (int i = 0; i < offspringPool.size(); ++i)
-            networkPool[i]->clone(offspringPool[i]);//perceptronPool[i]->clone(superPool[i]);
-
-
-        // Delete the offpsring pool (we cloned them so its ok)
-        qDeleteAll(offspringPool);
-
         if (minError <= 0.0)
             break;
     }
 
     qDebug() << "Best Error" << minError;
 
+    metricsWriter.close();
+
+    QString checkpointError;
+    if (!Checkpoint::writeNetwork(bestNetworkPath, &bestOverallNeuralNetwork, &checkpointError))
+        qDebug() << "Could not save the best network:" << checkpointError;
 
-    for (int i = 0; i < trainingInputs.size(); ++i)
+    // Smaller copies of the best network for serving, and what they cost in accuracy
+    for (QuantizationFormat format : {QuantizationFormat::Int8, QuantizationFormat::Float16})
     {
-        auto &trainingSet = trainingInputs[i];
-        auto &target = trainingOutputs[i];
+        QuantizedNetwork quantized(bestOverallNeuralNetwork.topology(), bestOverallNeuralNetwork.genome(), format);
+        QuantizationReport report = quantized.compare(bestOverallNeuralNetwork.genome(), dataset);
+
+        qDebug() << QuantizedNetwork::name(format) << "bytes:" << report.quantizedBytes << "of" << report.floatBytes
+                 << "error:" << report.quantizedError << "float error:" << report.floatError
+                 << "max output difference:" << report.maxOutputDifference;
+    }
+
+    for (int i = 0; i < qMin(dataset.samples, 8); ++i)
+    {
+        QVector<float> trainingSet(dataset.inputSize);
+        QVector<float> target(dataset.outputSize);
+        std::copy(dataset.inputRow(i), dataset.inputRow(i) + dataset.inputSize, trainingSet.begin());
+        std::copy(dataset.targetRow(i), dataset.targetRow(i) + dataset.outputSize, target.begin());
         qDebug() << "Input =" << trainingSet;
         qDebug() << "Target =" << target;
         qDebug() << "Output =" << bestOverallNeuralNetwork.runMultiOutput(trainingSet);
@@ -207,23 +443,22 @@ int main(int argc, char *argv[])
         qDebug() << "Weights =" << perceptron->weights();
     }
 
-    //    qDeleteAll(offspring);
-    //    offspring.clear();
-
-    qDeleteAll(networkPool);
-    networkPool.clear();
-
+    // One digit per network input, anything else is asked for again
     for (;;)
     {
-        char binaryIn[20];
-        std::cout << "\nEnter a binary number: ";
-        std::cin >> binaryIn;
+        std::string binaryIn;
+        std::cout << "\nEnter a binary number of " << nInputs << " digits: ";
+        if (!(std::cin >> binaryIn))
+            return 0;
 
-        auto charArray = QString(binaryIn);
-        QVector<float> inputs(3);
-        for (auto &input : inputs)
-            input = 0;
+        auto charArray = QString::fromStdString(binaryIn);
+        if (charArray.size() != nInputs)
+        {
+            qDebug() << "Expected" << nInputs << "digits, got" << charArray.size();
+            continue;
+        }
 
+        QVector<float> inputs(nInputs);
         for (int i = 0; i < inputs.size(); ++i)
              inputs[i] = QString(charArray[i]).toFloat();
 
@@ -234,6 +469,5 @@ int main(int argc, char *argv[])
         qDebug() << "Result: " << result;
     }
 
-
     return a.exec();
 }
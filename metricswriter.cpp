@@ -0,0 +1,252 @@
+#include "metricswriter.h"
+#include "allocationcounter.h"
+#include <QSaveFile>
+#include <algorithm>
+#include <iterator>
+
+static QByteArray number(double value)
+{
+    return QByteArray::number(value, 'g', 6);
+}
+
+static double seconds(qint64 nanoseconds)
+{
+    return double(nanoseconds) / 1e9;
+}
+
+MetricsWriter::MetricsWriter()
+{
+}
+
+MetricsWriter::~MetricsWriter()
+{
+    close();
+}
+
+bool MetricsWriter::open(const QString &path, MetricsFormat format)
+{
+    close();
+
+    m_path = path;
+    m_format = format;
+    m_errorString.clear();
+
+    m_generations = 0;
+    std::fill(std::begin(m_phaseNanoseconds), std::end(m_phaseNanoseconds), 0);
+    m_operatorNewCalls = 0;
+    m_operatorNewBytes = 0;
+    m_sampleEvaluations = 0;
+
+    if (format == MetricsFormat::JsonLines)
+    {
+        m_file.setFileName(path);
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return fail(QString("Could not open %1: %2").arg(path).arg(m_file.errorString()));
+    }
+
+    m_sinceWrite.start();
+    return true;
+}
+
+void MetricsWriter::close()
+{
+    if (m_pending)
+        flush();
+
+    if (m_file.isOpen())
+        m_file.close();
+
+    m_path.clear();
+}
+
+bool MetricsWriter::isOpen() const
+{
+    return !m_path.isEmpty();
+}
+
+void MetricsWriter::setPrometheusInterval(int msecs)
+{
+    m_prometheusInterval = qMax(0, msecs);
+}
+
+bool MetricsWriter::write(const GenerationMetrics &metrics)
+{
+    if (!isOpen())
+        return fail("The metrics file is not open");
+
+    if (m_format == MetricsFormat::JsonLines)
+    {
+        QByteArray line = jsonLine(metrics);
+        if (m_file.write(line) != line.size() || !m_file.flush())
+            return fail(QString("Could not write %1: %2").arg(m_path).arg(m_file.errorString()));
+        return true;
+    }
+
+    m_generations++;
+    for (int phase = 0; phase < GenerationMetrics::PhaseCount; ++phase)
+        m_phaseNanoseconds[phase] += metrics.phaseNanoseconds[phase];
+    m_operatorNewCalls += metrics.operatorNewCalls;
+    m_operatorNewBytes += metrics.operatorNewBytes;
+    m_sampleEvaluations += metrics.evaluation.sampleEvaluations;
+    m_last = metrics;
+    m_pending = true;
+
+    if (m_sinceWrite.elapsed() < m_prometheusInterval && m_generations > 1)
+        return true;
+
+    return writePrometheus();
+}
+
+bool MetricsWriter::flush()
+{
+    if (m_format == MetricsFormat::Prometheus && m_pending)
+        return writePrometheus();
+
+    return true;
+}
+
+QString MetricsWriter::errorString() const
+{
+    return m_errorString;
+}
+
+const char *MetricsWriter::name(GenerationPhase phase)
+{
+    switch (phase)
+    {
+    case GenerationPhase::Evaluate:
+        return "evaluate";
+    case GenerationPhase::FineTune:
+        return "fine_tune";
+    case GenerationPhase::Elitism:
+        return "elitism";
+    case GenerationPhase::Select:
+        return "select";
+    case GenerationPhase::Breed:
+        return "breed";
+    case GenerationPhase::Checkpoint:
+        return "checkpoint";
+    }
+
+    return "unknown";
+}
+
+QByteArray MetricsWriter::jsonLine(const GenerationMetrics &metrics) const
+{
+    QByteArray line = "{\"generation\":" + QByteArray::number(metrics.generation)
+                    + ",\"seconds\":" + number(seconds(metrics.nanoseconds))
+                    + ",\"phase_seconds\":{";
+
+    for (int phase = 0; phase < GenerationMetrics::PhaseCount; ++phase)
+    {
+        if (phase > 0)
+            line += ',';
+        line += '"' + QByteArray(name(GenerationPhase(phase))) + "\":" + number(seconds(metrics.phaseNanoseconds[phase]));
+    }
+
+    line += "},\"thread_utilization\":[";
+    for (int i = 0; i < metrics.threadUtilization.size(); ++i)
+    {
+        if (i > 0)
+            line += ',';
+        line += number(metrics.threadUtilization[i]);
+    }
+
+    line += ']';
+
+    // Left out of builds that do not count them rather than reported as zero
+    if (AllocationCounter::isAvailable())
+    {
+        line += ",\"operator_new_calls\":" + QByteArray::number(metrics.operatorNewCalls)
+              + ",\"operator_new_bytes\":" + QByteArray::number(metrics.operatorNewBytes);
+    }
+
+    const EvaluationStatistics &evaluation = metrics.evaluation;
+    line += ",\"min_error\":" + number(metrics.minError)
+          + ",\"mean_error\":" + number(metrics.meanError)
+          + ",\"max_error\":" + number(metrics.maxError)
+          + ",\"error_deviation\":" + number(metrics.errorDeviation)
+          + ",\"best_error\":" + number(metrics.bestError)
+          + ",\"sample_evaluations\":" + QByteArray::number(evaluation.sampleEvaluations)
+          + ",\"skipped_sample_evaluations\":" + QByteArray::number(evaluation.skippedSampleEvaluations)
+          + ",\"aborted_genomes\":" + QByteArray::number(evaluation.abortedGenomes)
+          + ",\"cached_genomes\":" + QByteArray::number(evaluation.cachedGenomes)
+          + ",\"incremental_genomes\":" + QByteArray::number(evaluation.incrementalGenomes)
+          + ",\"rescored_genomes\":" + QByteArray::number(evaluation.rescoredGenomes)
+          + ",\"fine_tuned_genomes\":" + QByteArray::number(evaluation.fineTunedGenomes)
+          + "}\n";
+
+    return line;
+}
+
+QByteArray MetricsWriter::prometheusText() const
+{
+    QByteArray text;
+
+    auto metric = [&](const char *name, const char *type, const char *help)
+    {
+        text += "# HELP " + QByteArray(name) + ' ' + help + "\n# TYPE " + name + ' ' + type + '\n';
+    };
+
+    metric("gnn_generation", "gauge", "Last generation recorded.");
+    text += "gnn_generation " + QByteArray::number(m_last.generation) + '\n';
+
+    metric("gnn_generations_total", "counter", "Generations recorded.");
+    text += "gnn_generations_total " + QByteArray::number(m_generations) + '\n';
+
+    metric("gnn_phase_seconds_total", "counter", "Wall time spent in each phase of a generation.");
+    for (int phase = 0; phase < GenerationMetrics::PhaseCount; ++phase)
+        text += "gnn_phase_seconds_total{phase=\"" + QByteArray(name(GenerationPhase(phase))) + "\"} " + number(seconds(m_phaseNanoseconds[phase])) + '\n';
+
+    metric("gnn_generation_phase_seconds", "gauge", "Wall time of each phase in the last generation.");
+    for (int phase = 0; phase < GenerationMetrics::PhaseCount; ++phase)
+        text += "gnn_generation_phase_seconds{phase=\"" + QByteArray(name(GenerationPhase(phase))) + "\"} " + number(seconds(m_last.phaseNanoseconds[phase])) + '\n';
+
+    metric("gnn_thread_utilization", "gauge", "Share of the last generation each worker thread was busy.");
+    for (int i = 0; i < m_last.threadUtilization.size(); ++i)
+        text += "gnn_thread_utilization{thread=\"" + QByteArray::number(i) + "\"} " + number(m_last.threadUtilization[i]) + '\n';
+
+    if (AllocationCounter::isAvailable())
+    {
+        metric("gnn_operator_new_calls_total", "counter", "Calls to the global operator new during generations, malloc and Qt containers are not counted.");
+        text += "gnn_operator_new_calls_total " + QByteArray::number(m_operatorNewCalls) + '\n';
+
+        metric("gnn_operator_new_bytes_total", "counter", "Bytes asked of the global operator new during generations.");
+        text += "gnn_operator_new_bytes_total " + QByteArray::number(m_operatorNewBytes) + '\n';
+    }
+
+    metric("gnn_sample_evaluations_total", "counter", "Samples run through a genome.");
+    text += "gnn_sample_evaluations_total " + QByteArray::number(m_sampleEvaluations) + '\n';
+
+    metric("gnn_error", "gauge", "Errors of the population the last generation selected from.");
+    text += "gnn_error{statistic=\"min\"} " + number(m_last.minError) + '\n';
+    text += "gnn_error{statistic=\"mean\"} " + number(m_last.meanError) + '\n';
+    text += "gnn_error{statistic=\"max\"} " + number(m_last.maxError) + '\n';
+    text += "gnn_error{statistic=\"deviation\"} " + number(m_last.errorDeviation) + '\n';
+
+    metric("gnn_best_error", "gauge", "Lowest error of the run so far.");
+    text += "gnn_best_error " + number(m_last.bestError) + '\n';
+
+    return text;
+}
+
+bool MetricsWriter::writePrometheus()
+{
+    m_pending = false;
+    m_sinceWrite.start();
+
+    // Scrapers never see a half written file
+    QSaveFile file(m_path);
+    QByteArray text = prometheusText();
+
+    if (!file.open(QIODevice::WriteOnly) || file.write(text) != text.size() || !file.commit())
+        return fail(QString("Could not write %1: %2").arg(m_path).arg(file.errorString()));
+
+    return true;
+}
+
+bool MetricsWriter::fail(const QString &error)
+{
+    m_errorString = error;
+    return false;
+}
@@ -0,0 +1,67 @@
+#ifndef METRICSWRITER_H
+#define METRICSWRITER_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include "generationengine.h"
+
+enum class MetricsFormat
+{
+    // One JSON object per generation, appended as the run goes
+    JsonLines,
+    // The Prometheus text format, the file is replaced with the run's totals and the last
+    // generation's values, eg. for the node exporter's textfile collector
+    Prometheus
+};
+
+// Exports the GenerationMetrics of a run
+class MetricsWriter
+{
+public:
+    MetricsWriter();
+    ~MetricsWriter();
+
+    MetricsWriter(const MetricsWriter &) = delete;
+    MetricsWriter &operator=(const MetricsWriter &) = delete;
+
+    bool open(const QString &path, MetricsFormat format);
+    void close();
+    bool isOpen() const;
+
+    // Prometheus files are rewritten at most once per interval, 1000 ms by default
+    void setPrometheusInterval(int msecs);
+
+    bool write(const GenerationMetrics &metrics);
+    // Writes out a Prometheus file held back by the interval
+    bool flush();
+
+    QString errorString() const;
+
+    static const char *name(GenerationPhase phase);
+
+private:
+    QByteArray jsonLine(const GenerationMetrics &metrics) const;
+    QByteArray prometheusText() const;
+    bool writePrometheus();
+    bool fail(const QString &error);
+
+    QString m_path;
+    MetricsFormat m_format = MetricsFormat::JsonLines;
+    QFile m_file;
+    QString m_errorString;
+
+    int m_prometheusInterval = 1000;
+    QElapsedTimer m_sinceWrite;
+    bool m_pending = false;
+
+    // Run totals for the Prometheus counters
+    int m_generations = 0;
+    qint64 m_phaseNanoseconds[GenerationMetrics::PhaseCount] = {};
+    quint64 m_operatorNewCalls = 0;
+    quint64 m_operatorNewBytes = 0;
+    quint64 m_sampleEvaluations = 0;
+    GenerationMetrics m_last;
+};
+
+#endif // METRICSWRITER_H
@@ -0,0 +1,295 @@
+#include "neatengine.h"
+#include <QtMath>
+#include <algorithm>
+#include <limits>
+
+// Independent random streams derived from the run seed
+enum RandomStream : quint64
+{
+    InitialStream,
+    SpeciesStream,
+    BreedStream
+};
+
+static const int EvaluationChunkSize = 4;
+static const float MinCompatibilityThreshold = 0.3f;
+
+static SparseNetwork &threadNetwork()
+{
+    static thread_local SparseNetwork network;
+    return network;
+}
+
+NeatEngine::NeatEngine(int inputs, int outputs, const NeatSettings &settings)
+    : m_settings(settings),
+      m_inputs(inputs),
+      m_outputs(outputs),
+      m_history(inputs, outputs),
+      m_compatibilityThreshold(settings.compatibilityThreshold),
+      m_minError(std::numeric_limits<float>::max()),
+      m_generationMinError(std::numeric_limits<float>::max()),
+      m_random(settings.seed)
+{
+    Activation outputActivation = settings.sigmoidOutputLayer ? Activation::Sigmoid : Activation::Identity;
+
+    m_population.reserve(settings.populationSize);
+    for (int i = 0; i < settings.populationSize; ++i)
+    {
+        Random random = m_random.split(InitialStream).split(quint64(i));
+        m_population << NeatGenome::minimal(inputs, outputs, outputActivation, settings.connectInitialGenomes,
+                                            m_history, random, settings.mutation.weightRange);
+    }
+
+    m_errors.fill(0.0f, settings.populationSize);
+    m_bestGenome = m_population.first();
+}
+
+const NeatSettings &NeatEngine::settings() const
+{
+    return m_settings;
+}
+
+void NeatEngine::setThreadPool(ThreadPool *threadPool)
+{
+    m_threadPool = threadPool;
+}
+
+void NeatEngine::setDataset(const DatasetView &dataset)
+{
+    m_dataset = dataset;
+}
+
+void NeatEngine::runGeneration()
+{
+    evaluatePopulation();
+
+    int best = int(std::min_element(m_errors.constBegin(), m_errors.constEnd()) - m_errors.constBegin());
+    m_generationMinError = m_errors[best];
+    if (m_generationMinError < m_minError)
+    {
+        m_minError = m_generationMinError;
+        m_bestGenome = m_population[best];
+        m_bestNetwork.compile(m_bestGenome);
+    }
+
+    speciate();
+    allocateOffspring();
+    breed();
+
+    m_generation++;
+}
+
+void NeatEngine::evaluatePopulation()
+{
+    parallelFor(m_population.size(), EvaluationChunkSize, [this](int first, int count)
+    {
+        SparseNetwork &network = threadNetwork();
+        // Mutations keep genomes acyclic, but a network that fails to compile is left empty and
+        // evaluate() on it returns 0, a perfect error, so a failure must never be scored
+        for (int i = first; i < first + count; ++i)
+            m_errors[i] = network.compile(m_population[i]) ? network.evaluate(m_dataset) : std::numeric_limits<float>::max();
+    });
+
+    m_evaluations += quint64(m_population.size());
+}
+
+void NeatEngine::speciate()
+{
+    for (auto &species : m_species)
+        species.members.clear();
+
+    // Genomes join the first species close enough, in index order
+    for (int i = 0; i < m_population.size(); ++i)
+    {
+        bool placed = false;
+        for (auto &species : m_species)
+        {
+            float distance = NeatGenome::distance(species.representative, m_population[i],
+                                                  m_settings.disjointCoefficient, m_settings.weightCoefficient);
+            if (distance < m_compatibilityThreshold)
+            {
+                species.members << i;
+                placed = true;
+                break;
+            }
+        }
+
+        if (!placed)
+        {
+            Species species;
+            species.representative = m_population[i];
+            species.members << i;
+            species.bestError = std::numeric_limits<float>::max();
+            species.improvedGeneration = m_generation;
+            m_species << species;
+        }
+    }
+
+    m_species.erase(std::remove_if(m_species.begin(), m_species.end(), [](const Species &species)
+    {
+        return species.members.isEmpty();
+    }), m_species.end());
+
+    Random speciesRandom = m_random.split(SpeciesStream).split(quint64(m_generation));
+    for (int s = 0; s < m_species.size(); ++s)
+    {
+        Species &species = m_species[s];
+
+        // Next generation is compared with a random member of this one
+        Random random = speciesRandom.split(quint64(s));
+        species.representative = m_population[species.members[random.bounded(species.members.size())]];
+
+        std::sort(species.members.begin(), species.members.end(), [this](int a, int b)
+        {
+            return m_errors[a] < m_errors[b] || (m_errors[a] == m_errors[b] && a < b);
+        });
+
+        float bestError = m_errors[species.members.first()];
+        if (bestError < species.bestError)
+        {
+            species.bestError = bestError;
+            species.improvedGeneration = m_generation;
+        }
+    }
+
+    if (m_settings.targetSpeciesCount > 0)
+    {
+        if (m_species.size() > m_settings.targetSpeciesCount)
+            m_compatibilityThreshold += m_settings.thresholdStep;
+        else if (m_species.size() < m_settings.targetSpeciesCount)
+            m_compatibilityThreshold = qMax(MinCompatibilityThreshold, m_compatibilityThreshold - m_settings.thresholdStep);
+    }
+}
+
+void NeatEngine::allocateOffspring()
+{
+    // Explicit fitness sharing, a species earns the mean fitness of its members
+    double totalFitness = 0;
+    for (auto &species : m_species)
+    {
+        bool stagnant = m_generation - species.improvedGeneration > m_settings.stagnationLimit;
+        bool holdsBest = species.bestError <= m_minError;
+
+        species.fitness = 0;
+        if (!stagnant || holdsBest)
+        {
+            for (int member : species.members)
+                species.fitness += 1.0 / (1.0 + double(m_errors[member]));
+            species.fitness /= species.members.size();
+        }
+
+        totalFitness += species.fitness;
+    }
+
+    // Largest remainder rounding, so the population keeps its size
+    int assigned = 0;
+    QVector<QPair<double, int>> remainders;
+    for (int s = 0; s < m_species.size(); ++s)
+    {
+        double quota = totalFitness > 0 ? m_species[s].fitness / totalFitness * m_population.size() : 0.0;
+        m_species[s].offspring = int(quota);
+        assigned += m_species[s].offspring;
+        remainders << qMakePair(m_species[s].offspring - quota, s);
+    }
+
+    std::sort(remainders.begin(), remainders.end());
+    for (int r = 0; assigned < m_population.size(); r = (r + 1) % remainders.size())
+    {
+        m_species[remainders[r].second].offspring++;
+        assigned++;
+    }
+}
+
+void NeatEngine::breed()
+{
+    m_nextPopulation.clear();
+    m_nextPopulation.reserve(m_population.size());
+
+    Random generationRandom = m_random.split(BreedStream).split(quint64(m_generation));
+
+    for (const auto &species : m_species)
+    {
+        if (species.offspring == 0)
+            continue;
+
+        // The champion goes through unchanged
+        m_nextPopulation << m_population[species.members.first()];
+
+        int parents = qMax(1, qCeil(m_settings.survivalRate * species.members.size()));
+
+        for (int child = 1; child < species.offspring; ++child)
+        {
+            Random random = generationRandom.split(quint64(m_nextPopulation.size()));
+
+            // Members are sorted by error, so the lower position is the fitter parent
+            int first = random.bounded(parents);
+            NeatGenome genome;
+
+            if (parents > 1 && random.uniform() < m_settings.crossoverRate)
+            {
+                int second = random.bounded(parents);
+                genome = NeatGenome::crossover(m_population[species.members[qMin(first, second)]],
+                                               m_population[species.members[qMax(first, second)]], random);
+            }
+            else
+            {
+                genome = m_population[species.members[first]];
+            }
+
+            genome.mutate(m_settings.mutation, m_history, random);
+            m_nextPopulation << genome;
+        }
+    }
+
+    std::swap(m_population, m_nextPopulation);
+}
+
+int NeatEngine::generation() const
+{
+    return m_generation;
+}
+
+quint64 NeatEngine::evaluations() const
+{
+    return m_evaluations;
+}
+
+int NeatEngine::populationSize() const
+{
+    return m_population.size();
+}
+
+const NeatGenome &NeatEngine::genome(int index) const
+{
+    return m_population[index];
+}
+
+int NeatEngine::speciesCount() const
+{
+    return m_species.size();
+}
+
+float NeatEngine::compatibilityThreshold() const
+{
+    return m_compatibilityThreshold;
+}
+
+float NeatEngine::minError() const
+{
+    return m_minError;
+}
+
+float NeatEngine::generationMinError() const
+{
+    return m_generationMinError;
+}
+
+const NeatGenome &NeatEngine::bestGenome() const
+{
+    return m_bestGenome;
+}
+
+SparseNetwork *NeatEngine::bestNetwork()
+{
+    return &m_bestNetwork;
+}
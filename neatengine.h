@@ -0,0 +1,119 @@
+#ifndef NEATENGINE_H
+#define NEATENGINE_H
+
+#include <QVector>
+#include "dataset.h"
+#include "neatgenome.h"
+#include "random.h"
+#include "sparsenetwork.h"
+#include "threadpool.h"
+
+struct NeatSettings
+{
+    int populationSize = 150;
+    NeatMutationSettings mutation;
+    // Chance a child has two parents rather than being a mutated copy of one
+    float crossoverRate = 0.75f;
+    // Start with every input connected to every output, or with no connections at all
+    bool connectInitialGenomes = true;
+    bool sigmoidOutputLayer = true;
+    // Genomes closer than compatibilityThreshold to a species' representative join it. With a
+    // targetSpeciesCount the threshold moves by thresholdStep each generation to approach it.
+    float compatibilityThreshold = 3.0f;
+    float disjointCoefficient = 1.0f;
+    float weightCoefficient = 0.4f;
+    int targetSpeciesCount = 10;
+    float thresholdStep = 0.3f;
+    // Fraction of each species, best first, allowed to breed
+    float survivalRate = 0.2f;
+    // A species whose best error has not improved for this many generations gets no offspring,
+    // unless it holds the best genome of the run
+    int stagnationLimit = 15;
+    // Every random decision of a run is derived from this seed
+    quint64 seed = 0;
+};
+
+// Evolves NeatGenomes, whose nodes and connections grow from a minimal network, with speciation
+// and explicit fitness sharing after Stanley and Miikkulainen. Each genome is compiled to a
+// SparseNetwork and scored on the ThreadPool. Breeding assigns innovation numbers, so it runs
+// on the calling thread in a fixed order and a run is the same on any number of threads.
+class NeatEngine
+{
+public:
+    NeatEngine(int inputs, int outputs, const NeatSettings &settings);
+
+    NeatEngine(const NeatEngine &) = delete;
+    NeatEngine &operator=(const NeatEngine &) = delete;
+
+    const NeatSettings &settings() const;
+
+    void setThreadPool(ThreadPool *threadPool);
+    void setDataset(const DatasetView &dataset);
+
+    // Scores the population, then speciates it and breeds the next one
+    void runGeneration();
+
+    int generation() const;
+    // Genomes scored so far
+    quint64 evaluations() const;
+    int populationSize() const;
+    const NeatGenome &genome(int index) const;
+    int speciesCount() const;
+    float compatibilityThreshold() const;
+
+    float minError() const;
+    float generationMinError() const;
+    const NeatGenome &bestGenome() const;
+    SparseNetwork *bestNetwork();
+
+private:
+    struct Species
+    {
+        NeatGenome representative;
+        QVector<int> members;
+        float bestError = 0;
+        int improvedGeneration = 0;
+        double fitness = 0;
+        int offspring = 0;
+    };
+
+    void evaluatePopulation();
+    void speciate();
+    void allocateOffspring();
+    void breed();
+
+    template<typename Body>
+    void parallelFor(int count, int chunkSize, const Body &body);
+
+    NeatSettings m_settings;
+    int m_inputs;
+    int m_outputs;
+    DatasetView m_dataset;
+    ThreadPool *m_threadPool = nullptr;
+
+    InnovationHistory m_history;
+    QVector<NeatGenome> m_population;
+    QVector<NeatGenome> m_nextPopulation;
+    QVector<float> m_errors;
+    QVector<Species> m_species;
+    float m_compatibilityThreshold;
+
+    int m_generation = 0;
+    quint64 m_evaluations = 0;
+    float m_minError;
+    float m_generationMinError;
+    NeatGenome m_bestGenome;
+    SparseNetwork m_bestNetwork;
+    Random m_random;
+};
+
+template<typename Body>
+void NeatEngine::parallelFor(int count, int chunkSize, const Body &body)
+{
+    if (m_threadPool)
+        m_threadPool->parallelFor(count, chunkSize, body);
+    else
+        body(0, count);
+}
+
+#endif // NEATENGINE_H
@@ -0,0 +1,403 @@
+#include "neatgenome.h"
+#include <QtMath>
+#include <algorithm>
+
+// Tries at picking a node pair before addConnection gives up on a dense genome
+static const int AddConnectionAttempts = 20;
+// Genomes smaller than this are not normalised by their size in distance
+static const int SmallGenomeSize = 20;
+static const float InheritDisabledRate = 0.75f;
+
+InnovationHistory::InnovationHistory(int inputs, int outputs)
+    : m_nextNodeId(inputs + outputs)
+{
+}
+
+int InnovationHistory::connectionInnovation(int from, int to)
+{
+    QPair<int, int> key(from, to);
+    int innovation = m_connections.value(key, -1);
+    if (innovation < 0)
+    {
+        innovation = m_nextInnovation++;
+        m_connections.insert(key, innovation);
+    }
+
+    return innovation;
+}
+
+int InnovationHistory::splitNode(int innovation)
+{
+    int id = m_splits.value(innovation, -1);
+    if (id < 0)
+    {
+        id = m_nextNodeId++;
+        m_splits.insert(innovation, id);
+    }
+
+    return id;
+}
+
+int InnovationHistory::nextNodeId() const
+{
+    return m_nextNodeId;
+}
+
+int InnovationHistory::nextInnovation() const
+{
+    return m_nextInnovation;
+}
+
+NeatGenome::NeatGenome()
+{
+}
+
+NeatGenome NeatGenome::minimal(int inputs, int outputs, Activation outputActivation, bool connected,
+                               InnovationHistory &history, Random &random, float weightRange)
+{
+    NeatGenome genome;
+    genome.m_inputs = inputs;
+    genome.m_outputs = outputs;
+
+    for (int i = 0; i < inputs; ++i)
+    {
+        NodeGene node;
+        node.id = i;
+        node.type = NodeType::Input;
+        node.activation = Activation::Identity;
+        genome.m_nodes << node;
+    }
+
+    for (int o = 0; o < outputs; ++o)
+    {
+        NodeGene node;
+        node.id = inputs + o;
+        node.type = NodeType::Output;
+        node.activation = outputActivation;
+        node.bias = (random.uniform() * 2 - 1) * weightRange;
+        genome.m_nodes << node;
+    }
+
+    if (connected)
+    {
+        for (int o = 0; o < outputs; ++o)
+        {
+            for (int i = 0; i < inputs; ++i)
+            {
+                ConnectionGene connection;
+                connection.innovation = history.connectionInnovation(i, inputs + o);
+                connection.from = i;
+                connection.to = inputs + o;
+                connection.weight = (random.uniform() * 2 - 1) * weightRange;
+                genome.insertConnection(connection);
+            }
+        }
+    }
+
+    return genome;
+}
+
+NeatGenome NeatGenome::fromGenes(int inputs, int outputs, const QVector<NodeGene> &nodes,
+                                 const QVector<ConnectionGene> &connections)
+{
+    NeatGenome genome;
+    genome.m_inputs = inputs;
+    genome.m_outputs = outputs;
+
+    for (const auto &node : nodes)
+        genome.insertNode(node);
+    for (const auto &connection : connections)
+        genome.insertConnection(connection);
+
+    return genome;
+}
+
+int NeatGenome::inputs() const
+{
+    return m_inputs;
+}
+
+int NeatGenome::outputs() const
+{
+    return m_outputs;
+}
+
+const QVector<NodeGene> &NeatGenome::nodes() const
+{
+    return m_nodes;
+}
+
+const QVector<ConnectionGene> &NeatGenome::connections() const
+{
+    return m_connections;
+}
+
+int NeatGenome::hiddenCount() const
+{
+    return m_nodes.size() - m_inputs - m_outputs;
+}
+
+int NeatGenome::enabledConnectionCount() const
+{
+    int count = 0;
+    for (const auto &connection : m_connections)
+        count += connection.enabled ? 1 : 0;
+
+    return count;
+}
+
+int NeatGenome::nodeIndex(int id) const
+{
+    auto it = std::lower_bound(m_nodes.constBegin(), m_nodes.constEnd(), id,
+                               [](const NodeGene &node, int value) { return node.id < value; });
+
+    return it != m_nodes.constEnd() && it->id == id ? int(it - m_nodes.constBegin()) : -1;
+}
+
+void NeatGenome::mutate(const NeatMutationSettings &settings, InnovationHistory &history, Random &random)
+{
+    if (random.uniform() < settings.weightMutationRate)
+        mutateWeights(settings, random);
+
+    if (random.uniform() < settings.addConnectionRate)
+        addConnection(settings, history, random);
+
+    if (random.uniform() < settings.addNodeRate)
+        addNode(settings, history, random);
+
+    if (random.uniform() < settings.toggleConnectionRate)
+        toggleConnection(random);
+}
+
+void NeatGenome::mutateWeights(const NeatMutationSettings &settings, Random &random)
+{
+    auto mutateValue = [&](float &value)
+    {
+        if (random.uniform() < settings.perturbRate)
+            value += float(random.normal()) * settings.weightPerturbation;
+        else
+            value = (random.uniform() * 2 - 1) * settings.weightRange;
+    };
+
+    for (auto &connection : m_connections)
+        mutateValue(connection.weight);
+
+    for (auto &node : m_nodes)
+        if (node.type != NodeType::Input)
+            mutateValue(node.bias);
+}
+
+bool NeatGenome::addConnection(const NeatMutationSettings &settings, InnovationHistory &history, Random &random)
+{
+    // Sources are inputs and hidden nodes, targets hidden nodes and outputs
+    int sources = m_nodes.size() - m_outputs;
+    int targets = m_nodes.size() - m_inputs;
+
+    for (int attempt = 0; attempt < AddConnectionAttempts; ++attempt)
+    {
+        int source = random.bounded(sources);
+        int target = random.bounded(targets);
+
+        // Inputs come first, then outputs, then hidden nodes in nodes()
+        const NodeGene &from = m_nodes[source < m_inputs ? source : source + m_outputs];
+        const NodeGene &to = m_nodes[m_inputs + target];
+
+        if (from.id == to.id)
+            continue;
+
+        auto existing = std::find_if(m_connections.begin(), m_connections.end(), [&](const ConnectionGene &connection)
+        {
+            return connection.from == from.id && connection.to == to.id;
+        });
+
+        if (existing != m_connections.end())
+        {
+            if (existing->enabled)
+                continue;
+
+            existing->enabled = true;
+            return true;
+        }
+
+        // Disabled connections count too, so toggling one back on can never close a cycle
+        if (reaches(to.id, from.id))
+            continue;
+
+        ConnectionGene connection;
+        connection.innovation = history.connectionInnovation(from.id, to.id);
+        connection.from = from.id;
+        connection.to = to.id;
+        connection.weight = (random.uniform() * 2 - 1) * settings.weightRange;
+        insertConnection(connection);
+        return true;
+    }
+
+    return false;
+}
+
+bool NeatGenome::addNode(const NeatMutationSettings &settings, InnovationHistory &history, Random &random)
+{
+    int enabled = enabledConnectionCount();
+    if (enabled == 0)
+        return false;
+
+    int pick = random.bounded(enabled);
+    int index = 0;
+    for (; index < m_connections.size(); ++index)
+        if (m_connections[index].enabled && pick-- == 0)
+            break;
+
+    ConnectionGene split = m_connections[index];
+    int id = history.splitNode(split.innovation);
+
+    // The connection was split before and turned back on since
+    if (nodeIndex(id) >= 0)
+        return false;
+
+    m_connections[index].enabled = false;
+
+    NodeGene node;
+    node.id = id;
+    node.type = NodeType::Hidden;
+    node.activation = settings.hiddenActivation;
+    insertNode(node);
+
+    ConnectionGene incoming;
+    incoming.innovation = history.connectionInnovation(split.from, id);
+    incoming.from = split.from;
+    incoming.to = id;
+    incoming.weight = 1;
+    insertConnection(incoming);
+
+    ConnectionGene outgoing;
+    outgoing.innovation = history.connectionInnovation(id, split.to);
+    outgoing.from = id;
+    outgoing.to = split.to;
+    outgoing.weight = split.weight;
+    insertConnection(outgoing);
+
+    return true;
+}
+
+bool NeatGenome::toggleConnection(Random &random)
+{
+    if (m_connections.isEmpty())
+        return false;
+
+    auto &connection = m_connections[random.bounded(m_connections.size())];
+    connection.enabled = !connection.enabled;
+    return true;
+}
+
+NeatGenome NeatGenome::crossover(const NeatGenome &fitter, const NeatGenome &other, Random &random)
+{
+    // The child has the fitter parent's structure, so it stays free of cycles
+    NeatGenome child = fitter;
+
+    int j = 0;
+    for (auto &connection : child.m_connections)
+    {
+        while (j < other.m_connections.size() && other.m_connections[j].innovation < connection.innovation)
+            ++j;
+
+        if (j == other.m_connections.size() || other.m_connections[j].innovation != connection.innovation)
+            continue;
+
+        const ConnectionGene &match = other.m_connections[j];
+        if (random.coin())
+            connection.weight = match.weight;
+
+        if (!connection.enabled || !match.enabled)
+            connection.enabled = random.uniform() >= InheritDisabledRate;
+    }
+
+    for (auto &node : child.m_nodes)
+    {
+        int index = other.nodeIndex(node.id);
+        if (index >= 0 && node.type != NodeType::Input && random.coin())
+            node.bias = other.m_nodes[index].bias;
+    }
+
+    return child;
+}
+
+float NeatGenome::distance(const NeatGenome &a, const NeatGenome &b, float disjointCoefficient, float weightCoefficient)
+{
+    int i = 0;
+    int j = 0;
+    int unmatched = 0;
+    int matching = 0;
+    float weightDifference = 0;
+
+    while (i < a.m_connections.size() && j < b.m_connections.size())
+    {
+        int innovationA = a.m_connections[i].innovation;
+        int innovationB = b.m_connections[j].innovation;
+
+        if (innovationA == innovationB)
+        {
+            weightDifference += qAbs(a.m_connections[i].weight - b.m_connections[j].weight);
+            matching++;
+            i++;
+            j++;
+        }
+        else
+        {
+            unmatched++;
+            if (innovationA < innovationB)
+                i++;
+            else
+                j++;
+        }
+    }
+
+    // Excess genes weigh the same as disjoint ones
+    unmatched += (a.m_connections.size() - i) + (b.m_connections.size() - j);
+
+    int size = qMax(a.m_connections.size(), b.m_connections.size());
+    float normaliser = size < SmallGenomeSize ? 1.0f : float(size);
+
+    return disjointCoefficient * unmatched / normaliser + weightCoefficient * (matching > 0 ? weightDifference / matching : 0.0f);
+}
+
+bool NeatGenome::reaches(int from, int to) const
+{
+    if (from == to)
+        return true;
+
+    QVector<int> stack;
+    QVector<int> visited;
+    stack << from;
+
+    while (!stack.isEmpty())
+    {
+        int id = stack.takeLast();
+        for (const auto &connection : m_connections)
+        {
+            if (connection.from != id || visited.contains(connection.to))
+                continue;
+
+            if (connection.to == to)
+                return true;
+
+            visited << connection.to;
+            stack << connection.to;
+        }
+    }
+
+    return false;
+}
+
+void NeatGenome::insertNode(const NodeGene &node)
+{
+    auto it = std::lower_bound(m_nodes.begin(), m_nodes.end(), node.id,
+                               [](const NodeGene &existing, int value) { return existing.id < value; });
+    m_nodes.insert(it, node);
+}
+
+void NeatGenome::insertConnection(const ConnectionGene &connection)
+{
+    auto it = std::lower_bound(m_connections.begin(), m_connections.end(), connection.innovation,
+                               [](const ConnectionGene &existing, int value) { return existing.innovation < value; });
+    m_connections.insert(it, connection);
+}
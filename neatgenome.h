@@ -0,0 +1,130 @@
+#ifndef NEATGENOME_H
+#define NEATGENOME_H
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include "activation.h"
+#include "random.h"
+
+enum class NodeType
+{
+    Input,
+    Output,
+    Hidden
+};
+
+// Input nodes only carry a sample value, the others sum their incoming connections and bias
+struct NodeGene
+{
+    int id = 0;
+    NodeType type = NodeType::Hidden;
+    Activation activation = Activation::Sigmoid;
+    float bias = 0;
+};
+
+struct ConnectionGene
+{
+    // Historical marking, the same structural mutation gets the same number in every genome
+    int innovation = 0;
+    int from = 0;
+    int to = 0;
+    float weight = 0;
+    bool enabled = true;
+};
+
+// Hands out innovation numbers and node ids for a whole run, so genomes that grow the same
+// connection or split the same one line up at crossover. Not thread safe, structural
+// mutations are made one genome at a time in a fixed order.
+class InnovationHistory
+{
+public:
+    // Ids 0 .. inputs - 1 are the inputs and inputs .. inputs + outputs - 1 the outputs
+    InnovationHistory(int inputs = 0, int outputs = 0);
+
+    int connectionInnovation(int from, int to);
+    // Id of the node that splits the connection of that innovation
+    int splitNode(int innovation);
+
+    int nextNodeId() const;
+    int nextInnovation() const;
+
+private:
+    QHash<QPair<int, int>, int> m_connections;
+    QHash<int, int> m_splits;
+    int m_nextNodeId;
+    int m_nextInnovation = 0;
+};
+
+struct NeatMutationSettings
+{
+    // Chance a genome has its weights and biases mutated, and then per weight the chance of a
+    // gaussian nudge of weightPerturbation against a fresh value in [-weightRange, weightRange]
+    float weightMutationRate = 0.8f;
+    float perturbRate = 0.9f;
+    float weightPerturbation = 0.5f;
+    float weightRange = 2.0f;
+    // Structural mutations, at most one of each per genome
+    float addConnectionRate = 0.1f;
+    float addNodeRate = 0.05f;
+    float toggleConnectionRate = 0.02f;
+    Activation hiddenActivation = Activation::Sigmoid;
+};
+
+// Node and connection genes of a network whose topology evolves. Nodes are kept sorted by id
+// and connections by innovation, so two genomes align in one merge pass. Connections never
+// close a cycle, compile a SparseNetwork to run one.
+class NeatGenome
+{
+public:
+    NeatGenome();
+
+    // Inputs and outputs only, every input connected to every output when connected is set
+    static NeatGenome minimal(int inputs, int outputs, Activation outputActivation, bool connected,
+                              InnovationHistory &history, Random &random, float weightRange);
+    // A genome from genes kept elsewhere, sorted on the way in. The nodes must include the
+    // inputs and outputs with ids 0 .. inputs + outputs - 1. Nothing checks the connections
+    // for cycles, compiling a SparseNetwork from the genome does.
+    static NeatGenome fromGenes(int inputs, int outputs, const QVector<NodeGene> &nodes,
+                                const QVector<ConnectionGene> &connections);
+
+    int inputs() const;
+    int outputs() const;
+
+    const QVector<NodeGene> &nodes() const;
+    const QVector<ConnectionGene> &connections() const;
+    int hiddenCount() const;
+    int enabledConnectionCount() const;
+
+    // Index into nodes(), or -1
+    int nodeIndex(int id) const;
+
+    void mutate(const NeatMutationSettings &settings, InnovationHistory &history, Random &random);
+    void mutateWeights(const NeatMutationSettings &settings, Random &random);
+    // Connects two unconnected nodes without closing a cycle, returns false when none was found
+    bool addConnection(const NeatMutationSettings &settings, InnovationHistory &history, Random &random);
+    // Splits an enabled connection with a new node, the incoming weight is 1 and the outgoing
+    // one keeps the old weight so the network starts out close to what it was
+    bool addNode(const NeatMutationSettings &settings, InnovationHistory &history, Random &random);
+    bool toggleConnection(Random &random);
+
+    // Matching genes come from either parent, the others from fitter. A gene disabled in
+    // either parent stays disabled three times out of four.
+    static NeatGenome crossover(const NeatGenome &fitter, const NeatGenome &other, Random &random);
+
+    // Stanley's compatibility distance, disjoint and excess genes per gene of the larger genome
+    // plus the mean weight difference of the matching ones
+    static float distance(const NeatGenome &a, const NeatGenome &b, float disjointCoefficient, float weightCoefficient);
+
+private:
+    bool reaches(int from, int to) const;
+    void insertNode(const NodeGene &node);
+    void insertConnection(const ConnectionGene &connection);
+
+    int m_inputs = 0;
+    int m_outputs = 0;
+    QVector<NodeGene> m_nodes;
+    QVector<ConnectionGene> m_connections;
+};
+
+#endif // NEATGENOME_H
@@ -0,0 +1,149 @@
+#include "networktopology.h"
+
+// Genomes are padded to a multiple of 8 floats, so genomes in a population block start a multiple
+// of 32 bytes apart. The block itself is a QVector with no alignment promise, so nothing may
+// rely on a genome starting on a 32 byte boundary of memory.
+static const int GenomeAlignment = 8;
+
+NetworkTopology::NetworkTopology()
+{
+}
+
+NetworkTopology::NetworkTopology(int inputs, const QVector<int> &layers)
+    : m_inputs(inputs),
+      m_layers(layers),
+      m_activations(layers.size(), Activation::Sigmoid)
+{
+    int offset = 0;
+    int layerInputs = inputs;
+
+    for (int i = 0; i < layers.size(); ++i)
+    {
+        m_layerOffsets << offset;
+        m_layerFirstPerceptron << m_perceptronLayer.size();
+
+        for (int j = 0; j < layers[i]; ++j)
+            m_perceptronLayer << i;
+
+        offset += layers[i] * (layerInputs + 1);
+        layerInputs = layers[i];
+        m_maxLayerSize = qMax(m_maxLayerSize, layers[i]);
+    }
+
+    m_genomeSize = offset;
+}
+
+bool NetworkTopology::isValid() const
+{
+    return m_inputs > 0 && !m_layers.isEmpty();
+}
+
+int NetworkTopology::inputs() const
+{
+    return m_inputs;
+}
+
+int NetworkTopology::outputs() const
+{
+    return m_layers.isEmpty() ? 0 : m_layers.last();
+}
+
+const QVector<int> &NetworkTopology::layers() const
+{
+    return m_layers;
+}
+
+int NetworkTopology::layerCount() const
+{
+    return m_layers.size();
+}
+
+int NetworkTopology::layerSize(int layer) const
+{
+    return m_layers[layer];
+}
+
+int NetworkTopology::layerInputs(int layer) const
+{
+    return layer == 0 ? m_inputs : m_layers[layer - 1];
+}
+
+int NetworkTopology::layerOffset(int layer) const
+{
+    return m_layerOffsets[layer];
+}
+
+int NetworkTopology::layerFirstPerceptron(int layer) const
+{
+    return m_layerFirstPerceptron[layer];
+}
+
+int NetworkTopology::maxLayerSize() const
+{
+    return m_maxLayerSize;
+}
+
+Activation NetworkTopology::layerActivation(int layer) const
+{
+    return m_activations[layer];
+}
+
+void NetworkTopology::setLayerActivation(int layer, Activation activation)
+{
+    m_activations[layer] = activation;
+}
+
+void NetworkTopology::setHiddenActivation(Activation activation)
+{
+    for (int i = 0; i < m_activations.size() - 1; ++i)
+        m_activations[i] = activation;
+}
+
+void NetworkTopology::setOutputActivation(Activation activation)
+{
+    if (!m_activations.isEmpty())
+        m_activations.last() = activation;
+}
+
+int NetworkTopology::perceptronCount() const
+{
+    return m_perceptronLayer.size();
+}
+
+int NetworkTopology::perceptronOffset(int perceptron) const
+{
+    int layer = m_perceptronLayer[perceptron];
+    int indexInLayer = perceptron - m_layerFirstPerceptron[layer];
+
+    return m_layerOffsets[layer] + indexInLayer * (layerInputs(layer) + 1);
+}
+
+int NetworkTopology::perceptronInputs(int perceptron) const
+{
+    return layerInputs(m_perceptronLayer[perceptron]);
+}
+
+int NetworkTopology::perceptronLayer(int perceptron) const
+{
+    return m_perceptronLayer[perceptron];
+}
+
+int NetworkTopology::genomeSize() const
+{
+    return m_genomeSize;
+}
+
+int NetworkTopology::paddedGenomeSize() const
+{
+    return ((m_genomeSize + GenomeAlignment - 1) / GenomeAlignment) * GenomeAlignment;
+}
+
+bool NetworkTopology::operator==(const NetworkTopology &other) const
+{
+    return m_inputs == other.m_inputs && m_layers == other.m_layers && m_activations == other.m_activations;
+}
+
+bool NetworkTopology::operator!=(const NetworkTopology &other) const
+{
+    return !(*this == other);
+}
@@ -0,0 +1,55 @@
+#ifndef NETWORKTOPOLOGY_H
+#define NETWORKTOPOLOGY_H
+
+#include <QVector>
+#include "activation.h"
+
+// Describes the layout of a fully connected network inside a flat genome buffer.
+// Each perceptron is stored as [weight 0 .. weight n-1, bias], layer after layer.
+class NetworkTopology
+{
+public:
+    NetworkTopology();
+    NetworkTopology(int inputs, const QVector<int> &layers);
+
+    bool isValid() const;
+
+    int inputs() const;
+    int outputs() const;
+    const QVector<int> &layers() const;
+
+    int layerCount() const;
+    int layerSize(int layer) const;
+    int layerInputs(int layer) const;
+    int layerOffset(int layer) const;
+    int layerFirstPerceptron(int layer) const;
+    int maxLayerSize() const;
+
+    Activation layerActivation(int layer) const;
+    void setLayerActivation(int layer, Activation activation);
+    void setHiddenActivation(Activation activation);
+    void setOutputActivation(Activation activation);
+
+    int perceptronCount() const;
+    int perceptronOffset(int perceptron) const;
+    int perceptronInputs(int perceptron) const;
+    int perceptronLayer(int perceptron) const;
+
+    int genomeSize() const;
+    int paddedGenomeSize() const;
+
+    bool operator==(const NetworkTopology &other) const;
+    bool operator!=(const NetworkTopology &other) const;
+
+private:
+    int m_inputs = 0;
+    QVector<int> m_layers;
+    QVector<Activation> m_activations;
+    QVector<int> m_layerOffsets;
+    QVector<int> m_layerFirstPerceptron;
+    QVector<int> m_perceptronLayer;
+    int m_genomeSize = 0;
+    int m_maxLayerSize = 0;
+};
+
+#endif // NETWORKTOPOLOGY_H
@@ -1,7 +1,10 @@
 #include "neuralnetwork.h"
+#include "evaluator.h"
+#include "forwardpass.h"
 #include <QDateTime>
 #include <QDebug>
 #include <QtMath>
+#include <cstring>
 
 NeuralNetwork::NeuralNetwork(QObject *parent) : QObject(parent)
 {
@@ -10,141 +13,221 @@ NeuralNetwork::NeuralNetwork(QObject *parent) : QObject(parent)
 
 NeuralNetwork::~NeuralNetwork()
 {
-    qDeleteAll(m_perceptrons);
     m_perceptrons.clear();
 }
 
-Perceptron *NeuralNetwork::createPerceptron()
+void NeuralNetwork::initialiseNetwork(int inputs, QVector<int> layers, bool sigmoidOutputLayer)
 {
-    Perceptron *perceptron = new Perceptron();
-    m_perceptrons << perceptron;
-    return perceptron;
+    NetworkTopology topology(inputs, layers);
+
+    // Disable sigmoid activation for Output perceptron layer so it can be used for regression problems
+    if (!sigmoidOutputLayer)
+        topology.setOutputActivation(Activation::Identity);
+
+    initialiseNetwork(topology);
 }
 
-void NeuralNetwork::initialiseNetwork(int inputs, QVector<int> layers, bool sigmoidOutputLayer)
+void NeuralNetwork::initialiseNetwork(const NetworkTopology &topology)
 {
-    m_inputs = inputs;
-    m_layers = layers;
-
-    for (int i = 0; i < layers.size(); ++i)
+    // A view keeps pointing at its population block, only standalone networks reallocate
+    if (!isView() || topology != m_topology)
     {
-        for (int j = 0; j < layers[i]; ++j)
-        {
-            auto *perceptron = createPerceptron();
-
-            m_networkMap.insertMulti(i, perceptron);
-
-            if (i == 0)
-            {
-                perceptron->initialiseWeights(m_inputs, 1000.0);
-                continue;
-            }
-
-            auto parents = m_networkMap.values(i - 1);
-            perceptron->initialiseWeights(parents.size(), 1000.0);
-            perceptron->setNetworkParents(parents.toVector());
-
-            // Disable sigmoid activation for Output perceptron layer so it can be used for regression problems
-            if (i == layers.size() - 1 && !sigmoidOutputLayer)
-            {
-                perceptron->setSigmoidActivationEnabled(false);
-                // perceptron->setRoundOutput(true);
-            }
-        }
+        Q_ASSERT(!isView());
+        m_ownedGenome = QVector<float>(topology.genomeSize());
+        m_genome = m_ownedGenome.data();
     }
+
+    m_topology = topology;
+
+    buildPerceptrons();
+    randomiseWeights(1000);
 }
 
-QVector<Perceptron *> NeuralNetwork::perceptrons()
+void NeuralNetwork::attachGenome(float *genome, const NetworkTopology &topology)
 {
-    return m_perceptrons;
+    m_ownedGenome.clear();
+    m_genome = genome;
+    m_topology = topology;
+
+    buildPerceptrons();
 }
 
-float NeuralNetwork::run(QVector<float> inputs)
+void NeuralNetwork::randomiseWeights(int limit, Random &random)
 {
-    return m_perceptrons.last()->networkRun(inputs);
+    for (auto &perceptron : m_perceptrons)
+        perceptron.initialiseWeights(perceptron.inputCount(), limit, random);
 }
 
-QVector<float> NeuralNetwork::runMultiOutput(QVector<float> inputs)
+void NeuralNetwork::buildPerceptrons()
 {
-    int outputLayerIndex = m_layers.size() - 1;
-    auto outputLayer = m_networkMap.values(outputLayerIndex);
+    m_perceptrons = QVector<Perceptron>(m_topology.perceptronCount());
 
-    QVector<float> outputs;
-    for (auto *perceptron : outputLayer)
+    for (int i = 0; i < m_perceptrons.size(); ++i)
     {
-        float result = perceptron->networkRun(inputs);
-        outputs << result;
+        auto &perceptron = m_perceptrons[i];
+        perceptron.attach(m_genome + m_topology.perceptronOffset(i), m_topology.perceptronInputs(i));
+        perceptron.setActivation(m_topology.layerActivation(m_topology.perceptronLayer(i)));
     }
+}
+
+QVector<Perceptron *> NeuralNetwork::perceptrons()
+{
+    QVector<Perceptron*> perceptrons;
+    for (auto &perceptron : m_perceptrons)
+        perceptrons << &perceptron;
+
+    return perceptrons;
+}
+
+const NetworkTopology &NeuralNetwork::topology() const
+{
+    return m_topology;
+}
+
+bool NeuralNetwork::sigmoidOutputLayer() const
+{
+    return m_topology.layerActivation(m_topology.layerCount() - 1) != Activation::Identity;
+}
+
+void NeuralNetwork::setLayerActivation(int layer, Activation activation)
+{
+    m_topology.setLayerActivation(layer, activation);
+
+    int first = m_topology.layerFirstPerceptron(layer);
+    for (int i = 0; i < m_topology.layerSize(layer); ++i)
+        m_perceptrons[first + i].setActivation(activation);
+}
+
+bool NeuralNetwork::isView() const
+{
+    return m_genome && m_ownedGenome.isEmpty();
+}
+
+float *NeuralNetwork::genome()
+{
+    return m_genome;
+}
+
+const float *NeuralNetwork::genome() const
+{
+    return m_genome;
+}
+
+const float *NeuralNetwork::forwardPass(const QVector<float> &inputs) const
+{
+    Q_ASSERT(inputs.size() == m_topology.inputs());
+
+    // Scratch buffers are per thread so views over one population can run concurrently
+    static thread_local ForwardPass forwardPass;
+    return forwardPass.run(m_topology, m_genome, inputs.constData());
+}
+
+float NeuralNetwork::run(const QVector<float> &inputs) const
+{
+    return forwardPass(inputs)[m_topology.outputs() - 1];
+}
+
+QVector<float> NeuralNetwork::runMultiOutput(const QVector<float> &inputs) const
+{
+    const float *results = forwardPass(inputs);
+
+    QVector<float> outputs(m_topology.outputs());
+    std::copy(results, results + outputs.size(), outputs.begin());
 
     return outputs;
 }
 
-void NeuralNetwork::runAndSaveError(QVector<float> inputs, float target, int divider)
+void NeuralNetwork::runBatch(const float *inputs, int samples, float *outputs, int inputStride, int outputStride) const
 {
-    m_error += qPow(run(inputs) - target, 2) / float(divider);
+    DatasetView batch;
+    batch.inputs = inputs;
+    batch.samples = samples;
+    batch.inputSize = m_topology.inputs();
+    batch.inputStride = inputStride;
 
-    // float newError = qPow(m_perceptrons.last()->networkRun(inputs) - target, 2);
+    runBatch(batch, outputs, outputStride);
+}
 
-    // setError(newError);
+void NeuralNetwork::runBatch(const DatasetView &batch, float *outputs, int outputStride) const
+{
+    // The batched kernel of the evolution, with per thread scratch blocks
+    static thread_local Evaluator evaluator;
+    evaluator.predict(m_topology, m_genome, batch, outputs, outputStride ? outputStride : m_topology.outputs());
+}
 
+void NeuralNetwork::runAndSaveError(QVector<float> inputs, float target, int divider)
+{
+    setError(qPow(run(inputs) - target, 2) / float(divider));
 }
 
 void NeuralNetwork::runMultiOutputAndSaveError(QVector<float> inputs, QVector<float> targets, int divider)
 {
-    auto outputs = runMultiOutput(inputs);
+    const float *outputs = forwardPass(inputs);
 
-    for (int i = 0; i < outputs.size(); ++i)
+    // Accumulate locally and publish once
+    float error = 0;
+    for (int i = 0; i < m_topology.outputs(); ++i)
     {
         auto output = outputs[i];
         auto target = targets[i];
 
-        m_error += qPow(output - target, 2) / float(divider);
+        error += qPow(output - target, 2) / float(divider);
     }
+
+    setError(error);
 }
 
 float NeuralNetwork::error()
 {
-    std::shared_lock<std::shared_mutex> lock(m_errorMutex);
-    return m_error;
+    return m_error.load(std::memory_order_relaxed);
 }
 
 void NeuralNetwork::setError(float error)
 {
-    std::unique_lock<std::shared_mutex> lock(m_errorMutex);
-    m_error += error;
+    // Adds to the error, there is no atomic fetch_add for float before C++20
+    float current = m_error.load(std::memory_order_relaxed);
+    while (!m_error.compare_exchange_weak(current, current + error, std::memory_order_relaxed))
+    {
+    }
 }
 
 void NeuralNetwork::resetError()
 {
-    std::unique_lock<std::shared_mutex> lock(m_errorMutex);
-    m_error = 0.0;
+    m_error.store(0.0, std::memory_order_relaxed);
 }
 
-void NeuralNetwork::clone(NeuralNetwork *other)
+bool NeuralNetwork::clone(NeuralNetwork *other)
 {
-    m_error = other->error();
-
-    qDeleteAll(m_perceptrons);
-    m_perceptrons.clear();
-    m_networkMap.clear();
-
-    initialiseNetwork(other->m_inputs, other->m_layers);
-
-    if (m_perceptrons.size() != other->m_perceptrons.size())
-        Q_ASSERT(false);
-
-    for (int i = 0; i < m_perceptrons.size(); ++i)
+    if (m_topology != other->m_topology)
     {
-        m_perceptrons[i]->clone(other->m_perceptrons[i]);
+        if (isView())
+        {
+            // Only the activations may differ for a view, the genome layout is fixed by the population
+            // and a larger genome would run into the next one
+            if (m_topology.genomeSize() != other->m_topology.genomeSize())
+                return false;
+
+            attachGenome(m_genome, other->m_topology);
+        }
+        else
+        {
+            m_ownedGenome = QVector<float>(other->m_topology.genomeSize());
+            m_genome = m_ownedGenome.data();
+            m_topology = other->m_topology;
+            buildPerceptrons();
+        }
     }
-}
 
+    m_error.store(other->error(), std::memory_order_relaxed);
+    std::memcpy(m_genome, other->m_genome, sizeof(float) * size_t(m_topology.genomeSize()));
+    return true;
+}
 
-NeuralNetwork *NeuralNetwork::breed(NeuralNetwork *mate, float mutationRate, float amount)
+NeuralNetwork *NeuralNetwork::breed(NeuralNetwork *mate, float mutationRate, float amount, Random &random)
 {
     NeuralNetwork *child = new NeuralNetwork();
 
-    child->initialiseNetwork(m_inputs, m_layers);
+    child->initialiseNetwork(m_topology);
 
     // for (int i = 0; i < m_perceptrons.size(); ++i)
     //  {
@@ -154,40 +237,46 @@ NeuralNetwork *NeuralNetwork::breed(NeuralNetwork *mate, float mutationRate, flo
 
     // }
 
-    crossOverBreed(child, this, mate, mutationRate, amount);
+    crossOverBreed(child, this, mate, mutationRate, amount, random);
 
     return child;
 }
 
-void NeuralNetwork::crossOverBreed(NeuralNetwork *child, NeuralNetwork *mateA, NeuralNetwork *mateB, float mutationRate, float amount)
+void NeuralNetwork::crossOverBreed(NeuralNetwork *child, NeuralNetwork *mateA, NeuralNetwork *mateB, float mutationRate, float amount, Random &random)
 {
-    int crossoverPoint = qrand() % mateA->m_perceptrons.size();
+    const auto &topology = mateA->m_topology;
+    int crossoverPoint = random.bounded(topology.perceptronCount());
 
-    for (int i = 0; i < mateA->m_perceptrons.size(); ++i)
-        child->m_perceptrons[i]->clone(i < crossoverPoint ? mateA->m_perceptrons[i] : mateB->m_perceptrons[i]);
+    // Perceptrons are contiguous in the genome so the crossover is two block copies
+    size_t splitOffset = crossoverPoint == 0 ? 0 : size_t(topology.perceptronOffset(crossoverPoint));
+    size_t genomeSize = size_t(topology.genomeSize());
 
+    std::memcpy(child->m_genome, mateA->m_genome, sizeof(float) * splitOffset);
+    std::memcpy(child->m_genome + splitOffset, mateB->m_genome + splitOffset, sizeof(float) * (genomeSize - splitOffset));
 
-    for (int i = 0; i < mateA->m_perceptrons.size(); ++i)
-        if (!(qrand() % int((1.0 / mutationRate) + 0.5)))
+    for (int i = 0; i < topology.perceptronCount(); ++i)
+        if (!random.bounded(int((1.0 / mutationRate) + 0.5)))
         {
-            auto *randomPerceptron = child->m_perceptrons[qrand() % child->m_perceptrons.size()];
-            randomPerceptron->mutate(amount);
+            auto &randomPerceptron = child->m_perceptrons[random.bounded(child->m_perceptrons.size())];
+            randomPerceptron.mutate(amount, random);
         }
 }
 
 QByteArray NeuralNetwork::drawNetwork()
 {
     QByteArray output;
-    for (auto level : m_networkMap.keys())
+    for (int level = 0; level < m_topology.layerCount(); ++level)
     {
         output += "Level " + QString::number(level + 1) + "\n";
         int perceptronCount = 1;
-        for (auto *perceptron : m_networkMap.values(level))
+        int first = m_topology.layerFirstPerceptron(level);
+        for (int i = 0; i < m_topology.layerSize(level); ++i)
         {
+            const auto &perceptron = m_perceptrons[first + i];
             output += "Perceptron" + QString::number(perceptronCount) + "\n";
-            output += "Bias =" + QString::number(perceptron->bias()) + "\n";
+            output += "Bias =" + QString::number(perceptron.bias()) + "\n";
             output += "Weights = ";
-            for (auto weight : perceptron->weights())
+            for (auto weight : perceptron.weights())
                 output += QString::number(weight) + ", ";
 
             output += "\n";
@@ -201,27 +290,99 @@ QByteArray NeuralNetwork::drawNetwork()
 }
 
 
-Perceptron::Perceptron(QObject *parent) : QObject(parent)
+Perceptron::Perceptron()
 {
     reset();
-    m_sigmoidActivationEnabled = true;
+    m_activation = Activation::Sigmoid;
+}
+
+Perceptron::Perceptron(float *genes, int nInputs)
+{
+    attach(genes, nInputs);
+}
+
+Perceptron::Perceptron(const Perceptron &other)
+{
+    *this = other;
+}
+
+Perceptron &Perceptron::operator=(const Perceptron &other)
+{
+    if (this == &other)
+        return *this;
+
+    // Views share the other's storage, owners take a deep copy
+    m_ownedGenes = other.m_ownedGenes;
+    m_genes = other.isView() || !other.m_genes ? other.m_genes : m_ownedGenes.data();
+    m_inputs = other.m_inputs;
+    m_error = other.m_error;
+    m_activation = other.m_activation;
+    m_roundOutput = other.m_roundOutput;
+
+    return *this;
+}
+
+void Perceptron::attach(float *genes, int nInputs)
+{
+    m_ownedGenes.clear();
+    m_genes = genes;
+    m_inputs = nInputs;
+}
+
+bool Perceptron::isView() const
+{
+    return m_genes && m_ownedGenes.isEmpty();
+}
+
+int Perceptron::inputCount() const
+{
+    return m_inputs;
+}
+
+float *Perceptron::genes()
+{
+    return m_genes;
+}
+
+void Perceptron::allocateGenes(int nInputs)
+{
+    if (isView())
+    {
+        Q_ASSERT(nInputs == m_inputs);
+        return;
+    }
+
+    float bias = m_genes ? m_genes[m_inputs] : 0.0;
+
+    m_ownedGenes.resize(nInputs + 1);
+    m_genes = m_ownedGenes.data();
+    m_genes[nInputs] = bias;
+    m_inputs = nInputs;
 }
 
-void Perceptron::initialiseWeights(int nInputs, int limit)
+void Perceptron::initialiseWeights(int nInputs, int limit, Random &random)
 {
-    m_weights = QVector<float>(nInputs);
-    m_bias = 1.0;
-    for (auto &weight : m_weights)
-        weight = 1.0;
+    allocateGenes(nInputs);
 
-    for (int i = 0; i < m_weights.size() + 1; ++i)
-        mutate(limit);
+    // The bias is stored directly after the weights so it is initialised with them
+    for (int i = 0; i < m_inputs + 1; ++i)
+        m_genes[i] = 1.0;
+
+    for (int i = 0; i < m_inputs + 1; ++i)
+        mutate(limit, random);
 }
 
 void Perceptron::reset()
 {
-    m_weights.clear();
-    m_bias = 0.0;
+    if (isView())
+    {
+        std::fill(m_genes, m_genes + m_inputs + 1, 0.0f);
+        return;
+    }
+
+    m_ownedGenes.clear();
+    m_genes = nullptr;
+    m_inputs = 0;
 }
 
 void Perceptron::fit(QVector<QVector<float> > inputs, QVector<float> outputs)
@@ -236,13 +397,13 @@ void Perceptron::fit(QVector<QVector<float> > inputs, QVector<float> outputs)
     {
         int errors = 0;
 
-        int j = qrand() % inputs.size();
+        int j = Random::threadLocal().bounded(inputs.size());
 
         float update = trainingRate * (outputs[j] - run(inputs[j]));
-        m_bias = update;
-        for (int w = 0; w < m_weights.size(); ++w)
+        m_genes[m_inputs] += update;
+        for (int w = 0; w < m_inputs; ++w)
         {
-            m_weights[w] += update * inputs[j][w];
+            m_genes[w] += update * inputs[j][w];
         }
 
         // errors += update != 0 ? 1 : 0;
@@ -261,11 +422,11 @@ float Perceptron::liveFit(float actual, float output, QVector<float> inputs)
 {
     float trainingRate = 0.1;
     float update = trainingRate * (actual - output);
-    m_bias = update;
+    m_genes[m_inputs] += update;
 
-    for (int w = 0; w < m_weights.size(); ++w)
+    for (int w = 0; w < m_inputs; ++w)
     {
-        m_weights[w] += update * inputs[w];
+        m_genes[w] += update * inputs[w];
     }
 
     return update;
@@ -273,27 +434,23 @@ float Perceptron::liveFit(float actual, float output, QVector<float> inputs)
 
 
 
-float Perceptron::run(QVector<float> inputs)
+float Perceptron::run(const QVector<float> &inputs)
 {
-    if (inputs.size() != m_weights.size())
+    if (inputs.size() != m_inputs)
     {
         Q_ASSERT(false);
         return 0;
     }
 
-    float total = m_bias;
+    float total = bias();
 
     for (int i = 0; i < inputs.size(); ++i)
     {
-        total += inputs[i] * m_weights[i];
+        total += inputs[i] * m_genes[i];
     }
 
-    float resultSigmoided = sigmoid(total);
-
-    float finalResult = total;
+    float finalResult = ActivationKernels::apply(m_activation, total);
 
-    if (m_sigmoidActivationEnabled)
-        finalResult = resultSigmoided;
     if (m_roundOutput)
         finalResult = int(finalResult + 0.5);
 
@@ -302,7 +459,8 @@ float Perceptron::run(QVector<float> inputs)
 
 void Perceptron::setWeights(const QVector<float> &weights)
 {
-    m_weights = weights;
+    allocateGenes(weights.size());
+    std::copy(weights.constBegin(), weights.constEnd(), m_genes);
 }
 
 float Perceptron::error()
@@ -310,28 +468,28 @@ float Perceptron::error()
     return m_error;
 }
 
-Perceptron* Perceptron::breed(Perceptron *mate, float mutationRate, float amount)
+Perceptron* Perceptron::breed(Perceptron *mate, float mutationRate, float amount, Random &random)
 {
-    auto mineOrTheirs = []()->bool { return qrand() % 2;};
+    auto mineOrTheirs = [&]()->bool { return random.coin();};
 
     auto *child = new Perceptron();
-    child->initialiseWeights(m_weights.size());
+    child->initialiseWeights(m_inputs, 100, random);
 
-    int crossoverPoint = qrand() % m_weights.size();
+    int crossoverPoint = random.bounded(m_inputs);
 
-    for (int i = 0; i < m_weights.size(); ++i)
+    for (int i = 0; i < m_inputs; ++i)
     {
-        const auto &myWeight = m_weights[i];
-        const auto &theirWeight = mate->m_weights[i];
+        const auto &myWeight = m_genes[i];
+        const auto &theirWeight = mate->m_genes[i];
 
-        child->m_weights[i] = i < crossoverPoint ? myWeight : theirWeight;
+        child->m_genes[i] = i < crossoverPoint ? myWeight : theirWeight;
     }
 
-    mineOrTheirs() ? child->m_bias = m_bias : mate->m_bias;
+    child->m_genes[m_inputs] = mineOrTheirs() ? m_genes[m_inputs] : mate->m_genes[m_inputs];
 
-    if (!(qrand() % int((1.0 / mutationRate) + 0.5)))
+    if (!random.bounded(int((1.0 / mutationRate) + 0.5)))
     {
-        child->mutate(amount);
+        child->mutate(amount, random);
     }
 
     return child;
@@ -344,22 +502,20 @@ float Perceptron::sigmoid(float x)
 
 void Perceptron::clone(Perceptron *other)
 {
-    m_bias = other->m_bias;
-    m_weights = QVector<float>(other->m_weights);
+    allocateGenes(other->m_inputs);
+    std::copy(other->m_genes, other->m_genes + other->m_inputs + 1, m_genes);
     m_error = other->m_error;
 }
 
 bool Perceptron::operator==(const Perceptron &other)
 {
-    if (m_weights.size() != other.m_weights.size())
+    if (m_inputs != other.m_inputs)
         return false;
 
-    if (m_bias != other.m_bias)
-        return false;
-
-    for (int i = 0; i < m_weights.size(); ++i)
+    // Compares the bias too, it is the last gene
+    for (int i = 0; i < m_inputs + 1; ++i)
     {
-        if (m_weights[i] != other.m_weights[i])
+        if (m_genes[i] != other.m_genes[i])
             return false;
     }
 
@@ -368,12 +524,22 @@ bool Perceptron::operator==(const Perceptron &other)
 
 bool Perceptron::sigmoidActivationEnabled()
 {
-    return m_sigmoidActivationEnabled;
+    return m_activation == Activation::Sigmoid;
 }
 
 void Perceptron::setSigmoidActivationEnabled(bool enabled)
 {
-    m_sigmoidActivationEnabled = enabled;
+    m_activation = enabled ? Activation::Sigmoid : Activation::Identity;
+}
+
+Activation Perceptron::activation() const
+{
+    return m_activation;
+}
+
+void Perceptron::setActivation(Activation activation)
+{
+    m_activation = activation;
 }
 
 bool Perceptron::roundOutput()
@@ -388,28 +554,28 @@ void Perceptron::setRoundOutput(bool enabled)
 
 float Perceptron::bias() const
 {
-    return m_bias;
+    return m_genes ? m_genes[m_inputs] : 0.0;
 }
 
 QVector<float> Perceptron::weights() const
 {
-    return m_weights;
+    QVector<float> weights(m_inputs);
+    std::copy(m_genes, m_genes + m_inputs, weights.begin());
+    return weights;
 }
 
-void Perceptron::mutate(float max)
+void Perceptron::mutate(float max, Random &random)
 {
-    float randomFloat = static_cast<float>(qrand()) / static_cast<float>(RAND_MAX);
+    float randomFloat = random.uniform();
     float mutationFactor = randomFloat * max;
 
-    if (qrand() % 2)
+    if (random.coin())
         mutationFactor *= -1.0;
 
-    int indexToMutate = qrand() % (m_weights.size() + 1);
+    // Index m_inputs is the bias
+    int indexToMutate = random.bounded(m_inputs + 1);
 
-    if (indexToMutate == m_weights.size())
-        m_bias *= mutationFactor;
-    else
-        m_weights[indexToMutate] *= mutationFactor;
+    m_genes[indexToMutate] *= mutationFactor;
 }
 
 void Perceptron::runAndSaveError(QVector<float> inputs, float target, int divider)
@@ -424,39 +590,3 @@ void Perceptron::resetError()
 {
     m_error = 0;
 }
-
-void Perceptron::setNetworkParent(Perceptron *parent)
-{
-    m_networkParent = parent;
-}
-
-void Perceptron::setNetworkParents(QVector<Perceptron *> parents)
-{
-    m_networkParents = parents;
-}
-
-QVector<Perceptron *> Perceptron::networkParents()
-{
-    return m_networkParents;
-}
-
-Perceptron *Perceptron::networkParent()
-{
-    return m_networkParent;
-}
-
-float Perceptron::networkRun(QVector<float> inputs)
-{
-    if (m_networkParents.isEmpty())
-        return run(inputs);
-
-    QVector<float> parentsOutputs;
-
-    for (auto *parent : m_networkParents)
-        parentsOutputs << parent->networkRun(inputs);
-
-    return run(parentsOutputs);
-}
-
-
-
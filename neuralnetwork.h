@@ -1,31 +1,42 @@
 #ifndef NEUTALNETWORK_H
 #define NEUTALNETWORK_H
 
-#include <QMap>
 #include <QObject>
-#include <mutex>
-#include <shared_mutex>
-
-class Perceptron : public QObject
+#include <QVector>
+#include <atomic>
+#include "dataset.h"
+#include "networktopology.h"
+#include "random.h"
+
+// A Perceptron is a view over [weights..., bias] in a genome buffer. A standalone
+// Perceptron owns its own buffer, a network Perceptron points into its NeuralNetwork's genome.
+class Perceptron
 {
-    Q_OBJECT
 public:
-    explicit Perceptron(QObject *parent = nullptr);
+    Perceptron();
+    Perceptron(float *genes, int nInputs);
+    Perceptron(const Perceptron &other);
+    Perceptron &operator=(const Perceptron &other);
+
+    void attach(float *genes, int nInputs);
+    bool isView() const;
+    int inputCount() const;
+    float *genes();
 
-    void initialiseWeights(int nInputs, int limit = 100);
+    void initialiseWeights(int nInputs, int limit = 100, Random &random = Random::threadLocal());
     void reset();
 
     void fit(QVector<QVector<float>> inputs, QVector<float> outputs);
 
     float liveFit(float actual, float output, QVector<float> inputs);
 
-    float run(QVector<float> inputs);
+    float run(const QVector<float> &inputs);
 
     void setWeights(const QVector<float> &weights);
 
     float error();
 
-    Perceptron *breed(Perceptron *mate, float mutationRate = 0.1, float amount = 1.0);
+    Perceptron *breed(Perceptron *mate, float mutationRate = 0.1, float amount = 1.0, Random &random = Random::threadLocal());
 
     float sigmoid(float x);
 
@@ -35,36 +46,28 @@ public:
     bool operator==(const Perceptron &other);
     bool sigmoidActivationEnabled();
     void setSigmoidActivationEnabled(bool enabled);
+    Activation activation() const;
+    void setActivation(Activation activation);
     bool roundOutput();
     void setRoundOutput(bool enabled);
 
     float bias() const;
     QVector<float> weights() const;
 
-    void mutate(float max);
+    void mutate(float max, Random &random = Random::threadLocal());
 
     void runAndSaveError(QVector<float> inputs, float target, int divider = 1);
 
     void resetError();
 
-    void setNetworkParent(Perceptron *parent);
-    void setNetworkParents(QVector<Perceptron*> parents);
-
-    QVector<Perceptron*> networkParents();
-
-    Perceptron *networkParent();
-
-    float networkRun(QVector<float> inputs);
-
-
 private:
-    QVector<float> m_weights;
-    QVector<float> m_exponents;
-    float m_bias;
+    void allocateGenes(int nInputs);
+
+    QVector<float> m_ownedGenes;
+    float *m_genes = nullptr;
+    int m_inputs = 0;
     float m_error = 0;
-    Perceptron *m_networkParent;
-    QVector<Perceptron*> m_networkParents;
-    bool m_sigmoidActivationEnabled = true;
+    Activation m_activation = Activation::Sigmoid;
     bool m_roundOutput = false;
 };
 
@@ -76,14 +79,31 @@ class NeuralNetwork : public QObject
 public:
     explicit NeuralNetwork(QObject *parent = nullptr);
     ~NeuralNetwork();
-    Perceptron *createPerceptron();
     void initialiseNetwork(int inputs, QVector<int> layers, bool sigmoidOutputLayer = true);
+    void initialiseNetwork(const NetworkTopology &topology);
+    void attachGenome(float *genome, const NetworkTopology &topology);
+    void randomiseWeights(int limit = 1000, Random &random = Random::threadLocal());
 
     QVector<Perceptron*> perceptrons();
+    const NetworkTopology &topology() const;
+    bool sigmoidOutputLayer() const;
+    void setLayerActivation(int layer, Activation activation);
+    bool isView() const;
+
+    float *genome();
+    const float *genome() const;
+
 
+    float run(const QVector<float> &inputs) const;
+    QVector<float> runMultiOutput(const QVector<float> &inputs) const;
 
-    float run(QVector<float> inputs);
-    QVector<float> runMultiOutput(QVector<float> inputs);
+    // Runs samples rows of inputs, inputStride floats apart, and writes the outputs of each row to
+    // outputs, outputStride floats apart. A stride of 0 packs the rows back to back. Nothing is
+    // allocated once the calling thread has run a network this large, and the network is only
+    // read, so any number of threads may run one network at the same time.
+    void runBatch(const float *inputs, int samples, float *outputs, int inputStride = 0, int outputStride = 0) const;
+    // The targets of batch are not read
+    void runBatch(const DatasetView &batch, float *outputs, int outputStride = 0) const;
 
     void runAndSaveError(QVector<float> inputs, float target, int divider = 1);
     void runMultiOutputAndSaveError(QVector<float> inputs, QVector<float> targets, int divider = 1);
@@ -92,25 +112,29 @@ public:
     void setError(float error);
     void resetError();
 
-    void clone(NeuralNetwork *other);
-    NeuralNetwork *breed(NeuralNetwork *mate, float mutationRate = 0.1, float amount = 1.0);
+    // Copies the genome and error of other. A view cannot change its genome size, it is left
+    // untouched and false returned when other's genome has another size.
+    bool clone(NeuralNetwork *other);
+    NeuralNetwork *breed(NeuralNetwork *mate, float mutationRate = 0.1, float amount = 1.0, Random &random = Random::threadLocal());
 
-    void crossOverBreed(NeuralNetwork *child, NeuralNetwork *mateA, NeuralNetwork *mateB, float mutationRate = 0.1, float amount = 1.0);
+    static void crossOverBreed(NeuralNetwork *child, NeuralNetwork *mateA, NeuralNetwork *mateB, float mutationRate = 0.1, float amount = 1.0, Random &random = Random::threadLocal());
 
     QByteArray drawNetwork();
 
 
 
 private:
-    QVector<Perceptron*> m_perceptrons;
+    void buildPerceptrons();
+    const float *forwardPass(const QVector<float> &inputs) const;
 
-    QMap<int, Perceptron*> m_networkMap;
+    NetworkTopology m_topology;
+    QVector<float> m_ownedGenome;
+    float *m_genome = nullptr;
 
-    QVector<int> m_layers;
-    int m_inputs;
-    float m_error;
+    QVector<Perceptron> m_perceptrons;
 
-    mutable std::shared_mutex m_errorMutex;
+    // Evaluation pipelines accumulate per worker and publish once, so a relaxed atomic is enough
+    std::atomic<float> m_error;
 
 };
 
@@ -0,0 +1,62 @@
+# The library sources shared by the demo and the benchmark
+
+INCLUDEPATH += $$PWD
+
+# qmake CONFIG+=count_allocations replaces the global operator new of the whole binary to count
+# its calls for the metrics, builds without it leave the allocator alone
+count_allocations: DEFINES += GNN_COUNT_ALLOCATIONS
+
+SOURCES += \
+        $$PWD/activation.cpp \
+        $$PWD/allocationcounter.cpp \
+        $$PWD/backpropagation.cpp \
+        $$PWD/checkpoint.cpp \
+        $$PWD/dataset.cpp \
+        $$PWD/distributedengine.cpp \
+        $$PWD/evaluator.cpp \
+        $$PWD/evolutionstrategy.cpp \
+        $$PWD/fitnessaccumulator.cpp \
+        $$PWD/fitnesscache.cpp \
+        $$PWD/forwardpass.cpp \
+        $$PWD/generationengine.cpp \
+        $$PWD/islandengine.cpp \
+        $$PWD/metricswriter.cpp \
+        $$PWD/neatengine.cpp \
+        $$PWD/neatgenome.cpp \
+        $$PWD/networktopology.cpp \
+        $$PWD/neuralnetwork.cpp \
+        $$PWD/population.cpp \
+        $$PWD/quantizednetwork.cpp \
+        $$PWD/racingcutoff.cpp \
+        $$PWD/random.cpp \
+        $$PWD/selection.cpp \
+        $$PWD/sparsenetwork.cpp \
+        $$PWD/threadpool.cpp
+
+HEADERS += \
+    $$PWD/activation.h \
+    $$PWD/allocationcounter.h \
+    $$PWD/backpropagation.h \
+    $$PWD/checkpoint.h \
+    $$PWD/dataset.h \
+    $$PWD/distributedengine.h \
+    $$PWD/evaluator.h \
+    $$PWD/evolutionstrategy.h \
+    $$PWD/fitnessaccumulator.h \
+    $$PWD/fitnesscache.h \
+    $$PWD/fixednetwork.h \
+    $$PWD/forwardpass.h \
+    $$PWD/generationengine.h \
+    $$PWD/islandengine.h \
+    $$PWD/metricswriter.h \
+    $$PWD/neatengine.h \
+    $$PWD/neatgenome.h \
+    $$PWD/networktopology.h \
+    $$PWD/neuralnetwork.h \
+    $$PWD/population.h \
+    $$PWD/quantizednetwork.h \
+    $$PWD/racingcutoff.h \
+    $$PWD/random.h \
+    $$PWD/selection.h \
+    $$PWD/sparsenetwork.h \
+    $$PWD/threadpool.h
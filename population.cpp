@@ -0,0 +1,89 @@
+#include "population.h"
+#include "neuralnetwork.h"
+#include "random.h"
+
+Population::Population(int size, const NetworkTopology &topology, bool sigmoidOutputLayer)
+    : m_topology(topology),
+      m_stride(topology.paddedGenomeSize()),
+      m_genes(size * topology.paddedGenomeSize(), 0.0)
+{
+    // Disable sigmoid activation for the output layer so it can be used for regression problems
+    if (!sigmoidOutputLayer)
+        m_topology.setOutputActivation(Activation::Identity);
+
+    m_networks.reserve(size);
+
+    for (int i = 0; i < size; ++i)
+    {
+        auto *network = new NeuralNetwork();
+        network->attachGenome(genome(i), m_topology);
+        m_networks << network;
+    }
+
+    randomise(1000, Random::threadLocal().next());
+}
+
+Population::~Population()
+{
+    qDeleteAll(m_networks);
+    m_networks.clear();
+}
+
+int Population::size() const
+{
+    return m_networks.size();
+}
+
+const NetworkTopology &Population::topology() const
+{
+    return m_topology;
+}
+
+bool Population::sigmoidOutputLayer() const
+{
+    return m_topology.layerActivation(m_topology.layerCount() - 1) != Activation::Identity;
+}
+
+int Population::stride() const
+{
+    return m_stride;
+}
+
+float *Population::data()
+{
+    return m_genes.data();
+}
+
+const float *Population::data() const
+{
+    return m_genes.constData();
+}
+
+float *Population::genome(int index)
+{
+    return m_genes.data() + index * m_stride;
+}
+
+const float *Population::genome(int index) const
+{
+    return m_genes.constData() + index * m_stride;
+}
+
+NeuralNetwork *Population::network(int index)
+{
+    return m_networks[index];
+}
+
+const QVector<NeuralNetwork *> &Population::networks() const
+{
+    return m_networks;
+}
+
+void Population::randomise(int limit, quint64 seed)
+{
+    for (int i = 0; i < m_networks.size(); ++i)
+    {
+        Random random(seed, quint64(i));
+        m_networks[i]->randomiseWeights(limit, random);
+    }
+}
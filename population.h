@@ -0,0 +1,45 @@
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include <QVector>
+#include "networktopology.h"
+
+class NeuralNetwork;
+
+// Holds the genomes of a whole population in one strided float block.
+// The NeuralNetworks handed out are views over that block and are created once.
+class Population
+{
+public:
+    Population(int size, const NetworkTopology &topology, bool sigmoidOutputLayer = true);
+    ~Population();
+
+    Population(const Population &) = delete;
+    Population &operator=(const Population &) = delete;
+
+    int size() const;
+    const NetworkTopology &topology() const;
+    bool sigmoidOutputLayer() const;
+
+    int stride() const;
+    float *data();
+    const float *data() const;
+
+    float *genome(int index);
+    const float *genome(int index) const;
+
+    NeuralNetwork *network(int index);
+    const QVector<NeuralNetwork*> &networks() const;
+
+    // Genome i is randomised from Random(seed, i) so the result does not depend on threading
+    void randomise(int limit, quint64 seed);
+
+private:
+    NetworkTopology m_topology;
+    int m_stride;
+
+    QVector<float> m_genes;
+    QVector<NeuralNetwork*> m_networks;
+};
+
+#endif // POPULATION_H
@@ -0,0 +1,271 @@
+#include "quantizednetwork.h"
+#include "neuralnetwork.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUANTIZED_SSE2
+#include <emmintrin.h>
+#endif
+
+// Int8 rows are padded with zero weights so the dot product always runs on whole vectors
+static const int Int8RowAlignment = 16;
+
+static int alignedRow(int fanIn)
+{
+    return (fanIn + Int8RowAlignment - 1) / Int8RowAlignment * Int8RowAlignment;
+}
+
+// Scale that maps the largest magnitude onto 127, 1 for all zero values
+static float int8Scale(const float *values, int count)
+{
+    float maxMagnitude = 0;
+    for (int i = 0; i < count; ++i)
+        maxMagnitude = qMax(maxMagnitude, std::fabs(values[i]));
+
+    return maxMagnitude > 0 ? maxMagnitude / 127.0f : 1.0f;
+}
+
+static qint8 toInt8(float value, float inverseScale)
+{
+    return qint8(qBound(-127L, std::lrint(value * inverseScale), 127L));
+}
+
+static qint32 int8Dot(const qint8 *a, const qint8 *b, int size)
+{
+#ifdef QUANTIZED_SSE2
+    // Sign extend 16 bytes to two halves of 16 bit lanes, then multiply-add pairs into 32 bits
+    __m128i total = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+
+    for (int i = 0; i < size; i += Int8RowAlignment)
+    {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        __m128i signA = _mm_cmpgt_epi8(zero, va);
+        __m128i signB = _mm_cmpgt_epi8(zero, vb);
+
+        total = _mm_add_epi32(total, _mm_madd_epi16(_mm_unpacklo_epi8(va, signA), _mm_unpacklo_epi8(vb, signB)));
+        total = _mm_add_epi32(total, _mm_madd_epi16(_mm_unpackhi_epi8(va, signA), _mm_unpackhi_epi8(vb, signB)));
+    }
+
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(1, 0, 3, 2)));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(total);
+#else
+    qint32 total = 0;
+    for (int i = 0; i < size; ++i)
+        total += qint32(a[i]) * qint32(b[i]);
+    return total;
+#endif
+}
+
+QuantizedNetwork::QuantizedNetwork()
+{
+}
+
+QuantizedNetwork::QuantizedNetwork(const NetworkTopology &topology, const float *genome, QuantizationFormat format)
+{
+    quantize(topology, genome, format);
+}
+
+void QuantizedNetwork::quantize(const NeuralNetwork &network, QuantizationFormat format)
+{
+    quantize(network.topology(), network.genome(), format);
+}
+
+void QuantizedNetwork::quantize(const NetworkTopology &topology, const float *genome, QuantizationFormat format)
+{
+    m_topology = topology;
+    m_format = format;
+    m_int8Weights.clear();
+    m_int8LayerOffsets.clear();
+    m_biases.clear();
+    m_layerScales.clear();
+    m_halfGenome.clear();
+
+    if (format == QuantizationFormat::Float16)
+    {
+        m_halfGenome.resize(topology.genomeSize());
+        qFloatToFloat16(m_halfGenome.data(), genome, topology.genomeSize());
+    }
+    else
+    {
+        for (int layer = 0; layer < topology.layerCount(); ++layer)
+        {
+            int fanIn = topology.layerInputs(layer);
+            int size = topology.layerSize(layer);
+            int row = alignedRow(fanIn);
+            const float *weights = genome + topology.layerOffset(layer);
+
+            // One scale for every weight of the layer, the biases are left out
+            float maxMagnitude = 0;
+            for (int j = 0; j < size; ++j)
+                for (int i = 0; i < fanIn; ++i)
+                    maxMagnitude = qMax(maxMagnitude, std::fabs(weights[j * (fanIn + 1) + i]));
+
+            float scale = maxMagnitude > 0 ? maxMagnitude / 127.0f : 1.0f;
+            m_layerScales << scale;
+            m_int8LayerOffsets << m_int8Weights.size();
+            m_int8Weights.resize(m_int8Weights.size() + size * row);
+
+            qint8 *rows = m_int8Weights.data() + m_int8LayerOffsets.last();
+            for (int j = 0; j < size; ++j)
+            {
+                for (int i = 0; i < fanIn; ++i)
+                    rows[j * row + i] = toInt8(weights[j * (fanIn + 1) + i], 1.0f / scale);
+
+                m_biases << weights[j * (fanIn + 1) + fanIn];
+            }
+        }
+    }
+
+    int size = qMax(topology.inputs(), topology.maxLayerSize());
+    m_current.resize(size);
+    m_next.resize(size);
+    m_quantizedInputs.fill(0, alignedRow(size));
+
+    int widest = 0;
+    for (int layer = 0; layer < topology.layerCount(); ++layer)
+        widest = qMax(widest, topology.layerSize(layer) * (topology.layerInputs(layer) + 1));
+    m_widened.resize(format == QuantizationFormat::Float16 ? widest : 0);
+}
+
+bool QuantizedNetwork::isEmpty() const
+{
+    return !m_topology.isValid();
+}
+
+QuantizationFormat QuantizedNetwork::format() const
+{
+    return m_format;
+}
+
+const NetworkTopology &QuantizedNetwork::topology() const
+{
+    return m_topology;
+}
+
+int QuantizedNetwork::byteSize() const
+{
+    if (m_format == QuantizationFormat::Float16)
+        return m_halfGenome.size() * int(sizeof(qfloat16));
+
+    return m_int8Weights.size() * int(sizeof(qint8)) + (m_biases.size() + m_layerScales.size()) * int(sizeof(float));
+}
+
+const float *QuantizedNetwork::run(const float *inputs)
+{
+    const float *layerInputs = inputs;
+    float *layerOutputs = m_next.data();
+    float *spare = m_current.data();
+
+    for (int layer = 0; layer < m_topology.layerCount(); ++layer)
+    {
+        if (m_format == QuantizationFormat::Float16)
+            runFloat16Layer(layer, layerInputs, layerOutputs);
+        else
+            runInt8Layer(layer, layerInputs, layerOutputs);
+
+        ActivationKernels::apply(m_topology.layerActivation(layer), layerOutputs, m_topology.layerSize(layer));
+
+        layerInputs = layerOutputs;
+        std::swap(layerOutputs, spare);
+    }
+
+    return layerInputs;
+}
+
+QVector<float> QuantizedNetwork::runMultiOutput(const QVector<float> &inputs)
+{
+    Q_ASSERT(inputs.size() == m_topology.inputs());
+
+    const float *outputs = run(inputs.constData());
+    return QVector<float>(outputs, outputs + m_topology.outputs());
+}
+
+void QuantizedNetwork::runInt8Layer(int layer, const float *inputs, float *outputs)
+{
+    int fanIn = m_topology.layerInputs(layer);
+    int size = m_topology.layerSize(layer);
+    int row = alignedRow(fanIn);
+
+    // The inputs get a scale of their own for every sample, the padding stays zero
+    float inputScale = int8Scale(inputs, fanIn);
+    qint8 *quantized = m_quantizedInputs.data();
+    for (int i = 0; i < fanIn; ++i)
+        quantized[i] = toInt8(inputs[i], 1.0f / inputScale);
+
+    float scale = inputScale * m_layerScales[layer];
+    const qint8 *weights = m_int8Weights.constData() + m_int8LayerOffsets[layer];
+    const float *biases = m_biases.constData() + m_topology.layerFirstPerceptron(layer);
+
+    for (int j = 0; j < size; ++j)
+        outputs[j] = float(int8Dot(weights + j * row, quantized, row)) * scale + biases[j];
+}
+
+void QuantizedNetwork::runFloat16Layer(int layer, const float *inputs, float *outputs)
+{
+    int fanIn = m_topology.layerInputs(layer);
+    int size = m_topology.layerSize(layer);
+    float *weights = m_widened.data();
+
+    qFloatFromFloat16(weights, m_halfGenome.constData() + m_topology.layerOffset(layer), size * (fanIn + 1));
+
+    for (int j = 0; j < size; ++j)
+    {
+        // The bias follows the weights of each perceptron
+        float total = weights[fanIn];
+        for (int i = 0; i < fanIn; ++i)
+            total += inputs[i] * weights[i];
+
+        outputs[j] = total;
+        weights += fanIn + 1;
+    }
+}
+
+QuantizationReport QuantizedNetwork::compare(const float *genome, const DatasetView &dataset)
+{
+    Q_ASSERT(dataset.inputSize == m_topology.inputs());
+    Q_ASSERT(dataset.outputSize == m_topology.outputs());
+
+    QuantizationReport report;
+    report.samples = dataset.samples;
+    report.floatBytes = m_topology.genomeSize() * int(sizeof(float));
+    report.quantizedBytes = byteSize();
+
+    double totalDifference = 0;
+    for (int s = 0; s < dataset.samples; ++s)
+    {
+        const float *targets = dataset.targetRow(s);
+        const float *floatOutputs = m_floatPass.run(m_topology, genome, dataset.inputRow(s));
+        const float *outputs = run(dataset.inputRow(s));
+
+        for (int o = 0; o < m_topology.outputs(); ++o)
+        {
+            float difference = std::fabs(outputs[o] - floatOutputs[o]);
+            report.maxOutputDifference = qMax(report.maxOutputDifference, difference);
+            totalDifference += difference;
+
+            report.floatError += double(floatOutputs[o] - targets[o]) * double(floatOutputs[o] - targets[o]);
+            report.quantizedError += double(outputs[o] - targets[o]) * double(outputs[o] - targets[o]);
+        }
+    }
+
+    if (dataset.samples > 0)
+        report.meanOutputDifference = float(totalDifference / (double(dataset.samples) * m_topology.outputs()));
+
+    return report;
+}
+
+const char *QuantizedNetwork::name(QuantizationFormat format)
+{
+    switch (format)
+    {
+    case QuantizationFormat::Int8:
+        return "int8";
+    case QuantizationFormat::Float16:
+        return "fp16";
+    }
+
+    return "unknown";
+}
@@ -0,0 +1,86 @@
+#ifndef QUANTIZEDNETWORK_H
+#define QUANTIZEDNETWORK_H
+
+#include <QVector>
+#include <QtGlobal>
+#include <qfloat16.h>
+#include "dataset.h"
+#include "forwardpass.h"
+#include "networktopology.h"
+
+class NeuralNetwork;
+
+enum class QuantizationFormat
+{
+    // Weights as int8 with one scale per layer. Each layer's inputs are quantized to int8 on
+    // the fly with their own scale, the dot products run in int32 and biases stay float.
+    Int8,
+    // Weights and biases as IEEE half floats, widened a layer at a time and run in float
+    Float16
+};
+
+// How far a quantized network drifts from the float network it was made from
+struct QuantizationReport
+{
+    int samples = 0;
+    // Summed squared error against the targets, as the evolution scores it
+    double floatError = 0;
+    double quantizedError = 0;
+    // Absolute difference between quantized and float outputs
+    float maxOutputDifference = 0;
+    float meanOutputDifference = 0;
+    // Weights and biases of the float and the quantized network
+    int floatBytes = 0;
+    int quantizedBytes = 0;
+};
+
+// A trained network with its weights shrunk to int8 or fp16 for serving. Quantizing is a one off
+// step after evolution, the layout mirrors the float genome one perceptron row at a time.
+// A QuantizedNetwork owns scratch buffers and is meant to be used by one thread at a time.
+class QuantizedNetwork
+{
+public:
+    QuantizedNetwork();
+    QuantizedNetwork(const NetworkTopology &topology, const float *genome, QuantizationFormat format);
+
+    void quantize(const NetworkTopology &topology, const float *genome, QuantizationFormat format);
+    void quantize(const NeuralNetwork &network, QuantizationFormat format);
+
+    bool isEmpty() const;
+    QuantizationFormat format() const;
+    const NetworkTopology &topology() const;
+    // Bytes taken by the weights, biases and scales
+    int byteSize() const;
+
+    // Returns a pointer to topology().outputs() values, valid until the next run
+    const float *run(const float *inputs);
+    QVector<float> runMultiOutput(const QVector<float> &inputs);
+
+    // Runs the dataset through this network and the float genome it was quantized from
+    QuantizationReport compare(const float *genome, const DatasetView &dataset);
+
+    static const char *name(QuantizationFormat format);
+
+private:
+    void runInt8Layer(int layer, const float *inputs, float *outputs);
+    void runFloat16Layer(int layer, const float *inputs, float *outputs);
+
+    NetworkTopology m_topology;
+    QuantizationFormat m_format = QuantizationFormat::Int8;
+
+    // Int8: rows of fanIn weights padded to a multiple of Int8RowAlignment, a float bias per
+    // perceptron and a scale per layer. Float16: the genome as is, [weights..., bias] per perceptron.
+    QVector<qint8> m_int8Weights;
+    QVector<int> m_int8LayerOffsets;
+    QVector<float> m_biases;
+    QVector<float> m_layerScales;
+    QVector<qfloat16> m_halfGenome;
+
+    QVector<float> m_current;
+    QVector<float> m_next;
+    QVector<qint8> m_quantizedInputs;
+    QVector<float> m_widened;
+    ForwardPass m_floatPass;
+};
+
+#endif // QUANTIZEDNETWORK_H
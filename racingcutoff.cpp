@@ -0,0 +1,57 @@
+#include "racingcutoff.h"
+#include <algorithm>
+#include <limits>
+
+RacingCutoff::RacingCutoff()
+    : m_cutoff(std::numeric_limits<float>::infinity())
+{
+}
+
+void RacingCutoff::reset(int keep)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_keep = qMax(1, keep);
+    m_size = 0;
+
+    if (m_heap.size() < m_keep)
+        m_heap.resize(m_keep);
+
+    m_cutoff.store(std::numeric_limits<float>::infinity(), std::memory_order_relaxed);
+}
+
+float RacingCutoff::cutoff() const
+{
+    return m_cutoff.load(std::memory_order_relaxed);
+}
+
+const std::atomic<float> &RacingCutoff::value() const
+{
+    return m_cutoff;
+}
+
+void RacingCutoff::offer(const float *errors, int count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Max heap of the keep smallest errors
+    float *heap = m_heap.data();
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (m_size < m_keep)
+        {
+            heap[m_size++] = errors[i];
+            std::push_heap(heap, heap + m_size);
+        }
+        else if (errors[i] < heap[0])
+        {
+            std::pop_heap(heap, heap + m_size);
+            heap[m_size - 1] = errors[i];
+            std::push_heap(heap, heap + m_size);
+        }
+    }
+
+    if (m_size == m_keep)
+        m_cutoff.store(heap[0], std::memory_order_relaxed);
+}
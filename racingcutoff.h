@@ -0,0 +1,33 @@
+#ifndef RACINGCUTOFF_H
+#define RACINGCUTOFF_H
+
+#include <QVector>
+#include <atomic>
+#include <mutex>
+
+// Tracks the error a genome must stay below to make the breeding pool: the largest of the
+// keep smallest errors offered so far, or +inf until keep errors have been offered. Errors
+// only grow as samples are added, so a genome whose partial error reaches the cutoff can stop.
+class RacingCutoff
+{
+public:
+    RacingCutoff();
+
+    // Clears the cutoff for a new evaluation pass, the storage only grows
+    void reset(int keep);
+
+    float cutoff() const;
+    const std::atomic<float> &value() const;
+
+    // Errors of aborted genomes may be offered too, they are never below the cutoff
+    void offer(const float *errors, int count);
+
+private:
+    std::mutex m_mutex;
+    QVector<float> m_heap;
+    int m_keep = 0;
+    int m_size = 0;
+    std::atomic<float> m_cutoff;
+};
+
+#endif // RACINGCUTOFF_H
@@ -0,0 +1,64 @@
+#include "random.h"
+#include <atomic>
+#include <qmath.h>
+
+static std::atomic<quint64> s_globalSeed(0x853c49e6748fea9bULL);
+static std::atomic<quint64> s_threadCounter(0);
+
+Random::Random(quint64 seed)
+    : m_key(mix(seed))
+{
+}
+
+Random::Random(quint64 seed, quint64 stream)
+    : m_key(mix(mix(seed) ^ mix(stream + 0x9e3779b97f4a7c15ULL)))
+{
+}
+
+Random Random::split(quint64 stream) const
+{
+    return Random(m_key, stream);
+}
+
+quint64 Random::key() const
+{
+    return m_key;
+}
+
+quint64 Random::counter() const
+{
+    return m_counter;
+}
+
+void Random::setState(quint64 key, quint64 counter)
+{
+    m_key = key;
+    m_counter = counter;
+}
+
+double Random::normal()
+{
+    // Box-Muller, the first uniform is in (0, 1] so its log is finite
+    double radius = std::sqrt(-2.0 * std::log(double((next() >> 11) + 1) * (1.0 / 9007199254740992.0)));
+    double angle = double(next() >> 11) * (2.0 * M_PI / 9007199254740992.0);
+    return radius * std::cos(angle);
+}
+
+Random &Random::threadLocal()
+{
+    static thread_local Random random(s_globalSeed.load(), s_threadCounter++);
+    return random;
+}
+
+void Random::setGlobalSeed(quint64 seed)
+{
+    s_globalSeed = seed;
+    s_threadCounter = 0;
+
+    threadLocal() = Random(seed, s_threadCounter++);
+}
+
+quint64 Random::globalSeed()
+{
+    return s_globalSeed;
+}
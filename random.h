@@ -0,0 +1,85 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <QtGlobal>
+
+// Counter-based SplitMix64 generator. A generator is fully described by its key and
+// counter, and split() derives independent streams from the key alone, so work that
+// takes its generator from (seed, generation, index) gives the same results whatever
+// thread runs it. Satisfies UniformRandomBitGenerator for use with <random> and std::shuffle.
+class Random
+{
+public:
+    typedef quint64 result_type;
+
+    explicit Random(quint64 seed = 0);
+    Random(quint64 seed, quint64 stream);
+
+    Random split(quint64 stream) const;
+
+    quint64 key() const;
+    quint64 counter() const;
+    void setState(quint64 key, quint64 counter);
+
+    quint64 next();
+    quint32 nextUInt();
+    int bounded(int limit);
+    float uniform();
+    bool coin();
+    // Standard normal, from two draws so that the state stays the key and counter
+    double normal();
+
+    result_type operator()();
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~quint64(0); }
+
+    static quint64 mix(quint64 value);
+
+    // Generator of the calling thread, used by code that is not handed one explicitly
+    static Random &threadLocal();
+    static void setGlobalSeed(quint64 seed);
+    static quint64 globalSeed();
+
+private:
+    quint64 m_key;
+    quint64 m_counter = 0;
+};
+
+inline quint64 Random::mix(quint64 value)
+{
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+inline quint64 Random::next()
+{
+    return mix(m_key + ++m_counter * 0x9e3779b97f4a7c15ULL);
+}
+
+inline quint32 Random::nextUInt()
+{
+    return quint32(next() >> 32);
+}
+
+inline int Random::bounded(int limit)
+{
+    return int((quint64(nextUInt()) * quint64(limit)) >> 32);
+}
+
+inline float Random::uniform()
+{
+    return float(next() >> 40) * (1.0f / 16777216.0f);
+}
+
+inline bool Random::coin()
+{
+    return next() >> 63;
+}
+
+inline Random::result_type Random::operator()()
+{
+    return next();
+}
+
+#endif // RANDOM_H
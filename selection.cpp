@@ -0,0 +1,166 @@
+#include "selection.h"
+#include "random.h"
+#include <algorithm>
+
+Selection::Selection()
+{
+}
+
+SelectionMethod Selection::method() const
+{
+    return m_method;
+}
+
+void Selection::setMethod(SelectionMethod method)
+{
+    m_method = method;
+}
+
+int Selection::tournamentSize() const
+{
+    return m_tournamentSize;
+}
+
+void Selection::setTournamentSize(int tournamentSize)
+{
+    m_tournamentSize = qMax(1, tournamentSize);
+}
+
+float Selection::rankPressure() const
+{
+    return m_rankPressure;
+}
+
+void Selection::setRankPressure(float rankPressure)
+{
+    m_rankPressure = qBound(1.0f, rankPressure, 2.0f);
+}
+
+void Selection::select(const float *errors, int count, int *parents, int parentCount, Random &random)
+{
+    Q_ASSERT(count > 0);
+
+    switch (m_method)
+    {
+    case SelectionMethod::Truncation:
+        truncation(errors, count, parents, parentCount);
+        break;
+    case SelectionMethod::Tournament:
+        tournament(errors, count, parents, parentCount, random);
+        break;
+    case SelectionMethod::Rank:
+        rank(errors, count, parents, parentCount, random);
+        break;
+    case SelectionMethod::Roulette:
+        roulette(errors, count, parents, parentCount, random);
+        break;
+    }
+}
+
+int Selection::bestIndex(const float *errors, int count)
+{
+    int best = 0;
+    for (int i = 1; i < count; ++i)
+        if (errors[i] < errors[best])
+            best = i;
+
+    return best;
+}
+
+void Selection::truncation(const float *errors, int count, int *parents, int parentCount)
+{
+    if (m_order.size() < count)
+        m_order.resize(count);
+
+    for (int i = 0; i < count; ++i)
+        m_order[i] = i;
+
+    // Ties are broken on the index so the result does not depend on the standard library
+    auto lessError = [errors](int a, int b)->bool
+    {
+        return errors[a] < errors[b] || (errors[a] == errors[b] && a < b);
+    };
+
+    int selected = qMin(parentCount, count);
+    int *order = m_order.data();
+    std::nth_element(order, order + selected - 1, order + count, lessError);
+    std::sort(order, order + selected, lessError);
+
+    for (int i = 0; i < parentCount; ++i)
+        parents[i] = order[i % selected];
+}
+
+void Selection::tournament(const float *errors, int count, int *parents, int parentCount, Random &random)
+{
+    for (int i = 0; i < parentCount; ++i)
+    {
+        int winner = random.bounded(count);
+        for (int round = 1; round < m_tournamentSize; ++round)
+        {
+            int challenger = random.bounded(count);
+            if (errors[challenger] < errors[winner])
+                winner = challenger;
+        }
+
+        parents[i] = winner;
+    }
+}
+
+void Selection::rank(const float *errors, int count, int *parents, int parentCount, Random &random)
+{
+    if (m_order.size() < count)
+        m_order.resize(count);
+    if (m_cumulative.size() < count)
+        m_cumulative.resize(count);
+
+    for (int i = 0; i < count; ++i)
+        m_order[i] = i;
+
+    // Ranking needs the full order, unlike the other methods this is O(n log n)
+    std::sort(m_order.begin(), m_order.begin() + count, [errors](int a, int b)->bool
+    {
+        return errors[a] < errors[b] || (errors[a] == errors[b] && a < b);
+    });
+
+    double total = 0;
+    for (int r = 0; r < count; ++r)
+    {
+        double position = count > 1 ? double(count - 1 - r) / double(count - 1) : 1.0;
+        total += (2.0 - m_rankPressure) + 2.0 * (m_rankPressure - 1.0) * position;
+        m_cumulative[r] = total;
+    }
+
+    sampleCumulative(count, parents, parentCount, random);
+}
+
+void Selection::roulette(const float *errors, int count, int *parents, int parentCount, Random &random)
+{
+    if (m_order.size() < count)
+        m_order.resize(count);
+    if (m_cumulative.size() < count)
+        m_cumulative.resize(count);
+
+    double total = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        m_order[i] = i;
+        total += 1.0 / (1.0 + qMax(0.0f, errors[i]));
+        m_cumulative[i] = total;
+    }
+
+    sampleCumulative(count, parents, parentCount, random);
+}
+
+void Selection::sampleCumulative(int count, int *parents, int parentCount, Random &random)
+{
+    const double *begin = m_cumulative.constData();
+    const double *end = begin + count;
+    double total = m_cumulative[count - 1];
+
+    for (int i = 0; i < parentCount; ++i)
+    {
+        double target = random.uniform() * total;
+        int slot = int(std::upper_bound(begin, end, target) - begin);
+        parents[i] = m_order[qMin(slot, count - 1)];
+    }
+}
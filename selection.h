@@ -0,0 +1,57 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <QVector>
+
+class Random;
+
+enum class SelectionMethod
+{
+    // The parentCount lowest errors, found with nth_element and then sorted so the result
+    // only depends on the errors of the selected genomes
+    Truncation,
+    // Each parent is the best of tournamentSize random draws
+    Tournament,
+    // Linear ranking, weight falls from rankPressure for the best to 2 - rankPressure for the worst
+    Rank,
+    // Fitness proportional with fitness 1 / (1 + error)
+    Roulette
+};
+
+// Picks breeding parents from a plain array of errors (lower is better). The scratch
+// buffers only grow, so repeated selections over the same pool size do not allocate.
+class Selection
+{
+public:
+    Selection();
+
+    SelectionMethod method() const;
+    void setMethod(SelectionMethod method);
+
+    int tournamentSize() const;
+    void setTournamentSize(int tournamentSize);
+
+    float rankPressure() const;
+    void setRankPressure(float rankPressure);
+
+    // Writes parentCount indices in [0, count) to parents
+    void select(const float *errors, int count, int *parents, int parentCount, Random &random);
+
+    static int bestIndex(const float *errors, int count);
+
+private:
+    void truncation(const float *errors, int count, int *parents, int parentCount);
+    void tournament(const float *errors, int count, int *parents, int parentCount, Random &random);
+    void rank(const float *errors, int count, int *parents, int parentCount, Random &random);
+    void roulette(const float *errors, int count, int *parents, int parentCount, Random &random);
+    void sampleCumulative(int count, int *parents, int parentCount, Random &random);
+
+    SelectionMethod m_method = SelectionMethod::Truncation;
+    int m_tournamentSize = 10;
+    float m_rankPressure = 1.5;
+
+    QVector<int> m_order;
+    QVector<double> m_cumulative;
+};
+
+#endif // SELECTION_H
@@ -0,0 +1,255 @@
+#include "sparsenetwork.h"
+#include <algorithm>
+#include "evaluator.h"
+#include "neatgenome.h"
+
+static const int BlockSize = Evaluator::SampleBlockSize;
+
+SparseNetwork::SparseNetwork()
+{
+}
+
+bool SparseNetwork::compile(const NeatGenome &genome)
+{
+    clear();
+
+    const QVector<NodeGene> &nodes = genome.nodes();
+    const QVector<ConnectionGene> &connections = genome.connections();
+    int inputs = genome.inputs();
+
+    // Walk back from the outputs, nodes they do not depend on are never computed
+    QVector<bool> needed(nodes.size(), false);
+    QVector<int> stack;
+    for (int o = 0; o < genome.outputs(); ++o)
+    {
+        needed[inputs + o] = true;
+        stack << inputs + o;
+    }
+
+    while (!stack.isEmpty())
+    {
+        int id = nodes[stack.takeLast()].id;
+        for (const auto &connection : connections)
+        {
+            if (!connection.enabled || connection.to != id)
+                continue;
+
+            int source = genome.nodeIndex(connection.from);
+            if (!needed[source])
+            {
+                needed[source] = true;
+                stack << source;
+            }
+        }
+    }
+
+    // Kahn's algorithm over the needed nodes, inputs are ready from the start
+    QVector<int> pending(nodes.size(), 0);
+    for (const auto &connection : connections)
+    {
+        int target = genome.nodeIndex(connection.to);
+        if (connection.enabled && needed[target] && nodes[genome.nodeIndex(connection.from)].type != NodeType::Input)
+            pending[target]++;
+    }
+
+    QVector<int> order;
+    QVector<int> ready;
+    for (int n = inputs; n < nodes.size(); ++n)
+        if (needed[n] && pending[n] == 0)
+            ready << n;
+
+    while (!ready.isEmpty())
+    {
+        int index = ready.takeFirst();
+        order << index;
+
+        for (const auto &connection : connections)
+        {
+            if (!connection.enabled || connection.from != nodes[index].id)
+                continue;
+
+            int target = genome.nodeIndex(connection.to);
+            if (needed[target] && --pending[target] == 0)
+                ready << target;
+        }
+    }
+
+    int neededCount = int(std::count(needed.constBegin() + inputs, needed.constEnd(), true));
+    if (order.size() != neededCount)
+    {
+        m_errorString = QString("The enabled connections form a cycle");
+        return false;
+    }
+
+    QVector<int> slots(nodes.size(), -1);
+    for (int i = 0; i < inputs; ++i)
+        slots[i] = i;
+    for (int n = 0; n < order.size(); ++n)
+        slots[order[n]] = inputs + n;
+
+    m_inputs = inputs;
+    m_outputs = genome.outputs();
+    m_rowStarts.reserve(order.size() + 1);
+
+    for (int index : order)
+    {
+        const NodeGene &node = nodes[index];
+        m_rowStarts << m_sources.size();
+        m_biases << node.bias;
+        m_activations << node.activation;
+
+        for (const auto &connection : connections)
+        {
+            if (connection.enabled && connection.to == node.id)
+            {
+                m_sources << slots[genome.nodeIndex(connection.from)];
+                m_weights << connection.weight;
+            }
+        }
+    }
+    m_rowStarts << m_sources.size();
+
+    for (int o = 0; o < m_outputs; ++o)
+        m_outputSlots << slots[inputs + o];
+
+    m_values.fill(0.0f, (m_inputs + order.size()) * BlockSize);
+    m_outputValues.fill(0.0f, m_outputs);
+    return true;
+}
+
+void SparseNetwork::clear()
+{
+    m_inputs = 0;
+    m_outputs = 0;
+    m_rowStarts.clear();
+    m_sources.clear();
+    m_weights.clear();
+    m_biases.clear();
+    m_activations.clear();
+    m_outputSlots.clear();
+    m_values.clear();
+    m_outputValues.clear();
+    m_errorString.clear();
+}
+
+bool SparseNetwork::isEmpty() const
+{
+    return m_outputs == 0;
+}
+
+QString SparseNetwork::errorString() const
+{
+    return m_errorString;
+}
+
+int SparseNetwork::inputs() const
+{
+    return m_inputs;
+}
+
+int SparseNetwork::outputs() const
+{
+    return m_outputs;
+}
+
+int SparseNetwork::nodeCount() const
+{
+    return m_biases.size();
+}
+
+int SparseNetwork::connectionCount() const
+{
+    return m_sources.size();
+}
+
+const float *SparseNetwork::run(const float *inputs)
+{
+    DatasetView sample;
+    sample.inputs = inputs;
+    sample.inputSize = m_inputs;
+    sample.samples = 1;
+
+    runBlock(sample, 0, 1);
+
+    for (int o = 0; o < m_outputs; ++o)
+        m_outputValues[o] = m_values[m_outputSlots[o] * BlockSize];
+
+    return m_outputValues.constData();
+}
+
+QVector<float> SparseNetwork::runMultiOutput(const QVector<float> &inputs)
+{
+    const float *outputs = run(inputs.constData());
+    return QVector<float>(outputs, outputs + m_outputs);
+}
+
+float SparseNetwork::evaluate(const DatasetView &dataset)
+{
+    float error = 0;
+
+    for (int first = 0; first < dataset.samples; first += BlockSize)
+    {
+        int samples = qMin(BlockSize, dataset.samples - first);
+        runBlock(dataset, first, samples);
+
+        float blockError = 0;
+        for (int o = 0; o < m_outputs; ++o)
+        {
+            const float *outputs = m_values.constData() + m_outputSlots[o] * BlockSize;
+            for (int s = 0; s < samples; ++s)
+            {
+                float difference = outputs[s] - dataset.targetRow(first + s)[o];
+                blockError += difference * difference;
+            }
+        }
+
+        error += blockError;
+    }
+
+    return error;
+}
+
+void SparseNetwork::predict(const DatasetView &samples, float *outputs, int outputStride)
+{
+    for (int first = 0; first < samples.samples; first += BlockSize)
+    {
+        int count = qMin(BlockSize, samples.samples - first);
+        runBlock(samples, first, count);
+
+        for (int o = 0; o < m_outputs; ++o)
+        {
+            const float *values = m_values.constData() + m_outputSlots[o] * BlockSize;
+            for (int s = 0; s < count; ++s)
+                outputs[size_t(first + s) * size_t(outputStride) + size_t(o)] = values[s];
+        }
+    }
+}
+
+void SparseNetwork::runBlock(const DatasetView &dataset, int firstSample, int samples)
+{
+    float *values = m_values.data();
+
+    for (int s = 0; s < samples; ++s)
+    {
+        const float *row = dataset.inputRow(firstSample + s);
+        for (int i = 0; i < m_inputs; ++i)
+            values[i * BlockSize + s] = row[i];
+    }
+
+    // Every source slot is written before the row that reads it
+    for (int n = 0; n < m_biases.size(); ++n)
+    {
+        float *result = values + (m_inputs + n) * BlockSize;
+        std::fill(result, result + samples, m_biases[n]);
+
+        for (int e = m_rowStarts[n]; e < m_rowStarts[n + 1]; ++e)
+        {
+            const float *source = values + m_sources[e] * BlockSize;
+            const float weight = m_weights[e];
+            for (int s = 0; s < samples; ++s)
+                result[s] += weight * source[s];
+        }
+
+        ActivationKernels::apply(m_activations[n], result, samples);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef SPARSENETWORK_H
+#define SPARSENETWORK_H
+
+#include <QString>
+#include <QVector>
+#include "activation.h"
+#include "dataset.h"
+
+class NeatGenome;
+
+// The execution plan of a NeatGenome. Nodes that feed no output are dropped, the rest are
+// sorted topologically and each computed node keeps its incoming edges as a CSR row of source
+// slots and weights. Inputs take the first slots, so a forward pass is one walk over the rows.
+// Values are node-major over blocks of Evaluator::SampleBlockSize samples like the dense
+// Evaluator, so every edge is a multiply-add over contiguous samples.
+// A SparseNetwork owns scratch buffers and is meant to be used by one thread at a time.
+class SparseNetwork
+{
+public:
+    SparseNetwork();
+
+    // Returns false and leaves the network empty if the enabled connections form a cycle
+    bool compile(const NeatGenome &genome);
+    void clear();
+
+    bool isEmpty() const;
+    QString errorString() const;
+
+    int inputs() const;
+    int outputs() const;
+    // Computed nodes and the edges into them, after pruning
+    int nodeCount() const;
+    int connectionCount() const;
+
+    // Returns a pointer to outputs() values, valid until the next run
+    const float *run(const float *inputs);
+    QVector<float> runMultiOutput(const QVector<float> &inputs);
+
+    // Summed squared error over the dataset, summed per sample block like Evaluator::evaluate
+    float evaluate(const DatasetView &dataset);
+    // Writes outputs() values per input row of samples to outputs, outputStride floats apart
+    void predict(const DatasetView &samples, float *outputs, int outputStride);
+
+private:
+    void runBlock(const DatasetView &dataset, int firstSample, int samples);
+
+    int m_inputs = 0;
+    int m_outputs = 0;
+
+    // Row n of computed node n is edges m_rowStarts[n] .. m_rowStarts[n + 1] - 1, and node n
+    // writes slot m_inputs + n
+    QVector<int> m_rowStarts;
+    QVector<int> m_sources;
+    QVector<float> m_weights;
+    QVector<float> m_biases;
+    QVector<Activation> m_activations;
+    QVector<int> m_outputSlots;
+
+    QVector<float> m_values;
+    QVector<float> m_outputValues;
+    QString m_errorString;
+};
+
+#endif // SPARSENETWORK_H
@@ -0,0 +1,12 @@
+QT -= gui
+QT += network testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = NeuralNetworkTests
+
+include(../neuralnetwork.pri)
+
+SOURCES += \
+        tst_neuralnetwork.cpp
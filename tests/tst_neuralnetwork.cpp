@@ -0,0 +1,591 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cmath>
+#include "activation.h"
+#include "backpropagation.h"
+#include "checkpoint.h"
+#include "dataset.h"
+#include "evaluator.h"
+#include "fixednetwork.h"
+#include "forwardpass.h"
+#include "neatgenome.h"
+#include "networktopology.h"
+#include "population.h"
+#include "random.h"
+#include "sparsenetwork.h"
+
+// Checks that the optimised paths agree with the plain ones they replace. Run with make check.
+class NeuralNetworkTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void simdActivationsMatchScalar_data();
+    void simdActivationsMatchScalar();
+    void evaluatorMatchesForwardPass();
+    void fixedEvaluatorMatchesEvaluator();
+    void incrementalEvaluationMatchesEvaluate();
+    void backpropagationMatchesFiniteDifferences_data();
+    void backpropagationMatchesFiniteDifferences();
+    void sparseNetworkMatchesGenome();
+    void sparseNetworkPrunesUnusedNodes();
+    void sparseNetworkRejectsCycles();
+    void checkpointRoundTrip();
+    void csvMatchesPackedDataset();
+};
+
+static QVector<float> randomValues(int count, Random &random, float range)
+{
+    QVector<float> values(count);
+    for (float &value : values)
+        value = (2.0f * random.uniform() - 1.0f) * range;
+    return values;
+}
+
+// Rows of inputs in [-1, 1] followed by targets in [0, 1]
+static void fillDataset(Dataset &dataset, int samples, int inputSize, int outputSize, Random &random)
+{
+    QVector<float> rows;
+    for (int sample = 0; sample < samples; ++sample)
+    {
+        rows += randomValues(inputSize, random, 1.0f);
+        for (int o = 0; o < outputSize; ++o)
+            rows << random.uniform();
+    }
+
+    dataset.setData(rows.constData(), samples, inputSize, outputSize);
+}
+
+// Summed squared error of genome over dataset, one sample at a time
+static double forwardPassError(const NetworkTopology &topology, const float *genome, const DatasetView &dataset)
+{
+    ForwardPass pass;
+    double error = 0;
+
+    for (int sample = 0; sample < dataset.samples; ++sample)
+    {
+        const float *outputs = pass.run(topology, genome, dataset.inputRow(sample));
+        for (int o = 0; o < dataset.outputSize; ++o)
+        {
+            double difference = double(outputs[o]) - double(dataset.targetRow(sample)[o]);
+            error += difference * difference;
+        }
+    }
+
+    return error;
+}
+
+// Value of node id straight from the genes, recursing into every enabled connection into it
+static float nodeValue(const NeatGenome &genome, int id, const float *inputs)
+{
+    const NodeGene &node = genome.nodes()[genome.nodeIndex(id)];
+    if (node.type == NodeType::Input)
+        return inputs[id];
+
+    float total = node.bias;
+    for (const auto &connection : genome.connections())
+        if (connection.enabled && connection.to == id)
+            total += connection.weight * nodeValue(genome, connection.from, inputs);
+
+    return ActivationKernels::apply(node.activation, total);
+}
+
+static bool sparseNetworkMatches(SparseNetwork &network, const NeatGenome &genome, Random &random)
+{
+    for (int sample = 0; sample < 8; ++sample)
+    {
+        QVector<float> inputs = randomValues(genome.inputs(), random, 1.0f);
+        const float *outputs = network.run(inputs.constData());
+
+        for (int o = 0; o < genome.outputs(); ++o)
+            if (std::fabs(outputs[o] - nodeValue(genome, genome.inputs() + o, inputs.constData())) > 1e-5f)
+                return false;
+    }
+
+    return true;
+}
+
+static NodeGene nodeGene(int id, NodeType type, Activation activation, float bias)
+{
+    NodeGene node;
+    node.id = id;
+    node.type = type;
+    node.activation = activation;
+    node.bias = bias;
+    return node;
+}
+
+static ConnectionGene connectionGene(int innovation, int from, int to, float weight, bool enabled = true)
+{
+    ConnectionGene connection;
+    connection.innovation = innovation;
+    connection.from = from;
+    connection.to = to;
+    connection.weight = weight;
+    connection.enabled = enabled;
+    return connection;
+}
+
+static bool sameRows(const Dataset &dataset, const Dataset &expected)
+{
+    if (dataset.samples() != expected.samples() || dataset.inputSize() != expected.inputSize()
+            || dataset.outputSize() != expected.outputSize())
+        return false;
+
+    return std::equal(dataset.row(0), dataset.row(0) + size_t(dataset.samples()) * size_t(dataset.columns()), expected.row(0));
+}
+
+static bool closeErrors(double error, double expected)
+{
+    return std::fabs(error - expected) <= 1e-4 * qMax(1.0, std::fabs(expected));
+}
+
+void NeuralNetworkTests::simdActivationsMatchScalar_data()
+{
+    QTest::addColumn<int>("activation");
+
+    for (Activation activation : {Activation::Identity, Activation::Sigmoid, Activation::FastSigmoid,
+                                  Activation::Tanh, Activation::ReLU, Activation::HardSigmoid})
+        QTest::newRow(ActivationKernels::name(activation)) << int(activation);
+}
+
+void NeuralNetworkTests::simdActivationsMatchScalar()
+{
+    QFETCH(int, activation);
+
+    // An odd count so every kernel also runs its scalar tail, and values past the exp clamps
+    QVector<float> inputs;
+    for (int i = 0; i < 1003; ++i)
+        inputs << -30.0f + 60.0f * float(i) / 1002.0f;
+    inputs << 0.0f << 88.0f << -88.0f << 100.0f << -100.0f;
+
+    ActivationKernels::InstructionSet original = ActivationKernels::instructionSet();
+
+    for (int set = ActivationKernels::Scalar; set <= ActivationKernels::bestSupportedInstructionSet(); ++set)
+    {
+        auto instructionSet = ActivationKernels::InstructionSet(set);
+        QVERIFY(ActivationKernels::setInstructionSet(instructionSet));
+
+        QVector<float> values = inputs;
+        ActivationKernels::apply(Activation(activation), values.data(), values.size());
+
+        for (int i = 0; i < inputs.size(); ++i)
+        {
+            float expected = ActivationKernels::apply(Activation(activation), inputs[i]);
+            if (std::fabs(values[i] - expected) > 1e-5f)
+                QFAIL(qPrintable(QString("%1 at %2: %3, scalar %4").arg(ActivationKernels::name(instructionSet))
+                                 .arg(double(inputs[i])).arg(double(values[i])).arg(double(expected))));
+        }
+    }
+
+    ActivationKernels::setInstructionSet(original);
+}
+
+void NeuralNetworkTests::evaluatorMatchesForwardPass()
+{
+    Random random(1);
+
+    // Sample and genome counts that leave partial sample blocks, with every activation in use
+    NetworkTopology topology(5, QVector<int>{7, 6, 3});
+    topology.setLayerActivation(0, Activation::Tanh);
+    topology.setLayerActivation(1, Activation::ReLU);
+    topology.setLayerActivation(2, Activation::Sigmoid);
+
+    Dataset dataset;
+    fillDataset(dataset, 150, topology.inputs(), topology.outputs(), random);
+
+    int count = 13;
+    int stride = topology.paddedGenomeSize();
+    QVector<float> genomes = randomValues(count * stride, random, 2.0f);
+
+    QVector<float> errors(count, 0.0f);
+    Evaluator evaluator;
+    evaluator.evaluate(topology, genomes.constData(), stride, count, dataset.view(), errors.data());
+
+    for (int g = 0; g < count; ++g)
+    {
+        double expected = forwardPassError(topology, genomes.constData() + g * stride, dataset.view());
+        QVERIFY2(closeErrors(errors[g], expected), qPrintable(QString("Genome %1: %2, forward pass %3").arg(g).arg(double(errors[g])).arg(expected)));
+    }
+}
+
+void NeuralNetworkTests::fixedEvaluatorMatchesEvaluator()
+{
+    using Network = FixedNetwork<3, 4, 2>;
+    Random random(2);
+
+    NetworkTopology topology(3, QVector<int>{4, 2});
+    topology.setLayerActivation(0, Activation::FastSigmoid);
+    QVERIFY(Network::matches(topology));
+
+    // Neither the genomes nor the samples fill the last run of lanes and samples
+    Dataset dataset;
+    fillDataset(dataset, 101, topology.inputs(), topology.outputs(), random);
+
+    int count = 11;
+    int stride = topology.paddedGenomeSize();
+    QVector<float> genomes = randomValues(count * stride, random, 2.0f);
+
+    QVector<float> errors(count, 0.0f);
+    Evaluator evaluator;
+    evaluator.evaluate(topology, genomes.constData(), stride, count, dataset.view(), errors.data());
+
+    QVector<float> fixedErrors(count, 0.0f);
+    FixedEvaluator<Network>::evaluate(topology, genomes.constData(), stride, count, dataset.view(), fixedErrors.data());
+
+    for (int g = 0; g < count; ++g)
+    {
+        const float *genome = genomes.constData() + g * stride;
+        double expected = forwardPassError(topology, genome, dataset.view());
+
+        QVERIFY2(closeErrors(errors[g], expected), qPrintable(QString("Genome %1: %2, forward pass %3").arg(g).arg(double(errors[g])).arg(expected)));
+        QVERIFY2(closeErrors(fixedErrors[g], expected), qPrintable(QString("Genome %1: fixed %2, forward pass %3").arg(g).arg(double(fixedErrors[g])).arg(expected)));
+
+        // A single FixedNetwork runs the same forward pass
+        Network network(topology, genome);
+        ForwardPass pass;
+        for (int sample = 0; sample < 4; ++sample)
+        {
+            float outputs[Network::OutputCount];
+            network.run(dataset.view().inputRow(sample), outputs);
+
+            const float *expectedOutputs = pass.run(topology, genome, dataset.view().inputRow(sample));
+            for (int o = 0; o < Network::OutputCount; ++o)
+                QVERIFY(std::fabs(outputs[o] - expectedOutputs[o]) <= 1e-5f);
+        }
+    }
+}
+
+void NeuralNetworkTests::incrementalEvaluationMatchesEvaluate()
+{
+    Random random(5);
+
+    // Hidden layers wide enough for a delta to be cheaper than a full pass
+    NetworkTopology topology(6, QVector<int>{16, 12, 3});
+    topology.setLayerActivation(0, Activation::Tanh);
+
+    Dataset dataset;
+    fillDataset(dataset, 150, topology.inputs(), topology.outputs(), random);
+
+    int genomeSize = topology.genomeSize();
+    int perceptrons = topology.perceptronCount();
+    int secondHidden = topology.layerFirstPerceptron(1);
+    int output = topology.layerFirstPerceptron(2);
+
+    Population parents(2, topology);
+    for (int parent = 0; parent < parents.size(); ++parent)
+    {
+        QVector<float> genome = randomValues(genomeSize, random, 2.0f);
+        std::copy(genome.constBegin(), genome.constEnd(), parents.genome(parent));
+    }
+
+    // Each child copies its parent, takes every perceptron from tail on from the other parent
+    // as a crossover would, then has the listed perceptrons nudged
+    Population children(8, topology);
+    QVector<GenomeDelta> deltas(children.size());
+
+    auto breed = [&](int child, int parent, int tail, const QVector<int> &mutated)
+    {
+        const float *base = parents.genome(parent);
+        const float *other = parents.genome(1 - parent);
+        float *genome = children.genome(child);
+
+        std::copy(base, base + genomeSize, genome);
+        if (tail < perceptrons)
+            std::copy(other + topology.perceptronOffset(tail), other + genomeSize, genome + topology.perceptronOffset(tail));
+
+        for (int p : mutated)
+        {
+            float *genes = genome + topology.perceptronOffset(p);
+            for (int i = 0; i <= topology.perceptronInputs(p); ++i)
+                genes[i] += random.uniform() - 0.5f;
+        }
+
+        GenomeDelta &delta = deltas[child];
+        delta.base = base;
+        delta.tail = tail;
+        delta.perceptronCount = mutated.size();
+        std::copy(mutated.constBegin(), mutated.constEnd(), delta.perceptrons);
+    };
+
+    breed(0, 0, secondHidden + 3, {});
+    breed(1, 0, output + 1, {});
+    breed(2, 0, perceptrons, {2, 9});
+    breed(3, 0, perceptrons, {secondHidden + 4});
+    breed(4, 1, perceptrons, {output + 2});
+    breed(5, 1, perceptrons, {1, secondHidden, output});
+    breed(6, 1, secondHidden + 5, {0, 7});
+    breed(7, 1, perceptrons, {});
+
+    QVector<float> expected(children.size(), 0.0f);
+    Evaluator evaluator;
+    evaluator.evaluate(children, 0, children.size(), dataset.view(), expected.data());
+
+    // Grouped by parent so children share its forward pass, and interleaved so the base changes every genome
+    for (const QVector<int> &order : {QVector<int>{0, 1, 2, 3, 4, 5, 6, 7}, QVector<int>{0, 4, 1, 5, 2, 6, 3, 7}})
+    {
+        QVector<float> errors(children.size(), 0.0f);
+        Evaluator incremental;
+        incremental.evaluateDeltas(children, order.constData(), order.size(), deltas.constData(), dataset.view(), errors.data());
+
+        for (int child = 0; child < children.size(); ++child)
+            QVERIFY2(closeErrors(errors[child], expected[child]), qPrintable(QString("Child %1: %2, evaluate %3").arg(child).arg(double(errors[child])).arg(double(expected[child]))));
+    }
+}
+
+void NeuralNetworkTests::backpropagationMatchesFiniteDifferences_data()
+{
+    QTest::addColumn<int>("outputActivation");
+
+    for (Activation activation : {Activation::Sigmoid, Activation::Tanh, Activation::Identity})
+        QTest::newRow(ActivationKernels::name(activation)) << int(activation);
+}
+
+void NeuralNetworkTests::backpropagationMatchesFiniteDifferences()
+{
+    QFETCH(int, outputActivation);
+    Random random(6);
+
+    // Two hidden layers so the deltas are carried back through one layer into another
+    NetworkTopology topology(3, QVector<int>{4, 3, 2});
+    topology.setLayerActivation(0, Activation::Tanh);
+    topology.setLayerActivation(1, Activation::Sigmoid);
+    topology.setOutputActivation(Activation(outputActivation));
+
+    Dataset dataset;
+    fillDataset(dataset, 10, topology.inputs(), topology.outputs(), random);
+    DatasetView batch = dataset.view();
+
+    int genomeSize = topology.genomeSize();
+    QVector<float> genome = randomValues(genomeSize, random, 1.0f);
+
+    // A step moves the genome by learningRate / samples times the gradient of the summed error
+    Backpropagation backpropagation;
+    QVector<float> stepped = genome;
+    float batchError = backpropagation.step(topology, stepped.data(), batch, float(batch.samples));
+
+    double error = forwardPassError(topology, genome.constData(), batch);
+    QVERIFY2(closeErrors(batchError, error), qPrintable(QString("Batch error %1, forward pass %2").arg(double(batchError)).arg(error)));
+
+    const float h = 1e-2f;
+    for (int g = 0; g < genomeSize; ++g)
+    {
+        QVector<float> nudged = genome;
+        nudged[g] = genome[g] + h;
+        double above = forwardPassError(topology, nudged.constData(), batch);
+        nudged[g] = genome[g] - h;
+        double below = forwardPassError(topology, nudged.constData(), batch);
+
+        double numeric = (above - below) / (2.0 * double(h));
+        double analytic = double(genome[g]) - double(stepped[g]);
+        QVERIFY2(std::fabs(analytic - numeric) <= 1e-2 * qMax(1.0, std::fabs(numeric)),
+                 qPrintable(QString("Gene %1: gradient %2, finite difference %3").arg(g).arg(analytic).arg(numeric)));
+    }
+
+    // A small step downhill lowers the batch error
+    QVector<float> descended = genome;
+    backpropagation.step(topology, descended.data(), batch, 0.01f);
+    QVERIFY(forwardPassError(topology, descended.constData(), batch) < error);
+}
+
+void NeuralNetworkTests::sparseNetworkMatchesGenome()
+{
+    Random random(7);
+    InnovationHistory history(3, 2);
+    NeatMutationSettings settings;
+    settings.hiddenActivation = Activation::Tanh;
+
+    NeatGenome genome = NeatGenome::minimal(3, 2, Activation::Sigmoid, true, history, random, 2.0f);
+
+    SparseNetwork network;
+    QVERIFY(network.compile(genome));
+    QCOMPARE(network.nodeCount(), 2);
+    QCOMPARE(network.connectionCount(), 6);
+    QVERIFY(sparseNetworkMatches(network, genome, random));
+
+    // Split connections, then connect the new nodes further, checking every structure on the way
+    for (int i = 0; i < 4; ++i)
+    {
+        QVERIFY(genome.addNode(settings, history, random));
+        genome.addConnection(settings, history, random);
+
+        QVERIFY(network.compile(genome));
+        QCOMPARE(network.nodeCount(), 2 + genome.hiddenCount());
+        QVERIFY(sparseNetworkMatches(network, genome, random));
+    }
+}
+
+void NeuralNetworkTests::sparseNetworkPrunesUnusedNodes()
+{
+    // Node 3 feeds the output, 4 and 5 only feed each other and are never needed
+    QVector<NodeGene> nodes;
+    nodes << nodeGene(0, NodeType::Input, Activation::Identity, 0)
+          << nodeGene(1, NodeType::Input, Activation::Identity, 0)
+          << nodeGene(2, NodeType::Output, Activation::Sigmoid, 0.1f)
+          << nodeGene(3, NodeType::Hidden, Activation::Tanh, -0.2f)
+          << nodeGene(4, NodeType::Hidden, Activation::Tanh, 0.3f)
+          << nodeGene(5, NodeType::Hidden, Activation::ReLU, 0.4f);
+
+    QVector<ConnectionGene> connections;
+    connections << connectionGene(0, 0, 3, 0.5f)
+                << connectionGene(1, 1, 3, -1.5f)
+                << connectionGene(2, 3, 2, 2.0f)
+                << connectionGene(3, 1, 2, 0.7f)
+                << connectionGene(4, 0, 5, 1.0f)
+                << connectionGene(5, 5, 4, 1.0f);
+
+    NeatGenome genome = NeatGenome::fromGenes(2, 1, nodes, connections);
+
+    SparseNetwork network;
+    QVERIFY(network.compile(genome));
+    QCOMPARE(network.nodeCount(), 2);
+    QCOMPARE(network.connectionCount(), 4);
+
+    Random random(8);
+    QVERIFY(sparseNetworkMatches(network, genome, random));
+}
+
+void NeuralNetworkTests::sparseNetworkRejectsCycles()
+{
+    QVector<NodeGene> nodes;
+    nodes << nodeGene(0, NodeType::Input, Activation::Identity, 0)
+          << nodeGene(1, NodeType::Output, Activation::Sigmoid, 0)
+          << nodeGene(2, NodeType::Hidden, Activation::Tanh, 0)
+          << nodeGene(3, NodeType::Hidden, Activation::Tanh, 0);
+
+    // 3 -> 2 closes the cycle 2 -> 3 -> 2, harmless while it is disabled
+    QVector<ConnectionGene> connections;
+    connections << connectionGene(0, 0, 2, 1.0f)
+                << connectionGene(1, 2, 3, 1.0f)
+                << connectionGene(2, 3, 1, 1.0f)
+                << connectionGene(3, 3, 2, 1.0f, false);
+
+    SparseNetwork network;
+    QVERIFY(network.compile(NeatGenome::fromGenes(1, 1, nodes, connections)));
+    QCOMPARE(network.nodeCount(), 3);
+
+    connections[3].enabled = true;
+    QVERIFY(!network.compile(NeatGenome::fromGenes(1, 1, nodes, connections)));
+    QVERIFY(network.isEmpty());
+    QVERIFY(!network.errorString().isEmpty());
+}
+
+void NeuralNetworkTests::checkpointRoundTrip()
+{
+    Random random(3);
+
+    CheckpointSnapshot snapshot;
+    snapshot.topology = NetworkTopology(4, QVector<int>{3, 2});
+    snapshot.topology.setLayerActivation(0, Activation::Tanh);
+    snapshot.genomeCount = 5;
+    snapshot.stride = snapshot.topology.paddedGenomeSize();
+    snapshot.genomes = randomValues(snapshot.genomeCount * snapshot.stride, random, 10.0f);
+    snapshot.errors = randomValues(snapshot.genomeCount, random, 100.0f);
+    snapshot.bestGenome = randomValues(snapshot.topology.genomeSize(), random, 10.0f);
+    snapshot.bestError = 0.25f;
+    snapshot.generation = 42;
+    snapshot.seed = 0x0123456789abcdefULL;
+    snapshot.randomKey = 7;
+    snapshot.randomCounter = 99;
+
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString path = directory.filePath("checkpoint.gnn");
+
+    QString error;
+    QVERIFY2(Checkpoint::write(path, snapshot, &error), qPrintable(error));
+
+    Checkpoint checkpoint;
+    QVERIFY2(checkpoint.open(path), qPrintable(checkpoint.errorString()));
+
+    QVERIFY(checkpoint.topology() == snapshot.topology);
+    QVERIFY(checkpoint.topology().layerActivation(0) == Activation::Tanh);
+    QCOMPARE(checkpoint.genomeCount(), snapshot.genomeCount);
+    QCOMPARE(checkpoint.stride(), snapshot.stride);
+    QCOMPARE(checkpoint.generation(), snapshot.generation);
+    QCOMPARE(checkpoint.seed(), snapshot.seed);
+    QCOMPARE(checkpoint.randomKey(), snapshot.randomKey);
+    QCOMPARE(checkpoint.randomCounter(), snapshot.randomCounter);
+    QCOMPARE(checkpoint.bestError(), snapshot.bestError);
+    QVERIFY(checkpoint.hasBestGenome());
+
+    int genomeSize = snapshot.topology.genomeSize();
+    QVERIFY(std::equal(snapshot.bestGenome.constBegin(), snapshot.bestGenome.constEnd(), checkpoint.bestGenome()));
+    QVERIFY(std::equal(snapshot.errors.constBegin(), snapshot.errors.constEnd(), checkpoint.errors()));
+    for (int g = 0; g < snapshot.genomeCount; ++g)
+        QVERIFY(std::equal(checkpoint.genome(g), checkpoint.genome(g) + genomeSize, snapshot.genomes.constData() + g * snapshot.stride));
+
+    checkpoint.close();
+
+    // A file cut short is refused rather than read past its end
+    QFile file(path);
+    QVERIFY(file.resize(file.size() - 4));
+    QVERIFY(!checkpoint.open(path));
+}
+
+void NeuralNetworkTests::csvMatchesPackedDataset()
+{
+    Random random(4);
+    int samples = 37;
+    int inputSize = 3;
+    int outputSize = 2;
+
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QString csvPath = directory.filePath("data.csv");
+
+    // Enough digits for every float to parse back to itself
+    QByteArray csv = "a,b,c,x,y\n";
+    QVector<float> rows = randomValues(samples * (inputSize + outputSize), random, 1000.0f);
+    for (int sample = 0; sample < samples; ++sample)
+    {
+        for (int c = 0; c < inputSize + outputSize; ++c)
+            csv += (c > 0 ? "," : "") + QByteArray::number(rows[sample * (inputSize + outputSize) + c], 'g', 9);
+        csv += '\n';
+    }
+
+    QFile csvFile(csvPath);
+    QVERIFY(csvFile.open(QIODevice::WriteOnly));
+    csvFile.write(csv);
+    csvFile.close();
+
+    Dataset expected;
+    expected.setData(rows.constData(), samples, inputSize, outputSize);
+
+    Dataset loaded;
+    QVERIFY2(loaded.load(csvPath, outputSize), qPrintable(loaded.errorString()));
+    QVERIFY(!loaded.isMapped());
+    QVERIFY(sameRows(loaded, expected));
+
+    // Packed from the loaded rows and streamed straight from the CSV, both mapped back
+    QString error;
+    QString writtenPath = directory.filePath("written.gnnd");
+    QVERIFY2(Dataset::writeBinary(writtenPath, loaded.view(), &error), qPrintable(error));
+
+    QString convertedPath = directory.filePath("converted.gnnd");
+    QVERIFY2(Dataset::convertCsv(csvPath, convertedPath, outputSize, &error), qPrintable(error));
+
+    for (const QString &path : {writtenPath, convertedPath})
+    {
+        Dataset packed;
+        QVERIFY2(packed.load(path, outputSize), qPrintable(packed.errorString()));
+        QVERIFY(packed.isMapped());
+        QVERIFY(sameRows(packed, expected));
+    }
+
+    // A header without rows is not a dataset
+    QString emptyPath = directory.filePath("empty.csv");
+    QFile emptyFile(emptyPath);
+    QVERIFY(emptyFile.open(QIODevice::WriteOnly));
+    emptyFile.write("a,b,c,x,y\n");
+    emptyFile.close();
+
+    Dataset empty;
+    QVERIFY(!empty.loadCsv(emptyPath, outputSize));
+    QVERIFY(!Dataset::convertCsv(emptyPath, directory.filePath("empty.gnnd"), outputSize));
+}
+
+QTEST_GUILESS_MAIN(NeuralNetworkTests)
+
+#include "tst_neuralnetwork.moc"
@@ -0,0 +1,176 @@
+#include "threadpool.h"
+#include <QThread>
+#include <chrono>
+
+static thread_local int s_workerIndex = 0;
+
+ThreadPool::ThreadPool(int threadCount)
+    : m_threadCount(threadCount > 0 ? threadCount : qMax(1, QThread::idealThreadCount())),
+      m_queues(new WorkerQueue[size_t(m_threadCount)])
+{
+    for (int i = 1; i < m_threadCount; ++i)
+        m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobPosted.notify_all();
+
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+int ThreadPool::threadCount() const
+{
+    return m_threadCount;
+}
+
+int ThreadPool::currentWorkerIndex()
+{
+    return s_workerIndex;
+}
+
+qint64 ThreadPool::busyNanoseconds(int workerIndex) const
+{
+    return m_queues[size_t(workerIndex)].busyNanoseconds;
+}
+
+static qint64 steadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ThreadPool::run(const Job &job)
+{
+    int chunks = (job.count + job.chunkSize - 1) / job.chunkSize;
+
+    if (chunks <= 0)
+        return;
+
+    // Nothing to share, avoid waking the workers
+    if (m_threadCount == 1 || chunks == 1)
+    {
+        qint64 start = steadyNanoseconds();
+        job.invoke(job.body, 0, job.count);
+        m_queues[0].busyNanoseconds += steadyNanoseconds() - start;
+        return;
+    }
+
+    for (int i = 0; i < m_threadCount; ++i)
+    {
+        auto &queue = m_queues[size_t(i)];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.begin = int(qint64(chunks) * i / m_threadCount);
+        queue.end = int(qint64(chunks) * (i + 1) / m_threadCount);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = job;
+        m_busyWorkers = m_threadCount - 1;
+        m_jobGeneration++;
+    }
+    m_jobPosted.notify_all();
+
+    int callerIndex = s_workerIndex;
+    s_workerIndex = 0;
+    work(0);
+    s_workerIndex = callerIndex;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobDone.wait(lock, [&]() { return m_busyWorkers == 0; });
+}
+
+void ThreadPool::workerLoop(int workerIndex)
+{
+    s_workerIndex = workerIndex;
+    quint64 seenGeneration = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobPosted.wait(lock, [&]() { return m_stopping || m_jobGeneration != seenGeneration; });
+
+            if (m_stopping)
+                return;
+
+            seenGeneration = m_jobGeneration;
+        }
+
+        work(workerIndex);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busyWorkers--;
+        }
+        m_jobDone.notify_one();
+    }
+}
+
+void ThreadPool::work(int workerIndex)
+{
+    int chunk;
+    qint64 start = steadyNanoseconds();
+
+    for (;;)
+    {
+        while (takeChunk(workerIndex, chunk))
+        {
+            int first = chunk * m_job.chunkSize;
+            m_job.invoke(m_job.body, first, qMin(m_job.chunkSize, m_job.count - first));
+        }
+
+        if (!stealChunks(workerIndex))
+            break;
+    }
+
+    m_queues[size_t(workerIndex)].busyNanoseconds += steadyNanoseconds() - start;
+}
+
+bool ThreadPool::takeChunk(int workerIndex, int &chunk)
+{
+    auto &queue = m_queues[size_t(workerIndex)];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (queue.begin >= queue.end)
+        return false;
+
+    chunk = queue.begin++;
+    return true;
+}
+
+bool ThreadPool::stealChunks(int workerIndex)
+{
+    for (int i = 1; i < m_threadCount; ++i)
+    {
+        int victimIndex = (workerIndex + i) % m_threadCount;
+        auto &victim = m_queues[size_t(victimIndex)];
+
+        int begin;
+        int end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            int remaining = victim.end - victim.begin;
+            if (remaining <= 0)
+                continue;
+
+            // Take the back half, rounded up so a single remaining chunk can be stolen too
+            begin = victim.end - (remaining + 1) / 2;
+            end = victim.end;
+            victim.end = begin;
+        }
+
+        auto &queue = m_queues[size_t(workerIndex)];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.begin = begin;
+        queue.end = end;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,91 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing pool for chunked parallel loops. A parallelFor splits its range into
+// chunks and hands every worker a contiguous run of them; a worker that runs out steals
+// the back half of another worker's run. The calling thread takes part as worker 0.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Number of workers including the calling thread, 0 in the constructor means all cores
+    int threadCount() const;
+
+    // Calls body(first, count) for consecutive chunks of [0, count) and returns once all are done.
+    // The body is not copied so this does not allocate.
+    template<typename Body>
+    void parallelFor(int count, int chunkSize, const Body &body);
+
+    // Index of the worker running the current chunk, in [0, threadCount())
+    static int currentWorkerIndex();
+
+    // Time worker workerIndex has spent running bodies since the pool was made. Only read it
+    // between parallelFors, the difference over a stretch of work gives the worker's utilization.
+    qint64 busyNanoseconds(int workerIndex) const;
+
+private:
+    struct Job
+    {
+        void (*invoke)(const void *body, int first, int count) = nullptr;
+        const void *body = nullptr;
+        int count = 0;
+        int chunkSize = 1;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        int begin = 0;
+        int end = 0;
+        // Written by the worker only, published to the caller with the end of each job
+        qint64 busyNanoseconds = 0;
+    };
+
+    void run(const Job &job);
+    void workerLoop(int workerIndex);
+    void work(int workerIndex);
+    bool takeChunk(int workerIndex, int &chunk);
+    bool stealChunks(int workerIndex);
+
+    int m_threadCount;
+    std::vector<std::thread> m_threads;
+    std::unique_ptr<WorkerQueue[]> m_queues;
+
+    Job m_job;
+    std::mutex m_mutex;
+    std::condition_variable m_jobPosted;
+    std::condition_variable m_jobDone;
+    quint64 m_jobGeneration = 0;
+    int m_busyWorkers = 0;
+    bool m_stopping = false;
+};
+
+template<typename Body>
+void ThreadPool::parallelFor(int count, int chunkSize, const Body &body)
+{
+    Job job;
+    job.invoke = [](const void *context, int first, int chunkCount)
+    {
+        (*static_cast<const Body *>(context))(first, chunkCount);
+    };
+    job.body = &body;
+    job.count = count;
+    job.chunkSize = chunkSize > 0 ? chunkSize : 1;
+
+    run(job);
+}
+
+#endif // THREADPOOL_H